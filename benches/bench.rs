@@ -71,9 +71,13 @@ macro_rules! noop_handler {
 
 macro_rules! define_group {
     ($group_name:expr, [ $(($name:expr, $settings:expr)),+ ]) => {
-        use criterion::*;
+        define_group!(group, $group_name, [ $(($name, $settings)),+ ]);
+    };
+
+    ($fn_name:ident, $group_name:expr, [ $(($name:expr, $settings:expr)),+ ]) => {
+        pub fn $fn_name(c: &mut criterion::Criterion) {
+            use criterion::*;
 
-        pub fn group(c: &mut Criterion) {
             let mut g = c.benchmark_group($group_name);
 
             for input in crate::INPUTS.iter() {
@@ -98,8 +102,24 @@ mod cases;
 criterion_group!(
     benches,
     cases::parsing::group,
+    cases::parsing::text_skip_group,
     cases::rewriting::group,
-    cases::selector_matching::group
+    cases::selector_matching::group,
+    cases::selector_matching::attribute_heavy_group,
+    cases::selector_matching::selector_count_group,
+    cases::selector_matching::sibling_combinators_group,
+    cases::deep_nesting::group,
+    cases::construction::group,
+    cases::construction::short_lived_group,
+    cases::buffering::group,
+    cases::output::group,
+    cases::pool::group,
+    cases::memory_budget::group,
+    cases::transcoding::group,
+    cases::streaming::group,
+    cases::passthrough::group,
+    cases::tokenization::group,
+    cases::sanitizer::group
 );
 
 criterion_main!(benches);
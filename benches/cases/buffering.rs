@@ -0,0 +1,55 @@
+use criterion::*;
+use lol_html::{element, HtmlRewriter, Settings};
+
+const ATTRIBUTE_VALUE_SIZE: usize = 1024 * 1024;
+const CHUNK_SIZES: [usize; 5] = [1, 16, 256, 1024, 4096];
+
+// NOTE: the start tag can't be parsed until its end is seen, so all of the chunks
+// of the attribute value end up in the parsing buffer of the rewriter.
+fn input() -> Vec<u8> {
+    let mut input = b"<div><img alt=\"".to_vec();
+
+    input.resize(input.len() + ATTRIBUTE_VALUE_SIZE, b'a');
+    input.extend_from_slice(b"\"></div>");
+
+    input
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Large attribute buffering");
+    let input = input();
+
+    g.throughput(Throughput::Bytes(input.len() as u64));
+    g.sample_size(10);
+
+    for chunk_size in CHUNK_SIZES {
+        g.bench_with_input(
+            BenchmarkId::new("Chunk size", chunk_size),
+            &chunk_size,
+            |b, &chunk_size| {
+                b.iter(|| {
+                    let mut rewriter = HtmlRewriter::new(
+                        Settings {
+                            element_content_handlers: vec![element!("img[alt]", |el| {
+                                black_box(el);
+                                Ok(())
+                            })],
+                            ..Settings::new()
+                        },
+                        |c: &[u8]| {
+                            black_box(c);
+                        },
+                    );
+
+                    for chunk in input.chunks(chunk_size) {
+                        rewriter.write(chunk).unwrap();
+                    }
+
+                    rewriter.end().unwrap();
+                });
+            },
+        );
+    }
+
+    g.finish();
+}
@@ -0,0 +1,144 @@
+use criterion::*;
+use lol_html::html_content::Element;
+use lol_html::{
+    BufferPool, ElementContentHandlers, HtmlRewriter, RewriterTemplate, Selector, Settings,
+};
+use std::borrow::Cow;
+use std::sync::LazyLock;
+
+const SELECTORS: [&str; 40] = [
+    "a[href]",
+    "a[href^='http:']",
+    "a[target=_blank]",
+    "img[src]",
+    "img[srcset]",
+    "script[src]",
+    "link[rel=stylesheet]",
+    "link[rel=preload]",
+    "meta[name=viewport]",
+    "meta[property^='og:']",
+    "head",
+    "head > title",
+    "body",
+    "body > header",
+    "body > footer",
+    "nav a",
+    "nav ul > li",
+    "main article",
+    "article h1",
+    "article h2",
+    "article p",
+    "div.content",
+    "div.sidebar",
+    "div#app",
+    "div[data-track]",
+    "span.price",
+    "form[action]",
+    "input[type=hidden]",
+    "input[name=csrf]",
+    "iframe[src]",
+    "video source",
+    "audio source",
+    "picture > source",
+    "table td",
+    "ul.menu > li > a",
+    "[data-lazy]",
+    "[aria-hidden=true]",
+    "noscript",
+    "template",
+    "svg use",
+];
+
+// NOTE: selectors are parsed only once, so that the benchmark measures only the cost of the
+// rewriter construction, including the selector compilation if the template is not used.
+static PARSED_SELECTORS: LazyLock<Vec<Selector>> =
+    LazyLock::new(|| SELECTORS.iter().map(|s| s.parse().unwrap()).collect());
+
+fn settings() -> Settings<'static, 'static> {
+    Settings {
+        element_content_handlers: PARSED_SELECTORS
+            .iter()
+            .map(|selector| {
+                let handlers = ElementContentHandlers::default().element(|el: &mut Element| {
+                    black_box(el);
+                    Ok(())
+                });
+
+                (Cow::Borrowed(selector), handlers)
+            })
+            .collect(),
+        ..Settings::new()
+    }
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Rewriter construction");
+    let template = RewriterTemplate::new(&settings());
+
+    g.bench_function("Without template", |b| {
+        b.iter(|| {
+            black_box(HtmlRewriter::new(settings(), |c: &[u8]| {
+                black_box(c);
+            }));
+        });
+    });
+
+    g.bench_function("With shared template", |b| {
+        b.iter(|| {
+            black_box(HtmlRewriter::from_template(
+                &template,
+                settings(),
+                |c: &[u8]| {
+                    black_box(c);
+                },
+            ));
+        });
+    });
+
+    g.finish();
+}
+
+const SHORT_LIVED_REWRITER_COUNT: usize = 1_000_000;
+
+fn rewrite_short_document(buffer_pool: Option<&BufferPool>) {
+    let mut rewriter = HtmlRewriter::new(
+        Settings {
+            buffer_pool: buffer_pool.cloned(),
+            ..Settings::new()
+        },
+        |c: &[u8]| {
+            black_box(c);
+        },
+    );
+
+    rewriter.write(b"<p>Hello, world!</p>").unwrap();
+    rewriter.end().unwrap();
+}
+
+// NOTE: every iteration builds and tears down a million rewriters, so that
+// the allocator has a chance to fragment.
+pub fn short_lived_group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Short-lived rewriters");
+    let buffer_pool = BufferPool::new(16, 64 * 1024);
+
+    g.sample_size(10);
+    g.throughput(Throughput::Elements(SHORT_LIVED_REWRITER_COUNT as u64));
+
+    g.bench_function("Without buffer pool", |b| {
+        b.iter(|| {
+            for _ in 0..SHORT_LIVED_REWRITER_COUNT {
+                rewrite_short_document(None);
+            }
+        });
+    });
+
+    g.bench_function("With buffer pool", |b| {
+        b.iter(|| {
+            for _ in 0..SHORT_LIVED_REWRITER_COUNT {
+                rewrite_short_document(Some(&buffer_pool));
+            }
+        });
+    });
+
+    g.finish();
+}
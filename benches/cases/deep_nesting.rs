@@ -0,0 +1,78 @@
+use criterion::*;
+use lol_html::{element, HtmlRewriter, MemoryBudget, Settings};
+
+const DEPTHS: [usize; 3] = [100, 1000, 10_000];
+const SELECTOR_COUNT: usize = 100;
+
+fn selectors(name: &str) -> Vec<&'static str> {
+    match name {
+        "Match-all selector" => vec!["*"],
+        "Child combinator" => vec!["div > div"],
+        "Descendant combinator" => vec!["div span"],
+        // NOTE: all of the selectors match every element, so their indices don't
+        // fit into the inline part of the matched payload sets.
+        _ => vec!["div"; SELECTOR_COUNT],
+    }
+}
+
+// NOTE: all of the start tags come in the first chunk, so the open element stack
+// is as deep as the document when the first chunk is written.
+fn nested_input(depth: usize) -> [Vec<u8>; 2] {
+    [
+        format!("{}<span>deep</span>", "<div>".repeat(depth)).into_bytes(),
+        "</div>".repeat(depth).into_bytes(),
+    ]
+}
+
+fn rewrite(selectors: &[&str], input: &[Vec<u8>; 2], peak: &mut usize) {
+    // NOTE: without credit blocks the budget tracks the exact memory usage of the rewriter.
+    let memory_budget = MemoryBudget::with_credit_block_size(usize::MAX, 0);
+
+    let mut rewriter = HtmlRewriter::new(
+        Settings {
+            element_content_handlers: selectors
+                .iter()
+                .map(|selector| element!(selector, noop_handler!()))
+                .collect(),
+            memory_budget: Some(memory_budget.clone()),
+            ..Settings::new()
+        },
+        |c: &[u8]| {
+            black_box(c);
+        },
+    );
+
+    rewriter.write(&input[0]).unwrap();
+    *peak = (*peak).max(memory_budget.usage());
+
+    rewriter.write(&input[1]).unwrap();
+    rewriter.end().unwrap();
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Deep nesting");
+
+    for depth in DEPTHS {
+        let input = nested_input(depth);
+
+        g.throughput(Throughput::Bytes((input[0].len() + input[1].len()) as u64));
+
+        for name in [
+            "Match-all selector",
+            "Child combinator",
+            "Descendant combinator",
+            "Many selectors",
+        ] {
+            let selectors = selectors(name);
+            let mut peak = 0;
+
+            g.bench_with_input(BenchmarkId::new(name, depth), &input, |b, input| {
+                b.iter(|| rewrite(&selectors, input, &mut peak));
+            });
+
+            println!("{name}/{depth}: peak memory usage is {peak} bytes");
+        }
+    }
+
+    g.finish();
+}
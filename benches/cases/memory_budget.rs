@@ -0,0 +1,74 @@
+use criterion::*;
+use lol_html::{element, HtmlRewriter, MemoryBudget, Settings};
+use std::num::NonZeroUsize;
+use std::thread;
+
+fn rewrite(memory_budget: Option<&MemoryBudget>) {
+    for input in crate::INPUTS.iter() {
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                // NOTE: the match-all selector makes the rewriter grow the open element stack.
+                element_content_handlers: vec![element!("*", |el| {
+                    black_box(el);
+                    Ok(())
+                })],
+                memory_budget: memory_budget.cloned(),
+                ..Settings::new()
+            },
+            |c: &[u8]| {
+                black_box(c);
+            },
+        );
+
+        for chunk in &input.chunks {
+            rewriter.write(chunk).unwrap();
+        }
+
+        rewriter.end().unwrap();
+    }
+}
+
+// NOTE: every thread rewrites the whole corpus, so with the shared budget the threads
+// contend for it unless the rewriters take the credit in blocks.
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Shared memory budget");
+
+    let length = crate::INPUTS
+        .iter()
+        .map(|input| input.length as u64)
+        .sum::<u64>();
+
+    let max_thread_count = thread::available_parallelism().map_or(1, NonZeroUsize::get);
+
+    let thread_counts = std::iter::successors(Some(1), |&n| Some(n * 2))
+        .take_while(|&n| n <= max_thread_count)
+        .collect::<Vec<_>>();
+
+    for thread_count in thread_counts {
+        g.throughput(Throughput::Bytes(length * thread_count as u64));
+
+        for (name, memory_budget) in [
+            ("No budget", None),
+            (
+                "Budget updated on every allocation",
+                Some(MemoryBudget::with_credit_block_size(usize::MAX, 0)),
+            ),
+            (
+                "Budget with batched credit",
+                Some(MemoryBudget::new(usize::MAX)),
+            ),
+        ] {
+            g.bench_function(BenchmarkId::new(name, thread_count), |b| {
+                b.iter(|| {
+                    thread::scope(|s| {
+                        for _ in 0..thread_count {
+                            s.spawn(|| rewrite(memory_budget.as_ref()));
+                        }
+                    });
+                });
+            });
+        }
+    }
+
+    g.finish();
+}
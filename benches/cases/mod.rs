@@ -1,3 +1,14 @@
+pub mod buffering;
+pub mod construction;
+pub mod deep_nesting;
+pub mod memory_budget;
+pub mod output;
 pub mod parsing;
+pub mod passthrough;
+pub mod pool;
 pub mod rewriting;
+pub mod sanitizer;
 pub mod selector_matching;
+pub mod streaming;
+pub mod tokenization;
+pub mod transcoding;
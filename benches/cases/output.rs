@@ -0,0 +1,66 @@
+use criterion::*;
+use lol_html::{element, BufferedOutputSink, HtmlRewriter, OutputSink, Settings};
+
+const OUTPUT_BUFFER_SIZE: usize = 4096;
+
+// NOTE: every modified start tag is emitted as several small chunks.
+fn settings() -> Settings<'static, 'static> {
+    Settings {
+        element_content_handlers: vec![element!("*", |el| {
+            el.set_attribute("data-rewritten", "")?;
+            Ok(())
+        })],
+        ..Settings::new()
+    }
+}
+
+fn rewrite(chunks: &[Vec<u8>], output_sink: impl OutputSink) {
+    let mut rewriter = HtmlRewriter::new(settings(), output_sink);
+
+    for chunk in chunks {
+        rewriter.write(chunk).unwrap();
+    }
+
+    rewriter.end().unwrap();
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Output buffering");
+
+    for input in crate::INPUTS.iter() {
+        g.throughput(Throughput::Bytes(input.length as u64));
+
+        g.bench_with_input(
+            BenchmarkId::new("Unbuffered", &input.name),
+            &input.chunks,
+            |b, chunks| {
+                b.iter(|| {
+                    let mut output = Vec::with_capacity(input.length * 2);
+
+                    rewrite(chunks, |c: &[u8]| output.extend_from_slice(c));
+                    black_box(output);
+                });
+            },
+        );
+
+        g.bench_with_input(
+            BenchmarkId::new("Buffered", &input.name),
+            &input.chunks,
+            |b, chunks| {
+                b.iter(|| {
+                    let mut output = Vec::with_capacity(input.length * 2);
+
+                    rewrite(
+                        chunks,
+                        BufferedOutputSink::new(OUTPUT_BUFFER_SIZE, |c: &[u8]| {
+                            output.extend_from_slice(c);
+                        }),
+                    );
+                    black_box(output);
+                });
+            },
+        );
+    }
+
+    g.finish();
+}
@@ -28,3 +28,28 @@ define_group!(
         )
     ]
 );
+
+define_group!(
+    text_skip_group,
+    "Text fast-skip",
+    [
+        ("Data state, tag scanner", Settings::new()),
+        (
+            "Data state, lexer",
+            Settings {
+                document_content_handlers: vec![doctype!(noop_handler!())],
+                ..Settings::new()
+            }
+        ),
+        (
+            "Script data and raw text states, lexer",
+            // NOTE: there are no comments inside of script and style elements, so this
+            // handler never fires, but it keeps the parser in the lexer mode while it's
+            // inside of their content.
+            Settings {
+                element_content_handlers: vec![comments!("script, style", noop_handler!())],
+                ..Settings::new()
+            }
+        )
+    ]
+);
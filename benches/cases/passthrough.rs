@@ -0,0 +1,27 @@
+use lol_html::html_content::{ContentType, Element};
+use lol_html::{ElementContentHandlers, Settings};
+use std::borrow::Cow;
+
+fn inject_into_head(once: bool) -> Settings<'static, 'static> {
+    let handlers = ElementContentHandlers::default().element(|el: &mut Element<'_, '_>| {
+        el.prepend("<script></script>", ContentType::Html);
+        Ok(())
+    });
+
+    Settings {
+        element_content_handlers: vec![(
+            Cow::Owned("head".parse().unwrap()),
+            if once { handlers.once() } else { handlers },
+        )],
+        ..Settings::new()
+    }
+}
+
+define_group!(
+    "Passthrough after handler exhaustion",
+    [
+        ("No handlers", Settings::new()),
+        ("Inject into head", inject_into_head(false)),
+        ("Inject into head once", inject_into_head(true))
+    ]
+);
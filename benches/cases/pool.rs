@@ -0,0 +1,69 @@
+use criterion::*;
+use lol_html::html_content::ContentType;
+use lol_html::pool::RewritePool;
+use lol_html::{element, RewriterTemplate, Settings};
+use std::num::NonZeroUsize;
+use std::sync::Arc;
+use std::thread;
+
+// NOTE: the corpus is too small to keep lots of threads busy, so every
+// document is rewritten several times.
+const DOCUMENT_REPEAT_COUNT: usize = 16;
+
+fn settings() -> Settings<'static, 'static> {
+    Settings {
+        element_content_handlers: vec![
+            element!("a[href]", |el| {
+                el.set_attribute("rel", "noopener")?;
+                Ok(())
+            }),
+            element!("div", |el| {
+                el.append("<!-- div -->", ContentType::Html);
+                Ok(())
+            }),
+        ],
+        ..Settings::new()
+    }
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Parallel rewriting");
+
+    let documents = crate::INPUTS
+        .iter()
+        .map(|input| Arc::<[u8]>::from(input.chunks.concat()))
+        .cycle()
+        .take(crate::INPUTS.len() * DOCUMENT_REPEAT_COUNT)
+        .collect::<Vec<_>>();
+
+    let max_thread_count = thread::available_parallelism().map_or(1, NonZeroUsize::get);
+
+    g.throughput(Throughput::Bytes(
+        documents.iter().map(|d| d.len() as u64).sum(),
+    ));
+
+    let thread_counts = std::iter::successors(Some(1), |&n| Some(n * 2))
+        .take_while(|&n| n <= max_thread_count)
+        .collect::<Vec<_>>();
+
+    for thread_count in thread_counts {
+        let pool = RewritePool::new(
+            RewriterTemplate::new(&settings()),
+            settings,
+            NonZeroUsize::new(thread_count).unwrap(),
+        );
+
+        g.bench_with_input(
+            BenchmarkId::new("Threads", thread_count),
+            &documents,
+            |b, documents| {
+                b.iter(|| {
+                    pool.rewrite(documents.iter().cloned())
+                        .for_each(|output| drop(black_box(output)));
+                });
+            },
+        );
+    }
+
+    g.finish();
+}
@@ -26,6 +26,17 @@ define_group!(
                 })],
                 ..Settings::new()
             }
+        ),
+        (
+            "Remove all scripts",
+            Settings {
+                element_content_handlers: vec![element!("script", |el| {
+                    el.remove();
+
+                    Ok(())
+                })],
+                ..Settings::new()
+            }
         )
     ]
 );
@@ -0,0 +1,67 @@
+use lol_html::{comments, element, SanitizerPolicy, Settings};
+
+const ELEMENTS: &[&str] = &[
+    "html", "head", "body", "div", "p", "span", "a", "ul", "ol", "li", "table", "tbody", "tr",
+    "td", "img", "b", "i", "em", "strong", "h1", "h2", "h3",
+];
+
+const ATTRIBUTES: &[&str] = &["href", "src", "alt", "title", "class"];
+
+fn policy() -> SanitizerPolicy {
+    SanitizerPolicy::new()
+        .allow_elements(ELEMENTS)
+        .allow_attributes(ATTRIBUTES)
+        .allow_url_schemes(&["http", "https", "mailto"])
+}
+
+// NOTE: the handlers don't check the URL schemes, so they do less work than the sanitizer.
+define_group!(
+    "Sanitizer",
+    [
+        (
+            "Built-in sanitizer",
+            Settings {
+                sanitizer: Some(policy()),
+                ..Settings::new()
+            }
+        ),
+        (
+            "Equivalent content handlers",
+            Settings {
+                element_content_handlers: vec![
+                    element!("*", |el| {
+                        let name = el.tag_name();
+
+                        if !ELEMENTS.contains(&name.as_str()) {
+                            if matches!(name.as_str(), "script" | "style" | "textarea" | "title") {
+                                el.remove();
+                            } else {
+                                el.remove_and_keep_content();
+                            }
+
+                            return Ok(());
+                        }
+
+                        let removed = el
+                            .attributes()
+                            .iter()
+                            .map(|attr| attr.name())
+                            .filter(|name| !ATTRIBUTES.contains(&name.as_str()))
+                            .collect::<Vec<_>>();
+
+                        for name in removed {
+                            el.remove_attribute(&name);
+                        }
+
+                        Ok(())
+                    }),
+                    comments!("*", |c| {
+                        c.remove();
+                        Ok(())
+                    })
+                ],
+                ..Settings::new()
+            }
+        )
+    ]
+);
@@ -1,4 +1,9 @@
-use lol_html::{element, Settings};
+use criterion::*;
+use lol_html::html_content::Element;
+use lol_html::{
+    element, ElementContentHandlers, HtmlRewriter, RewriterTemplate, Selector, Settings,
+};
+use std::borrow::Cow;
 
 define_group!(
     "Selector matching",
@@ -48,3 +53,171 @@ define_group!(
         )
     ]
 );
+
+// NOTE: the first two cases are the same selectors with and without sibling combinators,
+// so sibling state tracking shouldn't slow down programs that don't use it.
+define_group!(
+    sibling_combinators_group,
+    "Sibling combinators",
+    [
+        (
+            "Without sibling combinators",
+            Settings {
+                element_content_handlers: vec![
+                    element!("ul > li", noop_handler!()),
+                    element!("div p", noop_handler!()),
+                    element!("h2 > a", noop_handler!())
+                ],
+                ..Settings::new()
+            }
+        ),
+        (
+            "With sibling combinators",
+            Settings {
+                element_content_handlers: vec![
+                    element!("ul > li + li", noop_handler!()),
+                    element!("div p ~ p", noop_handler!()),
+                    element!("h2 + a", noop_handler!())
+                ],
+                ..Settings::new()
+            }
+        ),
+        (
+            "Match-all sibling selector",
+            Settings {
+                element_content_handlers: vec![element!("* ~ *", noop_handler!())],
+                ..Settings::new()
+            }
+        )
+    ]
+);
+
+const ATTRIBUTE_COUNTS: [usize; 4] = [4, 16, 32, 64];
+const ATTRIBUTE_SELECTOR_COUNT: usize = 32;
+const ELEMENT_COUNT: usize = 1000;
+
+fn attribute_heavy_input(attribute_count: usize) -> Vec<u8> {
+    let mut input = String::new();
+
+    for _ in 0..ELEMENT_COUNT {
+        input.push_str("<div");
+
+        for i in 0..attribute_count {
+            input.push_str(&format!(" data-attr-{i}=\"value-{i}\""));
+        }
+
+        input.push_str("></div>");
+    }
+
+    input.into_bytes()
+}
+
+pub fn attribute_heavy_group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Attribute-heavy selector matching");
+
+    // NOTE: every other selector refers to an attribute that is missing on the elements,
+    // so that lookups have to search through all of the attributes.
+    let selectors = (0..ATTRIBUTE_SELECTOR_COUNT)
+        .map(|i| format!("[data-attr-{}^=\"value\"]", i * 2))
+        .collect::<Vec<_>>();
+
+    for attribute_count in ATTRIBUTE_COUNTS {
+        let input = attribute_heavy_input(attribute_count);
+
+        g.throughput(Throughput::Bytes(input.len() as u64));
+        g.bench_with_input(
+            BenchmarkId::new("Attributes per element", attribute_count),
+            &input,
+            |b, input| {
+                b.iter(|| {
+                    let mut rewriter = HtmlRewriter::new(
+                        Settings {
+                            element_content_handlers: selectors
+                                .iter()
+                                .map(|selector| element!(selector, noop_handler!()))
+                                .collect(),
+                            ..Settings::new()
+                        },
+                        |c: &[u8]| {
+                            black_box(c);
+                        },
+                    );
+
+                    rewriter.write(input).unwrap();
+                    rewriter.end().unwrap();
+                });
+            },
+        );
+    }
+
+    g.finish();
+}
+
+const SELECTOR_COUNTS: [usize; 4] = [10, 100, 300, 1000];
+const TAG_NAMES: [&str; 8] = ["div", "span", "a", "p", "li", "img", "td", "section"];
+
+// NOTE: most of the selectors in real-world configurations are keyed on
+// a tag name, id or class, and most of them don't match a given element.
+fn generated_selector(i: usize) -> String {
+    let tag_name = TAG_NAMES[i / 4 % TAG_NAMES.len()];
+
+    match i % 4 {
+        0 => format!("{tag_name}.class-{i}"),
+        1 => format!("#id-{i}"),
+        2 => format!(".class-{i}"),
+        _ => format!("{tag_name}[data-attr-{i}]"),
+    }
+}
+
+pub fn selector_count_group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Selector count");
+
+    for selector_count in SELECTOR_COUNTS {
+        // NOTE: selectors are parsed and compiled only once, so that the benchmark
+        // measures only the cost of the selector matching.
+        let selectors = (0..selector_count)
+            .map(|i| generated_selector(i).parse().unwrap())
+            .collect::<Vec<Selector>>();
+
+        let settings = || Settings {
+            element_content_handlers: selectors
+                .iter()
+                .map(|selector| {
+                    let handlers = ElementContentHandlers::default().element(|el: &mut Element| {
+                        black_box(el);
+                        Ok(())
+                    });
+
+                    (Cow::Borrowed(selector), handlers)
+                })
+                .collect(),
+            ..Settings::new()
+        };
+
+        let template = RewriterTemplate::new(&settings());
+
+        for input in crate::INPUTS.iter() {
+            g.throughput(Throughput::Bytes(input.length as u64));
+            g.bench_with_input(
+                BenchmarkId::new(format!("{selector_count} selectors"), &input.name),
+                &input.chunks,
+                |b, chunks| {
+                    b.iter(|| {
+                        let mut rewriter =
+                            HtmlRewriter::from_template(&template, settings(), |c: &[u8]| {
+                                black_box(c);
+                            });
+
+                        for chunk in chunks {
+                            rewriter.write(chunk).unwrap();
+                        }
+
+                        rewriter.end().unwrap();
+                    });
+                },
+            );
+        }
+    }
+
+    g.finish();
+}
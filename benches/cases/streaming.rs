@@ -0,0 +1,95 @@
+use criterion::*;
+
+#[cfg(feature = "futures")]
+pub fn group(c: &mut Criterion) {
+    use futures::executor::block_on;
+    use futures::stream::{self, StreamExt};
+    use lol_html::html_content::ContentType;
+    use lol_html::stream::RewritingStream;
+    use lol_html::{element, HtmlRewriter, Settings};
+    use std::cell::Cell;
+    use std::error::Error;
+
+    const MAX_BUFFERED_OUTPUT: usize = 16 * 1024;
+
+    fn settings() -> Settings<'static, 'static> {
+        Settings {
+            element_content_handlers: vec![element!("div", |el| {
+                el.append("<!-- div -->", ContentType::Html);
+                Ok(())
+            })],
+            ..Settings::new()
+        }
+    }
+
+    // NOTE: the consumer is slower than the rewriter, so with the synchronous sink
+    // the whole output is held in memory until it is consumed.
+    fn rewrite_sync(chunks: &[Vec<u8>], peak: &Cell<usize>) {
+        let mut output = vec![];
+        let mut rewriter = HtmlRewriter::new(settings(), |c: &[u8]| {
+            output.push(c.to_vec());
+        });
+
+        for chunk in chunks {
+            rewriter.write(chunk).unwrap();
+        }
+
+        rewriter.end().unwrap();
+        drop(rewriter);
+
+        peak.set(peak.get().max(output.iter().map(Vec::len).sum()));
+
+        for chunk in output {
+            black_box(chunk);
+        }
+    }
+
+    fn rewrite_stream(chunks: &[Vec<u8>], peak: &Cell<usize>) {
+        let input = stream::iter(chunks.iter().map(Ok::<_, Box<dyn Error + Send + Sync>>));
+        let mut output = RewritingStream::new(settings(), input, MAX_BUFFERED_OUTPUT);
+
+        block_on(async {
+            while let Some(chunk) = output.next().await {
+                let chunk = chunk.unwrap();
+
+                peak.set(peak.get().max(chunk.len()));
+                black_box(chunk);
+            }
+        });
+    }
+
+    let mut g = c.benchmark_group("Streaming with a slow consumer");
+
+    for input in crate::INPUTS.iter() {
+        g.throughput(Throughput::Bytes(input.length as u64));
+
+        for (name, rewrite) in [
+            (
+                "Synchronous sink",
+                rewrite_sync as fn(&[Vec<u8>], &Cell<usize>),
+            ),
+            ("RewritingStream", rewrite_stream),
+        ] {
+            let peak = Cell::new(0);
+
+            g.bench_with_input(
+                BenchmarkId::new(name, &input.name),
+                &input.chunks,
+                |b, chunks| {
+                    b.iter(|| rewrite(chunks, &peak));
+                },
+            );
+
+            println!(
+                "{name}/{}: peak buffered output is {} bytes",
+                input.name,
+                peak.get()
+            );
+        }
+    }
+
+    g.finish();
+}
+
+#[cfg(not(feature = "futures"))]
+pub fn group(_: &mut Criterion) {}
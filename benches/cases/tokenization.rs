@@ -0,0 +1,72 @@
+use criterion::*;
+use lol_html::tokenizer::{Token, Tokenizer};
+use lol_html::{element, HtmlRewriter, Settings};
+
+fn rewrite(settings: Settings<'_, '_>, chunks: &[Vec<u8>]) {
+    let mut rewriter = HtmlRewriter::new(settings, |c: &[u8]| {
+        black_box(c);
+    });
+
+    for chunk in chunks {
+        rewriter.write(chunk).unwrap();
+    }
+
+    rewriter.end().unwrap();
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Tokenization");
+
+    for input in crate::INPUTS.iter() {
+        g.throughput(Throughput::Bytes(input.length as u64));
+
+        g.bench_with_input(
+            BenchmarkId::new("Tokenizer", &input.name),
+            &input.chunks,
+            |b, chunks| {
+                b.iter(|| {
+                    let mut tokenizer = Tokenizer::new(false);
+                    let mut start_tag_count = 0;
+
+                    for chunk in chunks {
+                        for token in tokenizer.feed(chunk).unwrap() {
+                            if let Token::StartTag { .. } = black_box(token) {
+                                start_tag_count += 1;
+                            }
+                        }
+                    }
+
+                    tokenizer.end().unwrap().for_each(|t| {
+                        black_box(t);
+                    });
+
+                    black_box(start_tag_count);
+                });
+            },
+        );
+
+        // NOTE: the rewriter without handlers only scans for tags.
+        g.bench_with_input(
+            BenchmarkId::new("No-op HtmlRewriter", &input.name),
+            &input.chunks,
+            |b, chunks| b.iter(|| rewrite(Settings::new(), chunks)),
+        );
+
+        g.bench_with_input(
+            BenchmarkId::new("HtmlRewriter with a handler for all elements", &input.name),
+            &input.chunks,
+            |b, chunks| {
+                b.iter(|| {
+                    let settings = Settings {
+                        element_content_handlers: vec![element!("*", noop_handler!())],
+                        ..Settings::new()
+                    };
+
+                    rewrite(settings, chunks);
+                });
+            },
+        );
+    }
+
+    g.finish();
+}
@@ -0,0 +1,72 @@
+use criterion::*;
+use encoding_rs::{Encoding, SHIFT_JIS, UTF_16LE};
+use lol_html::{element, HtmlRewriter, Settings};
+
+fn settings(input_encoding: Option<&'static Encoding>) -> Settings<'static, 'static> {
+    Settings {
+        element_content_handlers: vec![element!("a[href]", |el| {
+            el.set_attribute("rel", "noopener")?;
+            Ok(())
+        })],
+        input_encoding,
+        ..Settings::new()
+    }
+}
+
+fn encode(html: &str, encoding: &'static Encoding) -> Vec<u8> {
+    // NOTE: encoding_rs encodes UTF-16 as UTF-8, as the Encoding Standard requires.
+    if encoding == UTF_16LE {
+        html.encode_utf16().flat_map(u16::to_le_bytes).collect()
+    } else {
+        encoding.encode(html).0.into_owned()
+    }
+}
+
+fn rewrite(settings: Settings<'_, '_>, chunks: &[&[u8]]) -> Vec<u8> {
+    let mut output = vec![];
+    let mut rewriter = HtmlRewriter::new(settings, |c: &[u8]| output.extend_from_slice(c));
+
+    for chunk in chunks {
+        rewriter.write(chunk).unwrap();
+    }
+
+    rewriter.end().unwrap();
+    drop(rewriter);
+
+    output
+}
+
+pub fn group(c: &mut Criterion) {
+    let mut g = c.benchmark_group("Input transcoding");
+
+    for input in crate::INPUTS.iter() {
+        let html = String::from_utf8(input.chunks.concat()).unwrap();
+
+        for encoding in [UTF_16LE, SHIFT_JIS] {
+            let data = encode(&html, encoding);
+            let chunks = data.chunks(crate::CHUNK_SIZE).collect::<Vec<_>>();
+            let name = format!("{}/{}", encoding.name(), input.name);
+
+            g.throughput(Throughput::Bytes(data.len() as u64));
+
+            // NOTE: the document is decoded into a separate buffer before rewriting.
+            g.bench_with_input(BenchmarkId::new("Two-pass", &name), &data, |b, data| {
+                b.iter(|| {
+                    let (html, _) = encoding.decode_with_bom_removal(data);
+                    let chunks = html
+                        .as_bytes()
+                        .chunks(crate::CHUNK_SIZE)
+                        .collect::<Vec<_>>();
+
+                    black_box(rewrite(settings(None), &chunks));
+                });
+            });
+
+            g.bench_with_input(BenchmarkId::new("Fused", &name), &chunks, |b, chunks| {
+                b.iter(|| black_box(rewrite(settings(Some(encoding)), chunks)));
+            });
+        }
+    }
+
+    g.finish();
+}
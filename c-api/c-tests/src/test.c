@@ -16,6 +16,11 @@ int run_tests() {
     subtest("Element API", element_api_test);
     subtest("Document end API", document_end_api_test);
     subtest("Memory limiting", test_memory_limiting);
+    subtest("Rewriter reset", test_rewriter_reset);
+    subtest("Output buffer", test_output_buffer);
+    subtest("Rewriter stats", test_rewriter_stats);
+    subtest("Disabled output", test_disabled_output);
+    subtest("Element rules", test_element_rules_api);
     int res = done_testing();
     if (res) {
         fprintf(stderr, "\nSome tests have failed\n");
@@ -0,0 +1,68 @@
+#include "../../include/lol_html.h"
+#include "deps/picotest/picotest.h"
+#include "tests.h"
+#include "test_util.h"
+
+static void output_sink_unreachable(const char *chunk, size_t chunk_len, void *user_data) {
+    UNUSED(chunk);
+    UNUSED(chunk_len);
+    UNUSED(user_data);
+
+    ok(0);
+}
+
+static lol_html_rewriter_directive_t count_links(
+    lol_html_element_t *element,
+    void *user_data
+) {
+    int *count = (int *)user_data;
+    const char *name = "href";
+
+    ok(lol_html_element_has_attribute(element, name, strlen(name)) == 1);
+    ok(!lol_html_element_set_attribute(element, name, strlen(name), "#", 1));
+
+    (*count)++;
+
+    return LOL_HTML_CONTINUE;
+}
+
+void test_disabled_output() {
+    const char *selector_str = "a[href]";
+    lol_html_selector_t *selector = lol_html_selector_parse(selector_str, strlen(selector_str));
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    int count = 0;
+
+    int err = lol_html_rewriter_builder_add_element_content_handlers(
+        builder,
+        selector,
+        &count_links,
+        &count,
+        NULL,
+        NULL,
+        NULL,
+        NULL
+    );
+
+    ok(!err);
+
+    lol_html_rewriter_builder_disable_output(builder);
+
+    lol_html_rewriter_t *rewriter = create_rewriter(
+        builder,
+        output_sink_unreachable,
+        NULL,
+        MAX_MEMORY
+    );
+
+    const char *chunks[] = { "<div><a hr", "ef=\"/\">foo</a><a href=/bar>", "</a></div>" };
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        ok(!lol_html_rewriter_write(rewriter, chunks[i], strlen(chunks[i])));
+    }
+
+    ok(!lol_html_rewriter_end(rewriter));
+    ok(count == 2);
+
+    lol_html_rewriter_free(rewriter);
+    lol_html_selector_free(selector);
+}
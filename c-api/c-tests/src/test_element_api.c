@@ -148,6 +148,23 @@ static lol_html_rewriter_directive_t get_and_modify_attributes(
 
     ok(value.data == NULL);
 
+    note("Get attribute ref");
+    lol_html_attribute_value_ref_t value_ref = lol_html_element_get_attribute_ref(
+        element,
+        attr1,
+        strlen(attr1)
+    );
+
+    str_eq(value_ref, "42");
+
+    value_ref = lol_html_element_get_attribute_ref(
+        element,
+        attr2,
+        strlen(attr2)
+    );
+
+    ok(value_ref.data == NULL);
+
     note("Set attribute");
     int err = lol_html_element_set_attribute(
         element,
@@ -585,6 +602,7 @@ static lol_html_rewriter_directive_t iterate_element_attributes(
 
     str_eq(name, "foo");
     str_eq(value, "42");
+    str_eq(lol_html_attribute_value_get_ref(attr), "42");
 
     lol_html_str_free(name);
     lol_html_str_free(value);
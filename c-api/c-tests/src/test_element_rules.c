@@ -0,0 +1,103 @@
+#include "../../include/lol_html.h"
+#include "deps/picotest/picotest.h"
+#include "tests.h"
+#include "test_util.h"
+
+#define STR(s) s, strlen(s)
+
+static int EXPECTED_USER_DATA = 42;
+
+EXPECT_OUTPUT(
+    element_rules_output_sink,
+    "<div><a href=\"https://example.com\" rel=\"noopener\">foo</a><!-- ad --></div>",
+    &EXPECTED_USER_DATA,
+    sizeof(EXPECTED_USER_DATA)
+);
+
+static void test_element_rules() {
+    const char *selector_str = "a[href]";
+    lol_html_selector_t *selector = lol_html_selector_parse(selector_str, strlen(selector_str));
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+
+    const lol_html_rewrite_rule_t rules[] = {
+        {
+            .kind = LOL_HTML_RULE_REPLACE_ATTRIBUTE_PREFIX,
+            .name = STR("href"),
+            .value = STR("http:"),
+            .replacement = STR("https:")
+        },
+        { .kind = LOL_HTML_RULE_SET_ATTRIBUTE, .name = STR("rel"), .value = STR("noopener") },
+        { .kind = LOL_HTML_RULE_REMOVE_ATTRIBUTE, .name = STR("target") },
+        { .kind = LOL_HTML_RULE_INSERT_AFTER, .value = STR("<!-- ad -->"), .is_html = true }
+    };
+
+    int err = lol_html_rewriter_builder_add_element_rules(
+        builder,
+        selector,
+        rules,
+        sizeof(rules) / sizeof(rules[0])
+    );
+
+    ok(!err);
+
+    run_rewriter(
+        builder,
+        "<div><a href=\"http://example.com\" target=_blank>foo</a></div>",
+        element_rules_output_sink,
+        &EXPECTED_USER_DATA
+    );
+
+    lol_html_selector_free(selector);
+}
+
+EXPECT_OUTPUT(
+    remove_rule_output_sink,
+    "<div></div>",
+    &EXPECTED_USER_DATA,
+    sizeof(EXPECTED_USER_DATA)
+);
+
+static void test_remove_rule() {
+    const char *selector_str = "script";
+    lol_html_selector_t *selector = lol_html_selector_parse(selector_str, strlen(selector_str));
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    const lol_html_rewrite_rule_t rule = { .kind = LOL_HTML_RULE_REMOVE };
+
+    ok(!lol_html_rewriter_builder_add_element_rules(builder, selector, &rule, 1));
+
+    run_rewriter(builder, "<div><script>foo</script></div>", remove_rule_output_sink, &EXPECTED_USER_DATA);
+
+    lol_html_selector_free(selector);
+}
+
+static void test_invalid_utf8() {
+    const char *selector_str = "div";
+    lol_html_selector_t *selector = lol_html_selector_parse(selector_str, strlen(selector_str));
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    const lol_html_rewrite_rule_t rule = {
+        .kind = LOL_HTML_RULE_SET_ATTRIBUTE,
+        .name = STR("foo"),
+        .value = STR("\xfe")
+    };
+
+    ok(lol_html_rewriter_builder_add_element_rules(builder, selector, &rule, 1) == -1);
+
+    lol_html_str_t msg = lol_html_take_last_error();
+
+    str_eq(msg, "invalid utf-8 sequence of 1 bytes from index 0");
+
+    lol_html_str_free(msg);
+    lol_html_rewriter_builder_free(builder);
+    lol_html_selector_free(selector);
+}
+
+void test_element_rules_api() {
+    note("Element rules");
+    test_element_rules();
+
+    note("Remove rule");
+    test_remove_rule();
+
+    note("Invalid UTF-8");
+    test_invalid_utf8();
+}
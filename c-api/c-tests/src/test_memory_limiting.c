@@ -3,6 +3,59 @@
 #include "tests.h"
 #include "test_util.h"
 
+static lol_html_rewriter_t *build_with_preallocation(
+    lol_html_rewriter_builder_t *builder,
+    size_t preallocated_size
+) {
+    const char *encoding = "UTF-8";
+
+    return lol_html_rewriter_build(
+        builder,
+        encoding,
+        strlen(encoding),
+        (lol_html_memory_settings_t) {
+            .preallocated_parsing_buffer_size = preallocated_size,
+            .max_allowed_memory_usage = SIZE_MAX
+        },
+        output_sink_stub,
+        NULL,
+        true
+    );
+}
+
+static void test_memory_budget() {
+    lol_html_memory_budget_t *budget = lol_html_memory_budget_new(100);
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+
+    lol_html_rewriter_builder_set_memory_budget(builder, budget);
+
+    lol_html_rewriter_t *rewriter1 = build_with_preallocation(builder, 60);
+
+    ok(rewriter1 != NULL);
+    ok(lol_html_memory_budget_usage(budget) == 60);
+    ok(lol_html_memory_budget_available(budget) == 40);
+
+    // NOTE: the budget doesn't have enough memory left for the preallocation.
+    lol_html_rewriter_t *rewriter2 = build_with_preallocation(builder, 60);
+
+    ok(rewriter2 == NULL);
+
+    lol_html_str_t msg = lol_html_take_last_error();
+
+    str_eq(msg, "The memory limit has been exceeded.");
+    lol_html_str_free(msg);
+
+    lol_html_rewriter_free(rewriter1);
+    ok(lol_html_memory_budget_usage(budget) == 0);
+
+    rewriter2 = build_with_preallocation(builder, 60);
+    ok(rewriter2 != NULL);
+
+    lol_html_rewriter_free(rewriter2);
+    lol_html_rewriter_builder_free(builder);
+    lol_html_memory_budget_free(budget);
+}
+
 void test_memory_limiting() {
     const char *chunk1 = "<span alt='aaaaa";
     const int max_memory = 5;
@@ -37,4 +90,6 @@ void test_memory_limiting() {
     lol_html_str_free(msg);
     lol_html_rewriter_free(rewriter);
     lol_html_selector_free(selector);
+
+    test_memory_budget();
 }
@@ -0,0 +1,59 @@
+#include "../../include/lol_html.h"
+#include "deps/picotest/picotest.h"
+#include "tests.h"
+#include "test_util.h"
+
+static void count_chunks(const char *chunk, size_t chunk_len, void *user_data) {
+    UNUSED(chunk);
+
+    if (chunk_len > 0) {
+        (*(int *) user_data)++;
+    }
+}
+
+static int rewrite_and_count_chunks(size_t output_buffer_size, bool flush) {
+    const char *encoding = "UTF-8";
+    const char *chunks[] = { "<div><span>foo", "</span><!-- bar -->", "</div>" };
+    int chunk_count = 0;
+
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    lol_html_rewriter_t *rewriter = lol_html_rewriter_build_with_output_buffer(
+        builder,
+        encoding,
+        strlen(encoding),
+        (lol_html_memory_settings_t) {
+            .preallocated_parsing_buffer_size = 0,
+            .max_allowed_memory_usage = MAX_MEMORY
+        },
+        count_chunks,
+        &chunk_count,
+        true,
+        output_buffer_size
+    );
+
+    lol_html_rewriter_builder_free(builder);
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        ok(!lol_html_rewriter_write(rewriter, chunks[i], strlen(chunks[i])));
+
+        if (flush) {
+            lol_html_rewriter_flush(rewriter);
+        }
+    }
+
+    ok(!lol_html_rewriter_end(rewriter));
+    lol_html_rewriter_free(rewriter);
+
+    return chunk_count;
+}
+
+void test_output_buffer() {
+    note("Unbuffered output");
+    ok(rewrite_and_count_chunks(0, false) > 1);
+
+    note("Buffered output");
+    ok(rewrite_and_count_chunks(4096, false) == 1);
+
+    note("Flushed buffered output");
+    ok(rewrite_and_count_chunks(4096, true) == 3);
+}
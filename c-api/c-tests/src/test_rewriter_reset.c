@@ -0,0 +1,77 @@
+#include "../../include/lol_html.h"
+#include "deps/picotest/picotest.h"
+#include "tests.h"
+#include "test_util.h"
+
+typedef struct {
+    char data[64];
+    size_t len;
+} output_t;
+
+static void collect_output(const char *chunk, size_t chunk_len, void *user_data) {
+    output_t *out = (output_t *) user_data;
+
+    if (out->len + chunk_len <= sizeof(out->data)) {
+        memcpy(out->data + out->len, chunk, chunk_len);
+        out->len += chunk_len;
+    } else {
+        ok(0);
+    }
+}
+
+void test_rewriter_reset() {
+    output_t out = { .len = 0 };
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    lol_html_rewriter_t *rewriter = create_rewriter(builder, collect_output, &out, MAX_MEMORY);
+
+    note("Reset in the middle of a document");
+    const char *unfinished = "<div><script>foo</sc";
+
+    ok(!lol_html_rewriter_write(rewriter, unfinished, strlen(unfinished)));
+    lol_html_rewriter_reset(rewriter);
+    out.len = 0;
+
+    note("Reuse for multiple documents");
+    const char *html = "<p>bar</p>";
+
+    for (int i = 0; i < 3; i++) {
+        ok(!lol_html_rewriter_write(rewriter, html, strlen(html)));
+        ok(!lol_html_rewriter_end_and_reset(rewriter));
+        ok(out.len == strlen(html));
+        ok(!memcmp(out.data, html, out.len));
+        out.len = 0;
+    }
+
+    lol_html_rewriter_free(rewriter);
+
+    note("Reset in the middle of a document with buffered output");
+    const char *encoding = "UTF-8";
+
+    builder = lol_html_rewriter_builder_new();
+    rewriter = lol_html_rewriter_build_with_output_buffer(
+        builder,
+        encoding,
+        strlen(encoding),
+        (lol_html_memory_settings_t) {
+            .preallocated_parsing_buffer_size = 0,
+            .max_allowed_memory_usage = MAX_MEMORY
+        },
+        collect_output,
+        &out,
+        true,
+        4096
+    );
+
+    lol_html_rewriter_builder_free(builder);
+
+    ok(!lol_html_rewriter_write(rewriter, unfinished, strlen(unfinished)));
+    lol_html_rewriter_reset(rewriter);
+    ok(out.len == 0);
+
+    ok(!lol_html_rewriter_write(rewriter, html, strlen(html)));
+    ok(!lol_html_rewriter_end_and_reset(rewriter));
+    ok(out.len == strlen(html));
+    ok(!memcmp(out.data, html, out.len));
+
+    lol_html_rewriter_free(rewriter);
+}
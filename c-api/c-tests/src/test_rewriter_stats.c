@@ -0,0 +1,78 @@
+#include "../../include/lol_html.h"
+#include "deps/picotest/picotest.h"
+#include "tests.h"
+#include "test_util.h"
+
+static lol_html_rewriter_directive_t element_noop(
+    lol_html_element_t *element,
+    void *user_data
+) {
+    UNUSED(element);
+    UNUSED(user_data);
+
+    return LOL_HTML_CONTINUE;
+}
+
+static void test_disabled_stats() {
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+    lol_html_rewriter_t *rewriter = create_rewriter(builder, output_sink_stub, NULL, MAX_MEMORY);
+    lol_html_rewriter_stats_t stats;
+
+    ok(lol_html_rewriter_stats_get(rewriter, &stats) == -1);
+
+    lol_html_str_t msg = lol_html_take_last_error();
+
+    str_eq(msg, "The rewriter has been built without stats enabled.");
+
+    lol_html_str_free(msg);
+    lol_html_rewriter_free(rewriter);
+}
+
+static void test_enabled_stats() {
+    const char *selector_str = "a[href]";
+    lol_html_selector_t *selector = lol_html_selector_parse(selector_str, strlen(selector_str));
+    lol_html_rewriter_builder_t *builder = lol_html_rewriter_builder_new();
+
+    int err = lol_html_rewriter_builder_add_element_content_handlers(
+        builder,
+        selector,
+        &element_noop,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL
+    );
+
+    ok(!err);
+
+    lol_html_rewriter_builder_enable_stats(builder);
+
+    lol_html_rewriter_t *rewriter = create_rewriter(builder, output_sink_stub, NULL, MAX_MEMORY);
+    const char *chunks[] = { "<div><a hr", "ef=\"/\">foo</a></div>" };
+    lol_html_rewriter_stats_t stats;
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        ok(!lol_html_rewriter_write(rewriter, chunks[i], strlen(chunks[i])));
+    }
+
+    ok(!lol_html_rewriter_end_and_reset(rewriter));
+    ok(!lol_html_rewriter_stats_get(rewriter, &stats));
+
+    ok(stats.tag_scanner_bytes + stats.lexer_bytes == strlen(chunks[0]) + strlen(chunks[1]));
+    ok(stats.selector_vm_bailouts == 1);
+    ok(stats.aux_info_requests == 1);
+    ok(stats.buffered_bytes > 0);
+    ok(stats.parsing_buffer_high_water_mark > 0);
+
+    lol_html_rewriter_free(rewriter);
+    lol_html_selector_free(selector);
+}
+
+void test_rewriter_stats() {
+    note("Disabled stats");
+    test_disabled_stats();
+
+    note("Enabled stats");
+    test_enabled_stats();
+}
@@ -11,5 +11,10 @@ void test_text_chunk_api();
 void element_api_test();
 void document_end_api_test();
 void test_memory_limiting();
+void test_rewriter_reset();
+void test_output_buffer();
+void test_rewriter_stats();
+void test_disabled_output();
+void test_element_rules_api();
 
 #endif // TESTS_H
@@ -7,6 +7,7 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // NOTE: all functions that accept pointers will panic abort the thread
 // if NULL pointer is passed (with an exception for the cases where
@@ -30,6 +31,7 @@ typedef struct lol_html_Element lol_html_element_t;
 typedef struct lol_html_AttributesIterator lol_html_attributes_iterator_t;
 typedef struct lol_html_Attribute lol_html_attribute_t;
 typedef struct lol_html_Selector lol_html_selector_t;
+typedef struct lol_html_MemoryBudget lol_html_memory_budget_t;
 typedef struct lol_html_CStreamingHandlerSink lol_html_streaming_sink_t;
 
 // Library-allocated UTF8 string fat pointer.
@@ -61,6 +63,20 @@ typedef struct {
     size_t len;
 } lol_html_text_chunk_content_t;
 
+// Fat pointer to the attribute value as it is encoded in the document.
+//
+// The value is not copied, so unlike `lol_html_str_t` it shouldn't be
+// deallocated manually via `lol_html_str_free` method call. Instead the
+// pointer becomes invalid once the related `lol_html_attribute_t` or
+// `lol_html_element_t` goes out of scope, or the attribute is modified.
+typedef struct {
+    // Value data pointer. NULL if the attribute doesn't exist.
+    const char *data;
+
+    // The length of the value in bytes.
+    size_t len;
+} lol_html_attribute_value_ref_t;
+
 // Utilities
 //---------------------------------------------------------------------
 
@@ -141,6 +157,40 @@ typedef struct lol_html_CStreamingHandler {
     void *reserved;
 } lol_html_streaming_handler_t;
 
+// Kind of a declarative rewrite rule.
+typedef enum {
+    // Sets the `name` attribute to `value`, adding the attribute if it doesn't exist.
+    LOL_HTML_RULE_SET_ATTRIBUTE,
+    // Removes the `name` attribute.
+    LOL_HTML_RULE_REMOVE_ATTRIBUTE,
+    // Replaces the `value` prefix of the `name` attribute value with `replacement`.
+    // The attribute is left intact if its value doesn't start with the prefix.
+    LOL_HTML_RULE_REPLACE_ATTRIBUTE_PREFIX,
+    // Inserts `value` before the element.
+    LOL_HTML_RULE_INSERT_BEFORE,
+    // Inserts `value` after the element.
+    LOL_HTML_RULE_INSERT_AFTER,
+    // Removes the element with its content.
+    LOL_HTML_RULE_REMOVE
+} lol_html_rewrite_rule_kind_t;
+
+// Declarative rewrite rule that is applied to the matched elements by the
+// rewriter itself, without calling a handler.
+//
+// All strings should be valid UTF8-strings. The strings that are not used by
+// the rule `kind` are ignored and can be NULL.
+typedef struct {
+    lol_html_rewrite_rule_kind_t kind;
+    const char *name;
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+    const char *replacement;
+    size_t replacement_len;
+    // If `true`, the inserted content is written without HTML-escaping.
+    bool is_html;
+} lol_html_rewrite_rule_t;
+
 // Selector
 //---------------------------------------------------------------------
 
@@ -162,6 +212,30 @@ lol_html_selector_t *lol_html_selector_parse(
 void lol_html_selector_free(lol_html_selector_t *selector);
 
 
+// Memory budget
+//---------------------------------------------------------------------
+
+// Creates a memory budget of `max` bytes that can be shared by several
+// rewriters, including the rewriters used in different threads (see
+// `lol_html_rewriter_builder_set_memory_budget`).
+//
+// The rewriters take the memory from the budget in blocks, so the usage of
+// the budget can exceed the memory actually used by the rewriters by a few
+// blocks per rewriter.
+lol_html_memory_budget_t *lol_html_memory_budget_new(size_t max);
+
+// Returns the number of bytes taken from the budget by the rewriters.
+size_t lol_html_memory_budget_usage(const lol_html_memory_budget_t *budget);
+
+// Returns the number of bytes left in the budget. Can be used to detect
+// the memory pressure before new rewriters are built.
+size_t lol_html_memory_budget_available(const lol_html_memory_budget_t *budget);
+
+// Frees the memory held by the budget object. The rewriters and the builders
+// that use the budget keep it alive, so it can be freed before them.
+void lol_html_memory_budget_free(lol_html_memory_budget_t *budget);
+
+
 // Rewriter builder
 //---------------------------------------------------------------------
 
@@ -228,6 +302,57 @@ int lol_html_rewriter_builder_add_element_content_handlers(
     void *text_handler_user_data
 );
 
+// Adds rewrite rules to the builder for the given CSS selector. The rules are
+// applied in order to each matched element.
+//
+// Unlike the element handlers, the rules are applied without calling back
+// into C, so fixed modifications of the elements, e.g. setting an attribute,
+// are cheaper with them. The rules are copied immediately.
+//
+// Returns 0 in case of success and -1 otherwise. The actual error message
+// can be obtained using `lol_html_take_last_error` function. An invalid
+// attribute name makes `write()` or `end()` of the rewriter return an error.
+int lol_html_rewriter_builder_add_element_rules(
+    lol_html_rewriter_builder_t *builder,
+    const lol_html_selector_t *selector,
+    const lol_html_rewrite_rule_t *rules,
+    size_t rules_len
+);
+
+// Makes the rewriters built with the builder collect stats that can be
+// obtained with `lol_html_rewriter_stats_get`. Collecting the stats adds a
+// small overhead to the rewriting.
+//
+// NOTE: only available if the library is built with the `stats` cargo feature.
+void lol_html_rewriter_builder_enable_stats(lol_html_rewriter_builder_t *builder);
+
+// Makes the rewriters built with the builder produce no output: the output
+// sink is never called. The content handlers are still invoked and can read
+// the content, but the modifications they make have no effect. Useful for
+// the analysis of documents, as the serialization of the output is skipped.
+void lol_html_rewriter_builder_disable_output(lol_html_rewriter_builder_t *builder);
+
+// Makes the rewriters built with the builder take their memory from the
+// `budget` in addition to the `max_allowed_memory_usage` limit of their
+// memory settings.
+//
+// Building a rewriter fails if the budget doesn't have enough memory left
+// for its `preallocated_parsing_buffer_size`.
+void lol_html_rewriter_builder_set_memory_budget(
+    lol_html_rewriter_builder_t *builder,
+    const lol_html_memory_budget_t *budget
+);
+
+// Sets the size of the buffer used by the rewriters built with the builder to
+// decode text in non-UTF-8 encodings. Text handlers receive decoded text in
+// chunks no larger than this buffer.
+//
+// Can be set to 0, in which case the default size of 1024 bytes is used.
+void lol_html_rewriter_builder_set_text_decoder_buffer_size(
+    lol_html_rewriter_builder_t *builder,
+    size_t size
+);
+
 // Frees the memory held by the builder.
 //
 // Note that builder can be freed before any rewriters constructed from
@@ -265,7 +390,10 @@ typedef struct {
 // there is no way to determine correct parsing context. Recommended
 // setting for safety reasons.
 //
-// In case of an error the function returns a NULL pointer.
+// In case of an error the function returns a NULL pointer. The actual error
+// message can be obtained using `lol_html_take_last_error` function. Among
+// other errors, the function fails if `preallocated_parsing_buffer_size`
+// exceeds `max_allowed_memory_usage` or the memory budget of the builder.
 lol_html_rewriter_t *lol_html_rewriter_build(
     lol_html_rewriter_builder_t *builder,
     const char *encoding,
@@ -276,6 +404,23 @@ lol_html_rewriter_t *lol_html_rewriter_build(
     bool strict
 );
 
+// Same as `lol_html_rewriter_build`, but the output is accumulated in a buffer
+// of `output_buffer_size` bytes and is passed to `output_sink` only once the
+// buffer is full, so `output_sink` is invoked with fewer, larger chunks.
+// Chunks that are larger than the buffer are passed to `output_sink` as is.
+//
+// The buffer is flushed before the zero-length chunk on the end of the output.
+lol_html_rewriter_t *lol_html_rewriter_build_with_output_buffer(
+    lol_html_rewriter_builder_t *builder,
+    const char *encoding,
+    size_t encoding_len,
+    lol_html_memory_settings_t memory_settings,
+    void (*output_sink)(const char *chunk, size_t chunk_len, void *user_data),
+    void *output_sink_user_data,
+    bool strict,
+    size_t output_buffer_size
+);
+
 lol_html_rewriter_t *unstable_lol_html_rewriter_build_with_esi_tags(
     lol_html_rewriter_builder_t *builder,
     const char *encoding,
@@ -299,6 +444,15 @@ int lol_html_rewriter_write(
     size_t chunk_len
 );
 
+// Passes the output accumulated in the buffer of a rewriter built with
+// `lol_html_rewriter_build_with_output_buffer` to `output_sink` without waiting
+// for the buffer to fill up, e.g. to send the rewritten part of a document to
+// a streaming client. Does nothing if the buffer is empty.
+//
+// WARNING: calling this function after `lol_html_rewriter_end` will cause a
+// thread panic.
+void lol_html_rewriter_flush(lol_html_rewriter_t *rewriter);
+
 // Completes rewriting and flushes the remaining output.
 //
 // Returns 0 in case of success and -1 otherwise. The actual error message
@@ -308,6 +462,87 @@ int lol_html_rewriter_write(
 // (other than `lol_html_rewriter_free`) will cause a thread panic.
 int lol_html_rewriter_end(lol_html_rewriter_t *rewriter);
 
+// Completes rewriting of the current document like `lol_html_rewriter_end` does,
+// and then resets the rewriter (see `lol_html_rewriter_reset`), so it can be used
+// to rewrite the next document.
+//
+// Returns 0 in case of success and -1 otherwise. The actual error message
+// can be obtained using `lol_html_take_last_error` function. The rewriter is
+// reset even if an error occurs.
+//
+// WARNING: if the rewriter has a document end handler, it's not reset, and any
+// further attempts to use it (other than `lol_html_rewriter_free` and getting the
+// stats) will cause a thread panic.
+int lol_html_rewriter_end_and_reset(lol_html_rewriter_t *rewriter);
+
+// Returns the rewriter to its initial state, discarding the document that is
+// currently being rewritten, if any. Buffers allocated by the rewriter are kept,
+// so reusing one rewriter for many documents is cheaper than building a new one
+// for each of them. The rewriter can be reset after an error as well. The output
+// of the discarded document that hasn't been passed to `output_sink` yet (see
+// `lol_html_rewriter_build_with_output_buffer`) is dropped.
+//
+// WARNING: calling this function after `lol_html_rewriter_end`, or if the rewriter
+// has a document end handler, will cause a thread panic. Document end handlers can
+// only be invoked at the end of one document.
+void lol_html_rewriter_reset(lol_html_rewriter_t *rewriter);
+
+// Counters of the work done by the rewriter.
+typedef struct {
+    // Number of input bytes consumed by the parser in the tag scanning mode,
+    // in which only the tag names are parsed.
+    uint64_t tag_scanner_bytes;
+
+    // Number of input bytes consumed by the parser in the lexing mode, in
+    // which all of the content is tokenized.
+    uint64_t lexer_bytes;
+
+    // Number of times the parser has switched between the tag scanning and
+    // the lexing modes.
+    uint64_t parser_directive_switches;
+
+    // Number of times the selector matching has been suspended until the
+    // attributes of a start tag are parsed.
+    uint64_t selector_vm_bailouts;
+
+    // Number of start tags for which the attributes or the self-closing flag
+    // have been requested from the parser.
+    uint64_t aux_info_requests;
+
+    // The largest amount of input, in bytes, held in the parsing buffer.
+    uint64_t parsing_buffer_high_water_mark;
+
+    // Number of input bytes copied to the parsing buffer, because they couldn't
+    // be parsed until more input is written.
+    uint64_t buffered_bytes;
+
+    // Number of text bytes decoded by the streaming decoder rather than by the
+    // fast path for UTF-8 and ASCII text.
+    uint64_t decoder_slow_path_bytes;
+
+    // Time spent in the content handlers, in nanoseconds. Only the invocations
+    // of the handlers are timed, the parsing and the serialization of the
+    // content are not.
+    uint64_t handler_nanos;
+} lol_html_rewriter_stats_t;
+
+// Writes the stats collected by the rewriter to `stats`. The stats accumulate
+// over all of the documents rewritten by the rewriter, they are not cleared by
+// `lol_html_rewriter_reset`.
+//
+// Returns 0 in case of success and -1 if the rewriter has been built without
+// `lol_html_rewriter_builder_enable_stats`. The actual error message can be
+// obtained using `lol_html_take_last_error` function.
+//
+// NOTE: only available if the library is built with the `stats` cargo feature.
+//
+// WARNING: calling this function after `lol_html_rewriter_end` will cause a thread panic.
+// Use `lol_html_rewriter_end_and_reset` to get the stats for the end of the document.
+int lol_html_rewriter_stats_get(
+    const lol_html_rewriter_t *rewriter,
+    lol_html_rewriter_stats_t *stats
+);
+
 // Frees the memory held by the rewriter.
 void lol_html_rewriter_free(lol_html_rewriter_t *rewriter);
 
@@ -582,6 +817,18 @@ lol_html_str_t lol_html_attribute_name_get_preserve_case(const lol_html_attribut
 // Returns the attribute value.
 lol_html_str_t lol_html_attribute_value_get(const lol_html_attribute_t *attribute);
 
+// Returns a fat pointer to the attribute value without copying it.
+//
+// The value is returned as it is encoded in the document, so it is a UTF8-string
+// only if the document's encoding is UTF-8. Character references in the value are not
+// decoded.
+//
+// WARNING: The pointer is valid only during the handler execution and
+// should never be leaked outside of handlers.
+lol_html_attribute_value_ref_t lol_html_attribute_value_get_ref(
+    const lol_html_attribute_t *attribute
+);
+
 // Returns the attribute value. The `data` field will be NULL if an attribute with the given name
 // doesn't exist on the element.
 //
@@ -595,6 +842,19 @@ lol_html_str_t lol_html_element_get_attribute(
     size_t name_len
 );
 
+// Same as `lol_html_element_get_attribute`, but returns a fat pointer to the attribute
+// value without copying it (see `lol_html_attribute_value_get_ref`). The `data` field
+// will be NULL if an attribute with the given name doesn't exist on the element or if
+// the provided name is invalid UTF8-string.
+//
+// WARNING: The pointer is valid only during the handler execution and
+// should never be leaked outside of handlers.
+lol_html_attribute_value_ref_t lol_html_element_get_attribute_ref(
+    const lol_html_element_t *element,
+    const char *name,
+    size_t name_len
+);
+
 // Returns 1 if element has attribute with the given name, and 0 otherwise.
 // Returns -1 in case of an error.
 //
@@ -92,6 +92,36 @@ pub unsafe extern "C" fn lol_html_attribute_value_get(attribute: *const Attribut
     Str::new(attribute.value())
 }
 
+#[repr(C)]
+pub struct AttributeValueRef {
+    data: *const c_char,
+    len: size_t,
+}
+
+impl AttributeValueRef {
+    fn new(value: Option<&[u8]>) -> Self {
+        match value {
+            Some(value) => Self {
+                data: value.as_ptr().cast::<c_char>(),
+                len: value.len(),
+            },
+            None => Self {
+                data: ptr::null(),
+                len: 0,
+            },
+        }
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_attribute_value_get_ref(
+    attribute: *const Attribute,
+) -> AttributeValueRef {
+    let attribute = to_ref!(attribute);
+
+    AttributeValueRef::new(Some(attribute.value_bytes()))
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn lol_html_element_get_attribute(
     element: *const Element,
@@ -104,6 +134,18 @@ pub unsafe extern "C" fn lol_html_element_get_attribute(
     Str::from_opt(element.get_attribute(name))
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_element_get_attribute_ref(
+    element: *const Element,
+    name: *const c_char,
+    name_len: size_t,
+) -> AttributeValueRef {
+    let element = to_ref!(element);
+    let name = unwrap_or_ret!(to_str!(name, name_len), AttributeValueRef::new(None));
+
+    AttributeValueRef::new(element.get_attribute_ref(name).map(Attribute::value_bytes))
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn lol_html_element_has_attribute(
     element: *const Element,
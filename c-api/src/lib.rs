@@ -223,6 +223,7 @@ pub mod doctype;
 pub mod document_end;
 pub mod element;
 pub mod errors;
+pub mod memory_budget;
 pub mod rewriter;
 pub mod rewriter_builder;
 pub mod selector;
@@ -253,3 +254,12 @@ pub enum EncodingError {
     #[error("Expected ASCII-compatible encoding.")]
     NonAsciiCompatibleEncoding,
 }
+
+/// An error that occurs if the stats are requested from a rewriter that doesn't collect them.
+#[cfg(feature = "stats")]
+#[derive(Error, Debug, PartialEq, Copy, Clone)]
+pub enum RewriterStatsError {
+    /// The rewriter has been built without `lol_html_rewriter_builder_enable_stats`.
+    #[error("The rewriter has been built without stats enabled.")]
+    Disabled,
+}
@@ -0,0 +1,21 @@
+use super::*;
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_memory_budget_new(max: size_t) -> *mut MemoryBudget {
+    to_ptr_mut(MemoryBudget::new(max))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_memory_budget_usage(budget: *const MemoryBudget) -> size_t {
+    to_ref!(budget).usage()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_memory_budget_available(budget: *const MemoryBudget) -> size_t {
+    to_ref!(budget).available()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_memory_budget_free(budget: *mut MemoryBudget) {
+    drop(to_box!(budget));
+}
@@ -12,7 +12,9 @@ pub struct ExternOutputSink {
 
 /// This is a wrapper around `lol_html::HtmlRewriter` which allows
 /// use after the rewriter itself is dropped.
-pub struct HtmlRewriter(Option<lol_html::HtmlRewriter<'static, ExternOutputSink>>);
+pub struct HtmlRewriter(
+    Option<lol_html::HtmlRewriter<'static, BufferedOutputSink<ExternOutputSink>>>,
+);
 
 impl ExternOutputSink {
     #[inline]
@@ -34,8 +36,8 @@ impl OutputSink for ExternOutputSink {
     }
 }
 
-#[no_mangle]
-pub unsafe extern "C" fn lol_html_rewriter_build(
+#[allow(clippy::too_many_arguments)]
+unsafe fn build(
     builder: *mut HtmlRewriterBuilder,
     encoding: *const c_char,
     encoding_len: size_t,
@@ -43,6 +45,8 @@ pub unsafe extern "C" fn lol_html_rewriter_build(
     output_sink: unsafe extern "C" fn(*const c_char, size_t, *mut c_void),
     output_sink_user_data: *mut c_void,
     strict: bool,
+    enable_esi_tags: bool,
+    output_buffer_size: size_t,
 ) -> *mut HtmlRewriter {
     let builder = to_ref!(builder);
     let handlers = builder.get_safe_handlers();
@@ -54,20 +58,34 @@ pub unsafe extern "C" fn lol_html_rewriter_build(
         element_content_handlers: handlers.element,
         document_content_handlers: handlers.document,
         encoding: unwrap_or_ret_null! { encoding.try_into().or(Err(EncodingError::NonAsciiCompatibleEncoding)) },
+        input_encoding: None,
         memory_settings,
+        memory_budget: builder.memory_budget.clone(),
+        buffer_pool: None,
+        parsing_buffer_histogram: None,
+        text_decoder_buffer_size: builder.text_decoder_buffer_size,
         strict,
-        enable_esi_tags: false,
+        enable_esi_tags,
         adjust_charset_on_meta_tag: false,
+        disable_output: builder.disable_output,
+        sanitizer: None,
+        #[cfg(feature = "stats")]
+        enable_stats: builder.enable_stats,
     };
 
-    let output_sink = ExternOutputSink::new(output_sink, output_sink_user_data);
-    let rewriter = lol_html::HtmlRewriter::new(settings, output_sink);
+    // NOTE: with zero-sized buffer the chunks are passed to the sink as is.
+    let output_sink = BufferedOutputSink::new(
+        output_buffer_size,
+        ExternOutputSink::new(output_sink, output_sink_user_data),
+    );
+
+    let rewriter = unwrap_or_ret_null! { lol_html::HtmlRewriter::try_new(settings, output_sink) };
 
     to_ptr_mut(HtmlRewriter(Some(rewriter)))
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn unstable_lol_html_rewriter_build_with_esi_tags(
+pub unsafe extern "C" fn lol_html_rewriter_build(
     builder: *mut HtmlRewriterBuilder,
     encoding: *const c_char,
     encoding_len: size_t,
@@ -76,26 +94,64 @@ pub unsafe extern "C" fn unstable_lol_html_rewriter_build_with_esi_tags(
     output_sink_user_data: *mut c_void,
     strict: bool,
 ) -> *mut HtmlRewriter {
-    let builder = to_ref!(builder);
-    let handlers = builder.get_safe_handlers();
-
-    let maybe_encoding =
-        encoding_rs::Encoding::for_label_no_replacement(to_bytes!(encoding, encoding_len));
-    let encoding = unwrap_or_ret_null! { maybe_encoding.ok_or(EncodingError::UnknownEncoding) };
-    let settings = Settings {
-        element_content_handlers: handlers.element,
-        document_content_handlers: handlers.document,
-        encoding: unwrap_or_ret_null! { encoding.try_into().or(Err(EncodingError::NonAsciiCompatibleEncoding)) },
+    build(
+        builder,
+        encoding,
+        encoding_len,
         memory_settings,
+        output_sink,
+        output_sink_user_data,
         strict,
-        enable_esi_tags: true,
-        adjust_charset_on_meta_tag: false,
-    };
+        false,
+        0,
+    )
+}
 
-    let output_sink = ExternOutputSink::new(output_sink, output_sink_user_data);
-    let rewriter = lol_html::HtmlRewriter::new(settings, output_sink);
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_build_with_output_buffer(
+    builder: *mut HtmlRewriterBuilder,
+    encoding: *const c_char,
+    encoding_len: size_t,
+    memory_settings: MemorySettings,
+    output_sink: unsafe extern "C" fn(*const c_char, size_t, *mut c_void),
+    output_sink_user_data: *mut c_void,
+    strict: bool,
+    output_buffer_size: size_t,
+) -> *mut HtmlRewriter {
+    build(
+        builder,
+        encoding,
+        encoding_len,
+        memory_settings,
+        output_sink,
+        output_sink_user_data,
+        strict,
+        false,
+        output_buffer_size,
+    )
+}
 
-    to_ptr_mut(HtmlRewriter(Some(rewriter)))
+#[no_mangle]
+pub unsafe extern "C" fn unstable_lol_html_rewriter_build_with_esi_tags(
+    builder: *mut HtmlRewriterBuilder,
+    encoding: *const c_char,
+    encoding_len: size_t,
+    memory_settings: MemorySettings,
+    output_sink: unsafe extern "C" fn(*const c_char, size_t, *mut c_void),
+    output_sink_user_data: *mut c_void,
+    strict: bool,
+) -> *mut HtmlRewriter {
+    build(
+        builder,
+        encoding,
+        encoding_len,
+        memory_settings,
+        output_sink,
+        output_sink_user_data,
+        strict,
+        true,
+        0,
+    )
 }
 
 #[no_mangle]
@@ -115,6 +171,16 @@ pub unsafe extern "C" fn lol_html_rewriter_write(
     0
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_flush(rewriter: *mut HtmlRewriter) {
+    to_ref_mut!(rewriter)
+        .0
+        .as_mut()
+        .expect("cannot call `lol_html_rewriter_flush` after calling `end()`")
+        .output_sink_mut()
+        .flush();
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn lol_html_rewriter_end(rewriter: *mut HtmlRewriter) -> c_int {
     let rewriter = to_ref_mut!(rewriter)
@@ -127,6 +193,76 @@ pub unsafe extern "C" fn lol_html_rewriter_end(rewriter: *mut HtmlRewriter) -> c
     0
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_end_and_reset(rewriter: *mut HtmlRewriter) -> c_int {
+    let rewriter = to_ref_mut!(rewriter)
+        .0
+        .as_mut()
+        .expect("cannot call `lol_html_rewriter_end_and_reset` after calling `end()`");
+
+    unwrap_or_ret_err_code! { rewriter.end_and_reset() };
+
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_reset(rewriter: *mut HtmlRewriter) {
+    to_ref_mut!(rewriter)
+        .0
+        .as_mut()
+        .expect("cannot call `lol_html_rewriter_reset` after calling `end()`")
+        .reset();
+}
+
+#[cfg(feature = "stats")]
+#[repr(C)]
+pub struct CRewriterStats {
+    tag_scanner_bytes: u64,
+    lexer_bytes: u64,
+    parser_directive_switches: u64,
+    selector_vm_bailouts: u64,
+    aux_info_requests: u64,
+    parsing_buffer_high_water_mark: u64,
+    buffered_bytes: u64,
+    decoder_slow_path_bytes: u64,
+    handler_nanos: u64,
+}
+
+#[cfg(feature = "stats")]
+impl From<RewriterStats> for CRewriterStats {
+    fn from(stats: RewriterStats) -> Self {
+        Self {
+            tag_scanner_bytes: stats.tag_scanner_bytes,
+            lexer_bytes: stats.lexer_bytes,
+            parser_directive_switches: stats.parser_directive_switches,
+            selector_vm_bailouts: stats.selector_vm_bailouts,
+            aux_info_requests: stats.aux_info_requests,
+            parsing_buffer_high_water_mark: stats.parsing_buffer_high_water_mark,
+            buffered_bytes: stats.buffered_bytes,
+            decoder_slow_path_bytes: stats.decoder_slow_path_bytes,
+            handler_nanos: stats.handler_nanos,
+        }
+    }
+}
+
+#[cfg(feature = "stats")]
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_stats_get(
+    rewriter: *const HtmlRewriter,
+    stats: *mut CRewriterStats,
+) -> c_int {
+    let rewriter = to_ref!(rewriter)
+        .0
+        .as_ref()
+        .expect("cannot call `lol_html_rewriter_stats_get` after calling `end()`");
+    let rewriter_stats =
+        unwrap_or_ret_err_code! { rewriter.stats().ok_or(RewriterStatsError::Disabled) };
+
+    *to_ref_mut!(stats) = rewriter_stats.into();
+
+    0
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn lol_html_rewriter_free(rewriter: *mut HtmlRewriter) {
     // SAFETY: `to_box` includes a check that `rewriter` is non-null.
@@ -71,10 +71,33 @@ impl ExternDocumentContentHandlers {
     }
 }
 
+#[repr(C)]
+pub enum RewriteRuleKind {
+    SetAttribute,
+    RemoveAttribute,
+    ReplaceAttributePrefix,
+    InsertBefore,
+    InsertAfter,
+    Remove,
+}
+
+#[repr(C)]
+pub struct CRewriteRule {
+    kind: RewriteRuleKind,
+    name: *const c_char,
+    name_len: size_t,
+    value: *const c_char,
+    value_len: size_t,
+    replacement: *const c_char,
+    replacement_len: size_t,
+    is_html: bool,
+}
+
 pub struct ExternElementContentHandlers {
     element: ExternHandler<ElementHandler>,
     comments: ExternHandler<CommentsHandler>,
     text: ExternHandler<TextHandler>,
+    rules: Vec<RewriteRule>,
 }
 
 impl ExternElementContentHandlers {
@@ -82,6 +105,10 @@ impl ExternElementContentHandlers {
     pub fn as_safe_element_content_handlers(&self) -> ElementContentHandlers {
         let mut handlers = ElementContentHandlers::default();
 
+        if !self.rules.is_empty() {
+            handlers = handlers.rules(&self.rules[..]);
+        }
+
         add_handler!(handlers, Element, self.element);
         add_handler!(handlers, Comment, self.comments);
         add_handler!(handlers, TextChunk, self.text);
@@ -99,6 +126,11 @@ pub struct SafeContentHandlers<'b> {
 pub struct HtmlRewriterBuilder {
     document_content_handlers: Vec<ExternDocumentContentHandlers>,
     element_content_handlers: Vec<(&'static Selector, ExternElementContentHandlers)>,
+    #[cfg(feature = "stats")]
+    pub enable_stats: bool,
+    pub disable_output: bool,
+    pub memory_budget: Option<MemoryBudget>,
+    pub text_decoder_buffer_size: usize,
 }
 
 impl HtmlRewriterBuilder {
@@ -166,6 +198,80 @@ pub unsafe extern "C" fn lol_html_rewriter_builder_add_element_content_handlers(
         element: ExternHandler::new(element_handler, element_handler_user_data),
         comments: ExternHandler::new(comments_handler, comments_handler_user_data),
         text: ExternHandler::new(text_handler, text_handler_user_data),
+        rules: Vec::new(),
+    };
+
+    builder.element_content_handlers.push((selector, handlers));
+
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_builder_add_element_rules(
+    builder: *mut HtmlRewriterBuilder,
+    selector: *const Selector,
+    rules: *const CRewriteRule,
+    rules_len: size_t,
+) -> c_int {
+    let selector = to_ref!(selector);
+    let builder = to_ref_mut!(builder);
+    let rules = if rules_len == 0 {
+        &[]
+    } else {
+        assert_not_null!(rules);
+        unsafe { slice::from_raw_parts(rules, rules_len) }
+    };
+
+    let mut native_rules = Vec::with_capacity(rules.len());
+
+    for rule in rules {
+        let CRewriteRule {
+            name,
+            name_len,
+            value,
+            value_len,
+            replacement,
+            replacement_len,
+            ..
+        } = *rule;
+
+        let content_type = if rule.is_html {
+            ContentType::Html
+        } else {
+            ContentType::Text
+        };
+
+        native_rules.push(match rule.kind {
+            RewriteRuleKind::SetAttribute => RewriteRule::SetAttribute {
+                name: unwrap_or_ret_err_code! { to_str!(name, name_len) }.to_owned(),
+                value: unwrap_or_ret_err_code! { to_str!(value, value_len) }.to_owned(),
+            },
+            RewriteRuleKind::RemoveAttribute => RewriteRule::RemoveAttribute {
+                name: unwrap_or_ret_err_code! { to_str!(name, name_len) }.to_owned(),
+            },
+            RewriteRuleKind::ReplaceAttributePrefix => RewriteRule::ReplaceAttributePrefix {
+                name: unwrap_or_ret_err_code! { to_str!(name, name_len) }.to_owned(),
+                prefix: unwrap_or_ret_err_code! { to_str!(value, value_len) }.to_owned(),
+                replacement: unwrap_or_ret_err_code! { to_str!(replacement, replacement_len) }
+                    .to_owned(),
+            },
+            RewriteRuleKind::InsertBefore => RewriteRule::InsertBefore {
+                content: unwrap_or_ret_err_code! { to_str!(value, value_len) }.to_owned(),
+                content_type,
+            },
+            RewriteRuleKind::InsertAfter => RewriteRule::InsertAfter {
+                content: unwrap_or_ret_err_code! { to_str!(value, value_len) }.to_owned(),
+                content_type,
+            },
+            RewriteRuleKind::Remove => RewriteRule::Remove,
+        });
+    }
+
+    let handlers = ExternElementContentHandlers {
+        element: ExternHandler::new(None, ptr::null_mut()),
+        comments: ExternHandler::new(None, ptr::null_mut()),
+        text: ExternHandler::new(None, ptr::null_mut()),
+        rules: native_rules,
     };
 
     builder.element_content_handlers.push((selector, handlers));
@@ -173,6 +279,37 @@ pub unsafe extern "C" fn lol_html_rewriter_builder_add_element_content_handlers(
     0
 }
 
+#[cfg(feature = "stats")]
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_builder_enable_stats(builder: *mut HtmlRewriterBuilder) {
+    to_ref_mut!(builder).enable_stats = true;
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_builder_disable_output(
+    builder: *mut HtmlRewriterBuilder,
+) {
+    to_ref_mut!(builder).disable_output = true;
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_builder_set_memory_budget(
+    builder: *mut HtmlRewriterBuilder,
+    budget: *const MemoryBudget,
+) {
+    let budget = to_ref!(budget);
+
+    to_ref_mut!(builder).memory_budget = Some(budget.clone());
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn lol_html_rewriter_builder_set_text_decoder_buffer_size(
+    builder: *mut HtmlRewriterBuilder,
+    size: size_t,
+) {
+    to_ref_mut!(builder).text_decoder_buffer_size = size;
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn lol_html_rewriter_builder_free(builder: *mut HtmlRewriterBuilder) {
     drop(to_box!(builder));
@@ -5,10 +5,13 @@ use super::element::Element;
 use super::text_chunk::TextChunk;
 use super::*;
 use js_sys::Function as JsFunction;
+use lol_html::html_content::Element as NativeElement;
 use lol_html::{
     DocumentContentHandlers as NativeDocumentContentHandlers,
-    ElementContentHandlers as NativeElementContentHandlers,
+    ElementContentHandlers as NativeElementContentHandlers, RewriteRule as NativeRewriteRule,
 };
+use serde::Deserialize;
+use serde_wasm_bindgen::from_value as from_js_value;
 use thiserror::Error;
 
 #[derive(Error, Debug)]
@@ -34,10 +37,76 @@ macro_rules! make_handler {
     }};
 }
 
+#[derive(Deserialize)]
+#[serde(tag = "type", rename_all = "camelCase")]
+enum RewriteRule {
+    SetAttribute {
+        name: String,
+        value: String,
+    },
+    RemoveAttribute {
+        name: String,
+    },
+    ReplaceAttributePrefix {
+        name: String,
+        prefix: String,
+        replacement: String,
+    },
+    InsertBefore {
+        content: String,
+        #[serde(default)]
+        html: bool,
+    },
+    InsertAfter {
+        content: String,
+        #[serde(default)]
+        html: bool,
+    },
+    Remove,
+}
+
+fn content_type(html: bool) -> NativeContentType {
+    if html {
+        NativeContentType::Html
+    } else {
+        NativeContentType::Text
+    }
+}
+
+impl IntoNative<NativeRewriteRule> for RewriteRule {
+    fn into_native(self) -> NativeRewriteRule {
+        match self {
+            Self::SetAttribute { name, value } => NativeRewriteRule::SetAttribute { name, value },
+            Self::RemoveAttribute { name } => NativeRewriteRule::RemoveAttribute { name },
+            Self::ReplaceAttributePrefix {
+                name,
+                prefix,
+                replacement,
+            } => NativeRewriteRule::ReplaceAttributePrefix {
+                name,
+                prefix,
+                replacement,
+            },
+            Self::InsertBefore { content, html } => NativeRewriteRule::InsertBefore {
+                content,
+                content_type: content_type(html),
+            },
+            Self::InsertAfter { content, html } => NativeRewriteRule::InsertAfter {
+                content,
+                content_type: content_type(html),
+            },
+            Self::Remove => NativeRewriteRule::Remove,
+        }
+    }
+}
+
 #[wasm_bindgen]
 extern "C" {
     pub type ElementContentHandlers;
 
+    #[wasm_bindgen(method, getter)]
+    fn rules(this: &ElementContentHandlers) -> JsValue;
+
     #[wasm_bindgen(method, getter)]
     fn element(this: &ElementContentHandlers) -> Option<JsFunction>;
 
@@ -48,12 +117,34 @@ extern "C" {
     fn text(this: &ElementContentHandlers) -> Option<JsFunction>;
 }
 
-impl IntoNative<NativeElementContentHandlers<'static>> for ElementContentHandlers {
-    fn into_native(self) -> NativeElementContentHandlers<'static> {
+impl ElementContentHandlers {
+    // NOTE: the rules are applied natively, without calling into JS. If there is also
+    // an element handler, it's called after the rules have been applied.
+    pub fn try_into_native(self) -> JsResult<NativeElementContentHandlers<'static>> {
         let mut native = NativeElementContentHandlers::default();
+        let rules = self.rules();
+
+        if !rules.is_undefined() {
+            let rules: Vec<RewriteRule> = from_js_value(rules)?;
+
+            native = native.rules(
+                rules
+                    .into_iter()
+                    .map(IntoNative::into_native)
+                    .collect::<Vec<_>>(),
+            );
+        }
 
         if let Some(handler) = self.element() {
-            native = native.element(make_handler!(handler, Element, lol_html::ElementHandler));
+            let mut handler = make_handler!(handler, Element, lol_html::ElementHandler);
+
+            native.element = Some(match native.element.take() {
+                Some(mut rules_handler) => Box::new(move |el: &mut NativeElement<'_, '_>| {
+                    rules_handler(el)?;
+                    handler(el)
+                }),
+                None => handler,
+            });
         }
 
         if let Some(handler) = self.comments() {
@@ -64,7 +155,7 @@ impl IntoNative<NativeElementContentHandlers<'static>> for ElementContentHandler
             native = native.text(make_handler!(handler, TextChunk, lol_html::TextHandler));
         }
 
-        native
+        Ok(native)
     }
 }
 
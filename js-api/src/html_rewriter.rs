@@ -3,9 +3,15 @@ use super::*;
 use encoding_rs::Encoding;
 use js_sys::{Error as JsError, Function as JsFunction, Uint8Array};
 use lol_html::errors::RewritingError;
+#[cfg(feature = "stats")]
+use lol_html::RewriterStats;
 use lol_html::{
     AsciiCompatibleEncoding, HtmlRewriter as NativeHTMLRewriter, OutputSink, Selector, Settings,
 };
+#[cfg(feature = "stats")]
+use serde::Serialize;
+#[cfg(feature = "stats")]
+use serde_wasm_bindgen::to_value as to_js_value;
 use std::borrow::Cow;
 
 fn map_err(err: RewritingError) -> JsValue {
@@ -34,6 +40,38 @@ impl OutputSink for JsOutputSink {
     }
 }
 
+#[cfg(feature = "stats")]
+#[derive(Serialize)]
+#[serde(rename_all = "camelCase")]
+struct Stats {
+    tag_scanner_bytes: u64,
+    lexer_bytes: u64,
+    parser_directive_switches: u64,
+    selector_vm_bailouts: u64,
+    aux_info_requests: u64,
+    parsing_buffer_high_water_mark: u64,
+    buffered_bytes: u64,
+    decoder_slow_path_bytes: u64,
+    handler_nanos: u64,
+}
+
+#[cfg(feature = "stats")]
+impl From<RewriterStats> for Stats {
+    fn from(stats: RewriterStats) -> Self {
+        Self {
+            tag_scanner_bytes: stats.tag_scanner_bytes,
+            lexer_bytes: stats.lexer_bytes,
+            parser_directive_switches: stats.parser_directive_switches,
+            selector_vm_bailouts: stats.selector_vm_bailouts,
+            aux_info_requests: stats.aux_info_requests,
+            parsing_buffer_high_water_mark: stats.parsing_buffer_high_water_mark,
+            buffered_bytes: stats.buffered_bytes,
+            decoder_slow_path_bytes: stats.decoder_slow_path_bytes,
+            handler_nanos: stats.handler_nanos,
+        }
+    }
+}
+
 #[allow(clippy::large_enum_variant)]
 enum RewriterState {
     Before {
@@ -45,7 +83,12 @@ enum RewriterState {
 }
 
 #[wasm_bindgen]
-pub struct HTMLRewriter(RewriterState);
+pub struct HTMLRewriter {
+    state: RewriterState,
+    // NOTE: keeps the stats of the ended rewriter.
+    #[cfg(feature = "stats")]
+    ended_stats: Option<RewriterStats>,
+}
 
 #[wasm_bindgen]
 impl HTMLRewriter {
@@ -55,27 +98,31 @@ impl HTMLRewriter {
             .and_then(AsciiCompatibleEncoding::new)
             .ok_or_else(|| JsError::new("Invalid encoding"))?;
 
-        Ok(Self(RewriterState::Before {
-            output_sink: JsOutputSink::new(output_sink),
-            settings: Settings {
-                encoding,
-                // TODO: accept options bag and parse out here
-                ..Settings::default()
+        Ok(Self {
+            state: RewriterState::Before {
+                output_sink: JsOutputSink::new(output_sink),
+                settings: Settings {
+                    encoding,
+                    // TODO: accept options bag and parse out here
+                    ..Settings::default()
+                },
             },
-        }))
+            #[cfg(feature = "stats")]
+            ended_stats: None,
+        })
     }
 
     fn inner_mut(&mut self) -> JsResult<&mut NativeHTMLRewriter<'static, JsOutputSink>> {
-        match self.0 {
+        match self.state {
             RewriterState::Before { .. } => {
                 if let RewriterState::Before {
                     settings,
                     output_sink,
-                } = std::mem::replace(&mut self.0, RewriterState::After)
+                } = std::mem::replace(&mut self.state, RewriterState::After)
                 {
                     let rewriter = NativeHTMLRewriter::new(settings, output_sink);
 
-                    self.0 = RewriterState::During(rewriter);
+                    self.state = RewriterState::During(rewriter);
                     self.inner_mut()
                 } else {
                     unsafe {
@@ -89,7 +136,7 @@ impl HTMLRewriter {
     }
 
     pub fn on(&mut self, selector: &str, handlers: ElementContentHandlers) -> JsResult<()> {
-        match self.0 {
+        match self.state {
             RewriterState::Before {
                 ref mut settings, ..
             } => {
@@ -97,7 +144,7 @@ impl HTMLRewriter {
 
                 settings
                     .element_content_handlers
-                    .push((Cow::Owned(selector), handlers.into_native()));
+                    .push((Cow::Owned(selector), handlers.try_into_native()?));
 
                 Ok(())
             }
@@ -107,7 +154,7 @@ impl HTMLRewriter {
 
     #[wasm_bindgen(js_name=onDocument)]
     pub fn on_document(&mut self, handlers: DocumentContentHandlers) -> JsResult<()> {
-        match self.0 {
+        match self.state {
             RewriterState::Before {
                 ref mut settings, ..
             } => {
@@ -125,9 +172,62 @@ impl HTMLRewriter {
     }
 
     pub fn end(&mut self) -> JsResult<()> {
-        match std::mem::replace(&mut self.0, RewriterState::After) {
-            RewriterState::During(inner) => inner.end().map_err(map_err),
+        match std::mem::replace(&mut self.state, RewriterState::After) {
+            RewriterState::During(inner) => self.end_rewriter(inner),
             _ => Ok(()),
         }
     }
+
+    #[cfg(not(feature = "stats"))]
+    fn end_rewriter(&mut self, inner: NativeHTMLRewriter<'static, JsOutputSink>) -> JsResult<()> {
+        inner.end().map_err(map_err)
+    }
+}
+
+#[cfg(feature = "stats")]
+#[wasm_bindgen]
+impl HTMLRewriter {
+    #[wasm_bindgen(js_name=enableStats)]
+    pub fn enable_stats(&mut self) -> JsResult<()> {
+        match self.state {
+            RewriterState::Before {
+                ref mut settings, ..
+            } => {
+                settings.enable_stats = true;
+                Ok(())
+            }
+            _ => Err(JsError::new("Stats cannot be enabled after write").into()),
+        }
+    }
+
+    pub fn stats(&self) -> JsResult<JsValue> {
+        let stats = match self.state {
+            RewriterState::Before { ref settings, .. } => {
+                settings.enable_stats.then(RewriterStats::default)
+            }
+            RewriterState::During(ref inner) => inner.stats(),
+            RewriterState::After => self.ended_stats,
+        };
+
+        let stats = stats.ok_or_else(|| JsError::new("Stats are not enabled"))?;
+
+        to_js_value(&Stats::from(stats)).into_js_result()
+    }
+
+    fn end_rewriter(
+        &mut self,
+        mut inner: NativeHTMLRewriter<'static, JsOutputSink>,
+    ) -> JsResult<()> {
+        match inner.stats() {
+            // NOTE: unlike `end`, `end_and_reset` keeps the rewriter around,
+            // so the stats can include the end of the document.
+            Some(_) => {
+                let res = inner.end_and_reset().map_err(map_err);
+
+                self.ended_stats = inner.stats();
+                res
+            }
+            None => inner.end().map_err(map_err),
+        }
+    }
 }
@@ -39,3 +39,24 @@ if (output != '<div><a href="https://example.com"></a></div>') {
 if (endTags.length != 1 || endTags[0] != 'a') {
   throw "onEndTag fail";
 }
+
+const rulesChunks = [];
+const rulesRewriter = new HTMLRewriter('utf8', (chunk) => {
+  rulesChunks.push(chunk);
+});
+
+rulesRewriter.on('a[href]', {
+  rules: [
+    { type: 'replaceAttributePrefix', name: 'href', prefix: 'http:', replacement: 'https:' },
+    { type: 'setAttribute', name: 'rel', value: 'noopener' },
+    { type: 'insertAfter', content: '<hr>', html: true },
+  ],
+});
+
+rulesRewriter.write(Buffer.from('<a href="http://example.com"></a>'));
+rulesRewriter.end();
+
+const rulesOutput = Buffer.concat(rulesChunks).toString('utf8');
+if (rulesOutput != '<a href="https://example.com" rel="noopener"></a><hr>') {
+  throw "rules fail";
+}
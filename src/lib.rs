@@ -13,9 +13,14 @@
 //! * [`HtmlRewriter`] - a streaming HTML rewriter;
 //! * [`rewrite_str`] - one-off HTML string rewriting function.
 //!
+//! HTML that only needs to be analysed can also be tokenized with the [`Tokenizer`], and
+//! independent documents can be rewritten in parallel with the [`RewritePool`].
+//!
 //! [Cloudflare Workers]: https://www.cloudflare.com/en-gb/products/cloudflare-workers/
 //! [`HtmlRewriter`]: struct.HtmlRewriter.html
 //! [`rewrite_str`]: fn.rewrite_str.html
+//! [`Tokenizer`]: tokenizer/struct.Tokenizer.html
+//! [`RewritePool`]: pool/struct.RewritePool.html
 #![forbid(unsafe_code)]
 #![allow(clippy::default_trait_access)]
 #![allow(clippy::module_name_repetitions)]
@@ -35,17 +40,28 @@ mod rewriter;
 mod memory;
 mod parser;
 mod rewritable_units;
+mod stats;
 mod transform_stream;
 
+pub mod pool;
+pub mod tokenizer;
+
+#[cfg(feature = "futures")]
+pub mod stream;
+
 use cfg_if::cfg_if;
 
+pub use self::memory::{BufferPool, BufferSizeHistogram, MemoryBudget};
 pub use self::rewriter::{
     rewrite_str, AsciiCompatibleEncoding, CommentHandler, DoctypeHandler, DocumentContentHandlers,
     ElementContentHandlers, ElementHandler, EndHandler, EndTagHandler, HandlerResult, HandlerTypes,
-    HtmlRewriter, LocalHandlerTypes, MemorySettings, RewriteStrSettings, Settings, TextHandler,
+    HtmlRewriter, LocalHandlerTypes, MemorySettings, RewriteRule, RewriteStrSettings,
+    RewriterTemplate, SanitizerPolicy, Settings, TextHandler,
 };
 pub use self::selectors_vm::Selector;
-pub use self::transform_stream::OutputSink;
+#[cfg(feature = "stats")]
+pub use self::stats::RewriterStats;
+pub use self::transform_stream::{BufferedOutputSink, OutputSink};
 
 /// These module contains types to work with [`Send`]able [`HtmlRewriter`]s.
 pub mod send {
@@ -218,6 +234,7 @@ cfg_if! {
         };
 
         pub use self::memory::SharedMemoryLimiter;
+        pub use self::stats::SharedStats;
         pub use self::html::{LocalName, LocalNameHash, Tag, Namespace};
     } else {
         mod selectors_vm;
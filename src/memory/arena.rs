@@ -1,58 +1,154 @@
-use super::{MemoryLimitExceededError, SharedMemoryLimiter};
+use super::{BufferPool, MemoryLimitExceededError, SharedMemoryLimiter};
+use std::mem;
 
 /// Preallocated region of memory that can grow and never deallocates during the lifetime of
 /// the limiter.
+///
+/// Bytes shifted out of the front of the arena are not moved immediately: the arena just
+/// advances the offset of its first byte. The remaining bytes are moved to the beginning of
+/// the allocation only once there is not enough room for the appended data at the end of it.
+///
+/// The allocation can be taken from a [`BufferPool`], in which case it's returned to the pool
+/// when the arena is dropped.
 #[derive(Debug)]
 pub(crate) struct Arena {
     limiter: SharedMemoryLimiter,
     data: Vec<u8>,
+    start: usize,
+    // NOTE: the capacity accounted by the limiter. The allocator can give the buffer
+    // a larger capacity, which is only used once it's accounted.
+    capacity: usize,
+    high_water_mark: usize,
+    buffer_pool: Option<BufferPool>,
 }
 
 impl Arena {
-    pub fn new(limiter: SharedMemoryLimiter, preallocated_size: usize) -> Self {
+    pub fn new(
+        limiter: SharedMemoryLimiter,
+        preallocated_size: usize,
+        buffer_pool: Option<BufferPool>,
+    ) -> Self {
         limiter.preallocate(preallocated_size);
 
+        let mut capacity = preallocated_size;
+
+        let data = match buffer_pool {
+            Some(ref pool) => {
+                let mut data = pool.take(preallocated_size, usize::MAX);
+
+                // NOTE: a pooled buffer can be larger than requested. The whole buffer is held
+                // by the arena, so it's accounted, unless the limiter can't afford it, in which
+                // case the buffer stays in the pool.
+                let extra = data.capacity() - preallocated_size;
+
+                if limiter.increase_usage(extra).is_ok() {
+                    capacity += extra;
+                    data
+                } else {
+                    pool.give_back(&mut data);
+                    Vec::with_capacity(preallocated_size)
+                }
+            }
+            None => Vec::with_capacity(preallocated_size),
+        };
+
         Self {
             limiter,
-            data: Vec::with_capacity(preallocated_size),
+            data,
+            start: 0,
+            capacity,
+            high_water_mark: 0,
+            buffer_pool,
         }
     }
 
     pub fn append(&mut self, slice: &[u8]) -> Result<(), MemoryLimitExceededError> {
-        // this specific form of capacity check optimizes out redundant resizing in extend_from_slice
-        if self.data.capacity() - self.data.len() < slice.len() {
-            let additional = slice.len() + self.data.len() - self.data.capacity();
-
-            // NOTE: approximate usage, as `Vec::(try_)reserve_exact` doesn't
-            // give guarantees about exact capacity value :).
-            self.limiter.increase_usage(additional)?;
-
-            // NOTE: with wisely chosen preallocated size this branch should be
-            // executed quite rarely. We can't afford to use double capacity
-            // strategy used by default (see: https://github.com/rust-lang/rust/blob/bdfd698f37184da42254a03ed466ab1f90e6fb6c/src/liballoc/raw_vec.rs#L424)
-            // as we'll run out of the space allowance quite quickly.
-            self.data
-                .try_reserve_exact(slice.len())
-                .map_err(|_| MemoryLimitExceededError)?;
+        if self.capacity - self.data.len() < slice.len() {
+            self.compact();
+        }
+
+        if self.capacity - self.data.len() < slice.len() {
+            self.grow(self.data.len() + slice.len() - self.capacity)?;
         }
 
         self.data.extend_from_slice(slice);
+        self.high_water_mark = self.high_water_mark.max(self.data.len() - self.start);
 
         Ok(())
     }
 
     pub fn init_with(&mut self, slice: &[u8]) -> Result<(), MemoryLimitExceededError> {
         self.data.clear();
+        self.start = 0;
         self.append(slice)
     }
 
     pub fn shift(&mut self, byte_count: usize) {
-        self.data.copy_within(byte_count.., 0);
-        self.data.truncate(self.data.len() - byte_count);
+        debug_assert!(self.start + byte_count <= self.data.len());
+
+        self.start += byte_count;
+
+        if self.start == self.data.len() {
+            self.data.clear();
+            self.start = 0;
+        }
     }
 
     pub fn bytes(&self) -> &[u8] {
-        &self.data
+        &self.data[self.start..]
+    }
+
+    /// Returns the largest number of bytes held by the arena since the last call.
+    pub fn take_high_water_mark(&mut self) -> usize {
+        mem::take(&mut self.high_water_mark)
+    }
+
+    /// Grows the capacity by at least `required` bytes.
+    ///
+    /// The capacity is doubled, so that a buffer growing in small steps isn't reallocated on
+    /// every append, but it doesn't grow by more than the limiter still allows, so that the
+    /// doubling doesn't fail the rewriting while the required bytes would still fit.
+    #[cold]
+    fn grow(&mut self, required: usize) -> Result<(), MemoryLimitExceededError> {
+        let additional = self.capacity.min(self.limiter.available()).max(required);
+
+        self.limiter.increase_usage(additional)?;
+
+        let capacity = self.capacity + additional;
+
+        // NOTE: a buffer taken from the pool can already have the room.
+        if self.data.capacity() < capacity
+            && self
+                .data
+                .try_reserve_exact(capacity - self.data.len())
+                .is_err()
+        {
+            self.limiter.decrease_usage(additional);
+
+            return Err(MemoryLimitExceededError);
+        }
+
+        self.capacity = capacity;
+
+        Ok(())
+    }
+
+    /// Moves the bytes to the beginning of the allocation to reclaim the room
+    /// taken by the shifted out bytes.
+    fn compact(&mut self) {
+        if self.start > 0 {
+            self.data.copy_within(self.start.., 0);
+            self.data.truncate(self.data.len() - self.start);
+            self.start = 0;
+        }
+    }
+}
+
+impl Drop for Arena {
+    fn drop(&mut self) {
+        if let Some(ref pool) = self.buffer_pool {
+            pool.give_back(&mut self.data);
+        }
     }
 }
 
@@ -64,7 +160,7 @@ mod tests {
     #[test]
     fn append() {
         let limiter = SharedMemoryLimiter::new(10);
-        let mut arena = Arena::new(limiter.clone(), 2);
+        let mut arena = Arena::new(limiter.clone(), 2, None);
 
         arena.append(&[1, 2]).unwrap();
         assert_eq!(arena.bytes(), &[1, 2]);
@@ -86,7 +182,7 @@ mod tests {
     #[test]
     fn init_with() {
         let limiter = SharedMemoryLimiter::new(5);
-        let mut arena = Arena::new(limiter.clone(), 0);
+        let mut arena = Arena::new(limiter.clone(), 0, None);
 
         arena.init_with(&[1]).unwrap();
         assert_eq!(arena.bytes(), &[1]);
@@ -112,7 +208,7 @@ mod tests {
     #[test]
     fn shift() {
         let limiter = SharedMemoryLimiter::new(10);
-        let mut arena = Arena::new(limiter.clone(), 0);
+        let mut arena = Arena::new(limiter.clone(), 0, None);
 
         arena.append(&[0, 1, 2, 3]).unwrap();
         arena.shift(2);
@@ -127,9 +223,101 @@ mod tests {
         assert_eq!(arena.bytes(), &[1]);
         assert_eq!(limiter.current_usage(), 4);
 
+        // NOTE: the capacity is doubled rather than grown by the missing byte.
         arena.append(&[2, 3, 4, 5]).unwrap();
         arena.shift(1);
         assert_eq!(arena.bytes(), &[2, 3, 4, 5]);
-        assert_eq!(limiter.current_usage(), 5);
+        assert_eq!(limiter.current_usage(), 8);
+    }
+
+    #[test]
+    fn growth_is_clamped_to_limit() {
+        let limiter = SharedMemoryLimiter::new(10);
+        let mut arena = Arena::new(limiter.clone(), 4, None);
+
+        arena.append(&[0; 5]).unwrap();
+        assert_eq!(limiter.current_usage(), 8);
+
+        // NOTE: doubling would exceed the limit, while the appended bytes still fit.
+        arena.append(&[0; 4]).unwrap();
+        assert_eq!(limiter.current_usage(), 10);
+        assert_eq!(arena.data.capacity(), 10);
+
+        let err = arena.append(&[0; 2]).unwrap_err();
+
+        assert_eq!(err, MemoryLimitExceededError);
+        assert_eq!(limiter.current_usage(), 10);
+    }
+
+    #[test]
+    fn shift_without_moving_bytes() {
+        let limiter = SharedMemoryLimiter::new(10);
+        let mut arena = Arena::new(limiter.clone(), 8, None);
+
+        arena.append(&[0, 1, 2, 3]).unwrap();
+
+        let ptr = arena.bytes()[2..].as_ptr();
+
+        arena.shift(2);
+        assert_eq!(arena.bytes(), &[2, 3]);
+        assert_eq!(arena.bytes().as_ptr(), ptr);
+
+        arena.append(&[4, 5, 6, 7]).unwrap();
+        assert_eq!(arena.bytes(), &[2, 3, 4, 5, 6, 7]);
+        assert_eq!(arena.bytes().as_ptr(), ptr);
+        assert_eq!(limiter.current_usage(), 8);
+
+        // NOTE: there is no room left at the end, so the bytes are moved to the
+        // beginning instead of growing the arena.
+        arena.append(&[8, 9]).unwrap();
+        assert_eq!(arena.bytes(), &[2, 3, 4, 5, 6, 7, 8, 9]);
+        assert_eq!(limiter.current_usage(), 8);
+
+        arena.shift(8);
+        assert!(arena.bytes().is_empty());
+
+        arena.append(&[0; 8]).unwrap();
+        assert_eq!(limiter.current_usage(), 8);
+        assert_eq!(arena.take_high_water_mark(), 8);
+        assert_eq!(arena.take_high_water_mark(), 0);
+    }
+
+    #[test]
+    fn buffer_pool() {
+        let pool = BufferPool::new(1, 64);
+
+        pool.give_back(&mut Vec::with_capacity(8));
+
+        let limiter = SharedMemoryLimiter::new(10);
+        let mut arena = Arena::new(limiter.clone(), 2, Some(pool.clone()));
+
+        // NOTE: the whole capacity of the pooled buffer is accounted.
+        assert_eq!(pool.buffer_count(), 0);
+        assert_eq!(limiter.current_usage(), 8);
+
+        arena.append(&[0; 8]).unwrap();
+        assert_eq!(limiter.current_usage(), 8);
+
+        let err = arena.append(&[0; 4]).unwrap_err();
+
+        assert_eq!(err, MemoryLimitExceededError);
+
+        drop(arena);
+        assert_eq!(pool.buffer_count(), 1);
+    }
+
+    #[test]
+    fn pooled_buffer_over_limit() {
+        let pool = BufferPool::new(1, 64);
+
+        pool.give_back(&mut Vec::with_capacity(32));
+
+        let limiter = SharedMemoryLimiter::new(10);
+        let arena = Arena::new(limiter.clone(), 2, Some(pool.clone()));
+
+        // NOTE: the pooled buffer is too large for the limit, so it stays in the pool.
+        assert_eq!(pool.buffer_count(), 1);
+        assert_eq!(limiter.current_usage(), 2);
+        assert_eq!(arena.data.capacity(), 2);
     }
 }
@@ -0,0 +1,183 @@
+use std::mem;
+use std::sync::{Arc, Mutex, MutexGuard, PoisonError};
+
+#[derive(Debug)]
+struct BufferPoolInner {
+    buffers: Mutex<Vec<Vec<u8>>>,
+    max_buffer_count: usize,
+    max_buffer_size: usize,
+}
+
+/// A pool of buffers reused by the rewriters.
+///
+/// A rewriter takes its parsing buffer and its text decoding buffer from the pool on
+/// instantiation and returns them to the pool when it's dropped, so that constructing lots of
+/// short-lived rewriters doesn't allocate and free the buffers every time.
+///
+/// The parsing buffer taken from the pool is accounted in the rewriter's memory usage with its
+/// whole capacity, which can be larger than [`MemorySettings::preallocated_parsing_buffer_size`].
+/// The text decoding buffer is not accounted, like without the pool, so only the pooled buffers
+/// no larger than [`Settings::text_decoder_buffer_size`] are reused for it. The buffers that
+/// have grown beyond `max_buffer_size` bytes while in use are freed instead of being
+/// returned to the pool, so a single large document doesn't make the pool hold a lot of memory.
+///
+/// The pool can be shared between threads, but the threads then contend for its lock. For the
+/// best results, use a pool per thread.
+///
+/// See [`Settings::buffer_pool`].
+///
+/// # Example
+/// ```
+/// use lol_html::{BufferPool, HtmlRewriter, Settings};
+///
+/// let buffer_pool = BufferPool::new(16, 64 * 1024);
+///
+/// for html in ["<p>1</p>", "<p>2</p>"] {
+///     let mut rewriter = HtmlRewriter::new(
+///         Settings {
+///             buffer_pool: Some(buffer_pool.clone()),
+///             ..Settings::new()
+///         },
+///         |_: &[u8]| {},
+///     );
+///
+///     rewriter.write(html.as_bytes()).unwrap();
+///     rewriter.end().unwrap();
+/// }
+///
+/// assert_eq!(buffer_pool.buffer_count(), 2);
+/// ```
+///
+/// [`Settings::buffer_pool`]: struct.Settings.html#structfield.buffer_pool
+/// [`Settings::text_decoder_buffer_size`]: struct.Settings.html#structfield.text_decoder_buffer_size
+/// [`MemorySettings::preallocated_parsing_buffer_size`]: struct.MemorySettings.html#structfield.preallocated_parsing_buffer_size
+#[derive(Debug, Clone)]
+pub struct BufferPool(Arc<BufferPoolInner>);
+
+impl BufferPool {
+    /// Creates a pool that keeps up to `max_buffer_count` buffers of up to `max_buffer_size`
+    /// bytes each.
+    #[must_use]
+    pub fn new(max_buffer_count: usize, max_buffer_size: usize) -> Self {
+        Self(Arc::new(BufferPoolInner {
+            buffers: Mutex::new(Vec::new()),
+            max_buffer_count,
+            max_buffer_size,
+        }))
+    }
+
+    /// Returns the number of buffers in the pool.
+    #[must_use]
+    pub fn buffer_count(&self) -> usize {
+        self.buffers().len()
+    }
+
+    /// Returns an empty buffer with at least `capacity` bytes of capacity. Only the pooled
+    /// buffers with up to `max_capacity` bytes of capacity are reused, so that the caller
+    /// doesn't hold more memory than it expects.
+    pub(crate) fn take(&self, capacity: usize, max_capacity: usize) -> Vec<u8> {
+        // NOTE: the lock is released before the buffer is grown.
+        let buffer = {
+            let mut buffers = self.buffers();
+
+            buffers
+                .iter()
+                .rposition(|buffer| buffer.capacity() <= max_capacity)
+                .map(|idx| buffers.swap_remove(idx))
+        };
+
+        match buffer {
+            Some(mut buffer) => {
+                buffer.reserve_exact(capacity);
+                buffer
+            }
+            None => Vec::with_capacity(capacity),
+        }
+    }
+
+    /// Returns the `buffer` to the pool, unless it's too large or the pool is full.
+    pub(crate) fn give_back(&self, buffer: &mut Vec<u8>) {
+        if buffer.capacity() == 0 || buffer.capacity() > self.0.max_buffer_size {
+            return;
+        }
+
+        let mut buffer = mem::take(buffer);
+
+        buffer.clear();
+
+        let mut buffers = self.buffers();
+
+        if buffers.len() < self.0.max_buffer_count {
+            buffers.push(buffer);
+        }
+    }
+
+    #[inline]
+    fn buffers(&self) -> MutexGuard<'_, Vec<Vec<u8>>> {
+        // NOTE: the buffers are always in a valid state, even if a thread panicked.
+        self.0
+            .buffers
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn reuse() {
+        let pool = BufferPool::new(2, 16);
+
+        let mut buffer = pool.take(8, usize::MAX);
+        let ptr = buffer.as_ptr();
+
+        buffer.extend_from_slice(b"foo");
+        pool.give_back(&mut buffer);
+        assert_eq!(pool.buffer_count(), 1);
+
+        let buffer = pool.take(4, usize::MAX);
+
+        assert!(buffer.is_empty());
+        assert!(buffer.capacity() >= 8);
+        assert_eq!(buffer.as_ptr(), ptr);
+        assert_eq!(pool.buffer_count(), 0);
+
+        let buffer = pool.take(32, usize::MAX);
+
+        assert!(buffer.capacity() >= 32);
+    }
+
+    #[test]
+    fn max_capacity() {
+        let pool = BufferPool::new(2, 64);
+
+        pool.give_back(&mut Vec::with_capacity(8));
+        pool.give_back(&mut Vec::with_capacity(32));
+
+        let buffer = pool.take(4, 16);
+
+        assert_eq!(buffer.capacity(), 8);
+        assert_eq!(pool.buffer_count(), 1);
+
+        let buffer = pool.take(4, 16);
+
+        assert_eq!(buffer.capacity(), 4);
+        assert_eq!(pool.buffer_count(), 1);
+    }
+
+    #[test]
+    fn limits() {
+        let pool = BufferPool::new(2, 16);
+
+        pool.give_back(&mut Vec::with_capacity(32));
+        assert_eq!(pool.buffer_count(), 0);
+
+        for _ in 0..3 {
+            pool.give_back(&mut Vec::with_capacity(8));
+        }
+
+        assert_eq!(pool.buffer_count(), 2);
+    }
+}
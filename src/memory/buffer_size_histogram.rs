@@ -0,0 +1,179 @@
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+
+// NOTE: a bucket for the empty buffers and a bucket per power of two.
+const BUCKET_COUNT: usize = usize::BITS as usize + 2;
+
+#[inline]
+const fn bucket_idx(size: usize) -> usize {
+    if size == 0 {
+        0
+    } else {
+        (usize::BITS - (size - 1).leading_zeros()) as usize + 1
+    }
+}
+
+#[inline]
+fn bucket_upper_bound(idx: usize) -> usize {
+    match idx {
+        0 => 0,
+        _ => 1usize.checked_shl(idx as u32 - 1).unwrap_or(usize::MAX),
+    }
+}
+
+#[derive(Debug)]
+struct BufferSizeHistogramInner {
+    buckets: [AtomicU64; BUCKET_COUNT],
+    percentile: u8,
+}
+
+/// A histogram of the parsing buffer sizes needed by the rewriters, used to size the parsing
+/// buffers of new rewriters.
+///
+/// Every rewriter that shares the histogram records the high-water mark of its parsing buffer
+/// at the end of each document. New rewriters preallocate the parsing buffer of the size that
+/// covers the configured percentile of the recorded high-water marks, instead of
+/// [`MemorySettings::preallocated_parsing_buffer_size`], which is only used until the first
+/// high-water mark is recorded.
+///
+/// The sizes are recorded in buckets of powers of two, so the preallocated size can be up to
+/// twice as large as the recorded high-water mark.
+///
+/// See [`Settings::parsing_buffer_histogram`].
+///
+/// # Example
+/// ```
+/// use lol_html::{element, BufferSizeHistogram, HtmlRewriter, Settings};
+///
+/// let histogram = BufferSizeHistogram::new(90);
+///
+/// let mut rewriter = HtmlRewriter::new(
+///     Settings {
+///         element_content_handlers: vec![element!("img", |_| Ok(()))],
+///         parsing_buffer_histogram: Some(histogram.clone()),
+///         ..Settings::new()
+///     },
+///     |_: &[u8]| {},
+/// );
+///
+/// // NOTE: the tag is split between the chunks, so it's buffered.
+/// rewriter.write(b"<img alt='").unwrap();
+/// rewriter.write(b"Hello, world!'>").unwrap();
+/// rewriter.end().unwrap();
+///
+/// assert_eq!(histogram.percentile_size(), Some(32));
+/// ```
+///
+/// [`MemorySettings::preallocated_parsing_buffer_size`]: struct.MemorySettings.html#structfield.preallocated_parsing_buffer_size
+/// [`Settings::parsing_buffer_histogram`]: struct.Settings.html#structfield.parsing_buffer_histogram
+#[derive(Debug, Clone)]
+pub struct BufferSizeHistogram(Arc<BufferSizeHistogramInner>);
+
+impl BufferSizeHistogram {
+    /// Creates an empty histogram that sizes the buffers to cover the `percentile` of
+    /// the recorded sizes.
+    ///
+    /// # Panics
+    ///  * If the `percentile` is larger than 100.
+    #[must_use]
+    pub fn new(percentile: u8) -> Self {
+        assert!(percentile <= 100, "Percentile should be at most 100.");
+
+        Self(Arc::new(BufferSizeHistogramInner {
+            buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+            percentile,
+        }))
+    }
+
+    /// Returns the buckets of the histogram as pairs of the largest size that falls into
+    /// the bucket and the number of sizes recorded in the bucket.
+    ///
+    /// The bucket for a power of two `N` contains the sizes from `N / 2 + 1` to `N` bytes.
+    /// The empty buckets are included, so the buckets of different histograms can be
+    /// compared or merged.
+    #[must_use]
+    pub fn buckets(&self) -> Vec<(usize, u64)> {
+        self.0
+            .buckets
+            .iter()
+            .enumerate()
+            .map(|(idx, count)| (bucket_upper_bound(idx), count.load(Ordering::Relaxed)))
+            .collect()
+    }
+
+    /// Returns the size that covers the configured percentile of the recorded sizes, or
+    /// `None` if no sizes have been recorded yet.
+    #[must_use]
+    pub fn percentile_size(&self) -> Option<usize> {
+        let counts = self
+            .0
+            .buckets
+            .iter()
+            .map(|count| count.load(Ordering::Relaxed))
+            .collect::<Vec<_>>();
+
+        let total = counts.iter().sum::<u64>();
+
+        if total == 0 {
+            return None;
+        }
+
+        let target = (total * u64::from(self.0.percentile)).div_ceil(100).max(1);
+        let mut covered = 0;
+
+        counts
+            .iter()
+            .position(|&count| {
+                covered += count;
+                covered >= target
+            })
+            .map(bucket_upper_bound)
+    }
+
+    #[inline]
+    pub(crate) fn record(&self, size: usize) {
+        self.0.buckets[bucket_idx(size)].fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn buckets() {
+        let histogram = BufferSizeHistogram::new(50);
+
+        for size in [0, 1, 2, 3, 4, 5, 1000, usize::MAX] {
+            histogram.record(size);
+        }
+
+        let buckets = histogram.buckets();
+
+        assert_eq!(buckets.len(), BUCKET_COUNT);
+        assert_eq!(&buckets[..5], &[(0, 1), (1, 1), (2, 1), (4, 2), (8, 1)]);
+        assert_eq!(buckets[11], (1024, 1));
+        assert_eq!(buckets[BUCKET_COUNT - 1], (usize::MAX, 1));
+        assert_eq!(buckets.iter().map(|&(_, count)| count).sum::<u64>(), 8);
+    }
+
+    #[test]
+    fn percentile_size() {
+        assert_eq!(BufferSizeHistogram::new(90).percentile_size(), None);
+
+        for (percentile, expected) in [(0, 0), (50, 16), (90, 1024), (100, 4096)] {
+            let histogram = BufferSizeHistogram::new(percentile);
+
+            histogram.record(0);
+
+            for _ in 0..8 {
+                histogram.record(10);
+            }
+
+            histogram.record(1000);
+            histogram.record(3000);
+
+            assert_eq!(histogram.percentile_size(), Some(expected), "{percentile}");
+        }
+    }
+}
@@ -26,6 +26,16 @@ impl<T> LimitedVec<T> {
         Ok(())
     }
 
+    /// Clones and appends all of the elements of the slice to the vector.
+    pub fn extend_from_slice(&mut self, other: &[T]) -> Result<(), MemoryLimitExceededError>
+    where
+        T: Clone,
+    {
+        self.limiter.increase_usage(size_of::<T>() * other.len())?;
+        self.vec.extend_from_slice(other);
+        Ok(())
+    }
+
     /// Returns the number of elements in the vector, also referred to as its 'length'.
     #[inline]
     pub fn len(&self) -> usize {
@@ -10,50 +10,292 @@ use thiserror::Error;
 #[error("The memory limit has been exceeded.")]
 pub struct MemoryLimitExceededError;
 
+// NOTE: large enough for the budget to be touched rarely, and small enough to not strand
+// a significant amount of the budget in the rewriters.
+const DEFAULT_CREDIT_BLOCK_SIZE: usize = 64 * 1024;
+
+#[derive(Debug)]
+struct BudgetInner {
+    usage: AtomicUsize,
+    max: usize,
+    credit_block_size: usize,
+}
+
+/// A memory budget shared by several [`HtmlRewriter`]s, e.g. by the rewriters of one tenant.
+///
+/// A rewriter takes the memory from the budget in blocks of credit and accounts its
+/// allocations against the credit locally, so the budget, which is shared between threads,
+/// is only updated when the rewriter runs out of credit. The credit is returned to the budget
+/// when it is no longer needed or the rewriter is dropped.
+///
+/// As a consequence, the usage of the budget can exceed the memory actually used by the
+/// rewriters by up to two blocks of credit per rewriter. When the budget doesn't have a whole
+/// block left, the rewriter takes only the memory it needs.
+///
+/// The memory preallocated on the rewriter instantiation is taken from the budget even if that
+/// exceeds the budget, unless the rewriter is constructed with [`HtmlRewriter::try_new`], which
+/// fails instead. The callers can use [`MemoryBudget::available`] to check the memory pressure
+/// before they start new work.
+///
+/// See [`Settings::memory_budget`].
+///
+/// [`HtmlRewriter`]: struct.HtmlRewriter.html
+/// [`HtmlRewriter::try_new`]: struct.HtmlRewriter.html#method.try_new
+/// [`Settings::memory_budget`]: struct.Settings.html#structfield.memory_budget
+#[derive(Debug, Clone)]
+pub struct MemoryBudget(Arc<BudgetInner>);
+
+impl MemoryBudget {
+    /// Creates a budget of `max` bytes.
+    #[inline]
+    #[must_use]
+    pub fn new(max: usize) -> Self {
+        Self::with_credit_block_size(max, DEFAULT_CREDIT_BLOCK_SIZE)
+    }
+
+    /// Creates a budget of `max` bytes from which the rewriters take the credit in blocks of
+    /// `credit_block_size` bytes.
+    ///
+    /// Larger blocks make the rewriters update the budget less often, smaller blocks make
+    /// the usage of the budget more precise. With `0` the budget is updated on every
+    /// allocation.
+    #[must_use]
+    pub fn with_credit_block_size(max: usize, credit_block_size: usize) -> Self {
+        Self(Arc::new(BudgetInner {
+            usage: AtomicUsize::new(0),
+            max,
+            credit_block_size,
+        }))
+    }
+
+    /// Returns the size of the budget in bytes.
+    #[inline]
+    #[must_use]
+    pub fn max(&self) -> usize {
+        self.0.max
+    }
+
+    /// Returns the number of bytes taken from the budget by the rewriters.
+    #[inline]
+    #[must_use]
+    pub fn usage(&self) -> usize {
+        self.0.usage.load(Ordering::Relaxed)
+    }
+
+    /// Returns the number of bytes left in the budget.
+    #[inline]
+    #[must_use]
+    pub fn available(&self) -> usize {
+        self.0.max.saturating_sub(self.usage())
+    }
+
+    #[inline]
+    fn reserve(&self, byte_count: usize) -> bool {
+        let previous_usage = self.0.usage.fetch_add(byte_count, Ordering::Relaxed);
+
+        if previous_usage + byte_count > self.0.max {
+            self.release(byte_count);
+
+            false
+        } else {
+            true
+        }
+    }
+
+    #[inline]
+    fn force_reserve(&self, byte_count: usize) {
+        self.0.usage.fetch_add(byte_count, Ordering::Relaxed);
+    }
+
+    #[inline]
+    fn release(&self, byte_count: usize) {
+        self.0.usage.fetch_sub(byte_count, Ordering::Relaxed);
+    }
+}
+
+#[derive(Debug)]
+struct LimiterInner {
+    current_usage: AtomicUsize,
+    max: usize,
+    budget: Option<MemoryBudget>,
+    // NOTE: the memory taken from the budget. It's never less than the current usage.
+    credit: AtomicUsize,
+}
+
+impl Drop for LimiterInner {
+    fn drop(&mut self) {
+        if let Some(ref budget) = self.budget {
+            budget.release(*self.credit.get_mut());
+        }
+    }
+}
+
 // Pub only for integration tests
 #[derive(Debug, Clone)]
 pub struct SharedMemoryLimiter {
-    current_usage: Arc<AtomicUsize>,
-    max: usize,
+    inner: Arc<LimiterInner>,
 }
 
 impl SharedMemoryLimiter {
     #[must_use]
     pub fn new(max: usize) -> Self {
+        Self::with_budget(max, None)
+    }
+
+    #[must_use]
+    pub fn with_budget(max: usize, budget: Option<MemoryBudget>) -> Self {
         Self {
-            current_usage: Arc::new(AtomicUsize::new(0)),
-            max,
+            inner: Arc::new(LimiterInner {
+                current_usage: AtomicUsize::new(0),
+                max,
+                budget,
+                credit: AtomicUsize::new(0),
+            }),
         }
     }
 
     #[cfg(test)]
     #[must_use]
     pub fn current_usage(&self) -> usize {
-        self.current_usage.load(Ordering::Relaxed)
+        self.inner.current_usage.load(Ordering::Relaxed)
     }
 
     #[inline]
     pub fn increase_usage(&self, byte_count: usize) -> Result<(), MemoryLimitExceededError> {
-        let previous_usage = self.current_usage.fetch_add(byte_count, Ordering::Relaxed);
-        let current_usage = previous_usage + byte_count;
+        let current_usage = self.increase_local_usage(byte_count)?;
 
-        if current_usage > self.max {
-            Err(MemoryLimitExceededError)
-        } else {
+        if self.has_credit_for(current_usage) {
             Ok(())
+        } else {
+            self.inner
+                .current_usage
+                .fetch_sub(byte_count, Ordering::Relaxed);
+
+            Err(MemoryLimitExceededError)
         }
     }
 
     #[inline]
     pub fn preallocate(&self, byte_count: usize) {
-        self.increase_usage(byte_count).expect(
+        let current_usage = self.increase_local_usage(byte_count).expect(
             "Total preallocated memory size should be less than `MemorySettings::max_allowed_memory_usage`.",
         );
+
+        if let Some(ref budget) = self.inner.budget {
+            let credit = self.inner.credit.load(Ordering::Relaxed);
+
+            if current_usage > credit {
+                budget.force_reserve(current_usage - credit);
+                self.inner.credit.store(current_usage, Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Returns the number of bytes that can still be used, either under the limit or,
+    /// if the limiter has a budget, under the limit and in the budget.
+    #[inline]
+    pub fn available(&self) -> usize {
+        let usage = self.inner.current_usage.load(Ordering::Relaxed);
+        let available = self.inner.max.saturating_sub(usage);
+
+        match self.inner.budget {
+            Some(ref budget) => {
+                let credit = self.inner.credit.load(Ordering::Relaxed);
+
+                available.min(
+                    credit
+                        .saturating_sub(usage)
+                        .saturating_add(budget.available()),
+                )
+            }
+            None => available,
+        }
+    }
+
+    /// Makes sure that `byte_count` more bytes can be used without taking credit from
+    /// the budget, so that the following preallocation can't exceed the budget.
+    pub fn reserve_credit(&self, byte_count: usize) -> Result<(), MemoryLimitExceededError> {
+        let usage = self.inner.current_usage.load(Ordering::Relaxed) + byte_count;
+
+        if usage <= self.inner.max && self.has_credit_for(usage) {
+            Ok(())
+        } else {
+            Err(MemoryLimitExceededError)
+        }
     }
 
     #[inline]
     pub fn decrease_usage(&self, byte_count: usize) {
-        self.current_usage.fetch_sub(byte_count, Ordering::Relaxed);
+        let previous_usage = self
+            .inner
+            .current_usage
+            .fetch_sub(byte_count, Ordering::Relaxed);
+
+        if let Some(ref budget) = self.inner.budget {
+            let current_usage = previous_usage - byte_count;
+            let credit = self.inner.credit.load(Ordering::Relaxed);
+            let block_size = budget.0.credit_block_size;
+
+            // NOTE: keep a block of credit for the following allocations, so that
+            // the usage going up and down doesn't update the budget every time.
+            if credit - current_usage > block_size.saturating_mul(2) {
+                let kept_credit = current_usage + block_size;
+
+                budget.release(credit - kept_credit);
+                self.inner.credit.store(kept_credit, Ordering::Relaxed);
+            }
+        }
+    }
+
+    #[inline]
+    fn increase_local_usage(&self, byte_count: usize) -> Result<usize, MemoryLimitExceededError> {
+        let previous_usage = self
+            .inner
+            .current_usage
+            .fetch_add(byte_count, Ordering::Relaxed);
+        let current_usage = previous_usage + byte_count;
+
+        if current_usage > self.inner.max {
+            // NOTE: the memory hasn't been allocated, so it shouldn't be accounted.
+            // This keeps the usage correct if the rewriter is reset after the error.
+            self.inner
+                .current_usage
+                .fetch_sub(byte_count, Ordering::Relaxed);
+
+            Err(MemoryLimitExceededError)
+        } else {
+            Ok(current_usage)
+        }
+    }
+
+    #[inline]
+    fn has_credit_for(&self, usage: usize) -> bool {
+        match self.inner.budget {
+            Some(ref budget) => {
+                let credit = self.inner.credit.load(Ordering::Relaxed);
+
+                usage <= credit || self.take_credit(budget, usage - credit)
+            }
+            None => true,
+        }
+    }
+
+    #[cold]
+    #[inline(never)]
+    fn take_credit(&self, budget: &MemoryBudget, shortfall: usize) -> bool {
+        let block = shortfall.next_multiple_of(budget.0.credit_block_size.max(1));
+
+        let taken = if budget.reserve(block) {
+            block
+        } else if block != shortfall && budget.reserve(shortfall) {
+            shortfall
+        } else {
+            return false;
+        };
+
+        self.inner.credit.fetch_add(taken, Ordering::Relaxed);
+
+        true
     }
 }
 
@@ -77,10 +319,32 @@ mod tests {
         assert_eq!(limiter.current_usage(), 4);
 
         let err = limiter.increase_usage(15).unwrap_err();
+        assert_eq!(limiter.current_usage(), 4);
 
         assert_eq!(err, MemoryLimitExceededError);
     }
 
+    #[test]
+    fn available() {
+        let limiter = SharedMemoryLimiter::new(10);
+
+        limiter.increase_usage(3).unwrap();
+        assert_eq!(limiter.available(), 7);
+
+        let budget = MemoryBudget::with_credit_block_size(10, 4);
+        let limiter = SharedMemoryLimiter::with_budget(20, Some(budget.clone()));
+
+        limiter.increase_usage(3).unwrap();
+        assert_eq!(budget.usage(), 4);
+        assert_eq!(limiter.available(), 7);
+
+        drop(limiter);
+
+        let limiter = SharedMemoryLimiter::with_budget(5, Some(budget));
+
+        assert_eq!(limiter.available(), 5);
+    }
+
     #[test]
     #[should_panic(
         expected = "Total preallocated memory size should be less than `MemorySettings::max_allowed_memory_usage`."
@@ -93,4 +357,103 @@ mod tests {
 
         limiter.preallocate(10);
     }
+
+    #[test]
+    fn budget_credit() {
+        let budget = MemoryBudget::with_credit_block_size(100, 10);
+        let limiter = SharedMemoryLimiter::with_budget(50, Some(budget.clone()));
+
+        limiter.increase_usage(3).unwrap();
+        assert_eq!(budget.usage(), 10);
+
+        limiter.increase_usage(5).unwrap();
+        assert_eq!(budget.usage(), 10);
+
+        limiter.increase_usage(5).unwrap();
+        assert_eq!(budget.usage(), 20);
+
+        limiter.decrease_usage(12);
+        assert_eq!(budget.usage(), 20);
+
+        limiter.increase_usage(30).unwrap();
+        assert_eq!(budget.usage(), 40);
+
+        limiter.decrease_usage(30);
+        assert_eq!(limiter.current_usage(), 1);
+        assert_eq!(budget.usage(), 11);
+
+        let err = limiter.increase_usage(50).unwrap_err();
+        assert_eq!(err, MemoryLimitExceededError);
+        assert_eq!(budget.usage(), 11);
+
+        drop(limiter);
+        assert_eq!(budget.usage(), 0);
+    }
+
+    #[test]
+    fn shared_budget() {
+        let budget = MemoryBudget::with_credit_block_size(25, 10);
+        let limiter1 = SharedMemoryLimiter::with_budget(usize::MAX, Some(budget.clone()));
+        let limiter2 = SharedMemoryLimiter::with_budget(usize::MAX, Some(budget.clone()));
+
+        limiter1.increase_usage(15).unwrap();
+        assert_eq!(budget.usage(), 20);
+
+        // NOTE: the budget doesn't have a whole block left.
+        limiter2.increase_usage(3).unwrap();
+        assert_eq!(budget.usage(), 23);
+
+        limiter2.increase_usage(2).unwrap();
+        assert_eq!(budget.usage(), 25);
+
+        let err = limiter2.increase_usage(1).unwrap_err();
+        assert_eq!(err, MemoryLimitExceededError);
+        assert_eq!(limiter2.current_usage(), 5);
+
+        limiter1.increase_usage(5).unwrap();
+        assert_eq!(budget.usage(), 25);
+
+        drop(limiter1);
+        assert_eq!(budget.usage(), 5);
+
+        limiter2.increase_usage(1).unwrap();
+        assert_eq!(budget.usage(), 15);
+    }
+
+    #[test]
+    fn preallocate_from_budget() {
+        let budget = MemoryBudget::with_credit_block_size(10, 4);
+        let limiter = SharedMemoryLimiter::with_budget(100, Some(budget.clone()));
+
+        limiter.preallocate(15);
+        assert_eq!(budget.usage(), 15);
+
+        let err = limiter.increase_usage(1).unwrap_err();
+        assert_eq!(err, MemoryLimitExceededError);
+
+        limiter.decrease_usage(15);
+        assert_eq!(budget.usage(), 4);
+    }
+
+    #[test]
+    fn reserve_credit() {
+        let budget = MemoryBudget::with_credit_block_size(10, 4);
+        let limiter = SharedMemoryLimiter::with_budget(8, Some(budget.clone()));
+
+        limiter.reserve_credit(6).unwrap();
+        assert_eq!(budget.usage(), 8);
+        assert_eq!(budget.available(), 2);
+
+        limiter.preallocate(6);
+        assert_eq!(budget.usage(), 8);
+
+        let err = limiter.reserve_credit(3).unwrap_err();
+        assert_eq!(err, MemoryLimitExceededError);
+
+        let other_limiter = SharedMemoryLimiter::with_budget(8, Some(budget.clone()));
+
+        let err = other_limiter.reserve_credit(3).unwrap_err();
+        assert_eq!(err, MemoryLimitExceededError);
+        assert_eq!(budget.usage(), 8);
+    }
 }
@@ -1,7 +1,11 @@
 mod arena;
+mod buffer_pool;
+mod buffer_size_histogram;
 mod limited_vec;
 mod limiter;
 
 pub(crate) use arena::Arena;
+pub use buffer_pool::BufferPool;
+pub use buffer_size_histogram::BufferSizeHistogram;
 pub(crate) use limited_vec::LimitedVec;
-pub use limiter::{MemoryLimitExceededError, SharedMemoryLimiter};
+pub use limiter::{MemoryBudget, MemoryLimitExceededError, SharedMemoryLimiter};
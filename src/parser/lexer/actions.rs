@@ -74,14 +74,16 @@ impl<S: LexemeSink> StateMachineActions for Lexer<S> {
             self.handle_tree_builder_feedback(context, feedback, &lexeme);
         }
 
-        if let StartTag {
-            ref mut ns,
-            name_hash,
-            ..
-        } = lexeme.token_outline
-        {
-            self.last_start_tag_name_hash = name_hash;
-            *ns = context.tree_builder_simulator.current_ns();
+        match lexeme.token_outline {
+            StartTag {
+                ref mut ns,
+                name_hash,
+                ..
+            } => {
+                self.last_start_tag_name_hash = name_hash;
+                *ns = context.tree_builder_simulator.current_ns();
+            }
+            EndTag { ref mut ns, .. } => *ns = context.tree_builder_simulator.current_ns(),
         }
 
         match self
@@ -150,6 +152,7 @@ impl<S: LexemeSink> StateMachineActions for Lexer<S> {
         self.current_tag_token = Some(EndTag {
             name: Range::default(),
             name_hash: LocalNameHash::new(),
+            ns: Namespace::default(),
         });
     }
 
@@ -320,5 +323,12 @@ impl<S: LexemeSink> StateMachineActions for Lexer<S> {
         }
     }
 
+    // NOTE: text lexemes end at each `<`, so the lexer can't jump over them without changing
+    // the text chunks that handlers receive.
+    #[inline]
+    fn skip_raw_text(&mut self, context: &mut ParserContext<S>, input: &[u8], _next_chs: &[u8]) {
+        self.skip_until(context, input, b'<');
+    }
+
     noop_action!(mark_tag_start, unmark_tag_start);
 }
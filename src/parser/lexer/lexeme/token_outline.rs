@@ -31,6 +31,7 @@ pub(crate) enum TagTokenOutline {
     EndTag {
         name: Range,
         name_hash: LocalNameHash,
+        ns: Namespace,
     },
 }
 
@@ -13,9 +13,11 @@ pub(crate) use self::lexer::{
 use self::state_machine::{ActionError, ParsingTermination, StateMachine};
 pub(crate) use self::tag_scanner::TagHintSink;
 use self::tag_scanner::TagScanner;
+pub(crate) use self::tree_builder_simulator::causes_foreign_content_exit;
 pub use self::tree_builder_simulator::ParsingAmbiguityError;
 use self::tree_builder_simulator::{TreeBuilderFeedback, TreeBuilderSimulator};
 use crate::rewriter::RewritingError;
+use crate::stats::SharedStats;
 use cfg_if::cfg_if;
 
 // NOTE: tag scanner can implicitly force parser to switch to
@@ -41,6 +43,7 @@ pub struct Parser<S> {
     tag_scanner: TagScanner<S>,
     current_directive: ParserDirective,
     context: ParserContext<S>,
+    stats: SharedStats,
 }
 
 // public only for integration tests
@@ -48,7 +51,12 @@ pub struct Parser<S> {
 impl<S: ParserOutputSink> Parser<S> {
     #[inline]
     #[must_use]
-    pub fn new(output_sink: S, initial_directive: ParserDirective, strict: bool) -> Self {
+    pub fn new(
+        output_sink: S,
+        initial_directive: ParserDirective,
+        strict: bool,
+        stats: SharedStats,
+    ) -> Self {
         let context = ParserContext {
             output_sink,
             tree_builder_simulator: TreeBuilderSimulator::new(strict),
@@ -59,6 +67,7 @@ impl<S: ParserOutputSink> Parser<S> {
             tag_scanner: TagScanner::new(),
             current_directive: initial_directive,
             context,
+            stats,
         }
     }
 
@@ -69,6 +78,9 @@ impl<S: ParserOutputSink> Parser<S> {
     pub fn parse(&mut self, input: &[u8], last: bool) -> Result<usize, RewritingError> {
         use ActionError::*;
 
+        // NOTE: start of the input consumed in the current parser mode.
+        let mut directive_start = 0;
+
         let mut parse_result = match self.current_directive {
             ParserDirective::WherePossibleScanForTagsOnly => {
                 self.tag_scanner
@@ -82,12 +94,24 @@ impl<S: ParserOutputSink> Parser<S> {
                 Err(ParsingTermination::EndOfInput {
                     consumed_byte_count,
                 }) => {
+                    self.stats.add_parsed_bytes(
+                        self.current_directive,
+                        consumed_byte_count.saturating_sub(directive_start),
+                    );
+
                     return Ok(consumed_byte_count);
                 }
                 Err(ParsingTermination::ActionError(ParserDirectiveChangeRequired(
                     new_directive,
                     sm_bookmark,
                 ))) => {
+                    self.stats.add_parsed_bytes(
+                        self.current_directive,
+                        sm_bookmark.pos.saturating_sub(directive_start),
+                    );
+                    self.stats.add_parser_directive_switch();
+
+                    directive_start = sm_bookmark.pos;
                     self.current_directive = new_directive;
 
                     trace!(@continue_from_bookmark sm_bookmark, self.current_directive, input);
@@ -110,6 +134,15 @@ impl<S: ParserOutputSink> Parser<S> {
         }
     }
 
+    /// Returns the parser to the state it had after construction, so it can be reused for
+    /// another document. The output sink is kept as is.
+    pub fn reset(&mut self, initial_directive: ParserDirective) {
+        self.lexer = Lexer::new();
+        self.tag_scanner = TagScanner::new();
+        self.current_directive = initial_directive;
+        self.context.tree_builder_simulator.reset();
+    }
+
     pub fn get_dispatcher(&mut self) -> &mut S {
         &mut self.context.output_sink
     }
@@ -7,6 +7,7 @@ mod syntax;
 use crate::html::{LocalNameHash, TextType};
 use crate::parser::{ParserDirective, ParsingAmbiguityError, TreeBuilderFeedback};
 use crate::rewriter::RewritingError;
+use memchr::memchr;
 use std::fmt::{self, Debug};
 use std::mem;
 
@@ -43,7 +44,7 @@ pub(crate) struct StateMachineBookmark {
     cdata_allowed: bool,
     text_type: TextType,
     last_start_tag_name_hash: LocalNameHash,
-    // NOTE: pub because it's used by trace!.
+    // NOTE: pub because it's used by trace! and the parser stats.
     pub pos: usize,
     feedback_directive: FeedbackDirective,
 }
@@ -129,6 +130,8 @@ pub(crate) trait StateMachineActions {
 
     fn enter_cdata(&mut self, context: &mut Self::Context, input: &[u8]);
     fn leave_cdata(&mut self, context: &mut Self::Context, input: &[u8]);
+
+    fn skip_raw_text(&mut self, context: &mut Self::Context, input: &[u8], next_chs: &[u8]);
 }
 
 pub(crate) trait StateMachineConditions {
@@ -228,6 +231,60 @@ pub(crate) trait StateMachine: StateMachineActions + StateMachineConditions {
         })
     }
 
+    // NOTE: text states spend most of their time consuming characters that don't have any
+    // special meaning for them. Instead of dispatching on each such character we jump
+    // straight to the next occurrence of the `needle`, so it (or the end of the input) is
+    // the next character consumed by the state. `memchr` is vectorized where supported.
+    #[inline]
+    fn skip_until(&mut self, _context: &mut Self::Context, input: &[u8], needle: u8) {
+        let next_pos = self.pos() + 1;
+        let rest = input.get(next_pos..).unwrap_or_default();
+
+        trace!(@chars "skip until");
+
+        self.set_pos(next_pos + memchr(needle, rest).unwrap_or(rest.len()));
+    }
+
+    // NOTE: in the raw text states only `<` followed by one of the `next_chs` can start
+    // markup, any other `<` is a part of the text. If the text doesn't need to be emitted,
+    // we jump straight to the next `<` that can start markup, or to the `<` at the end of the
+    // input, since its next character is not known yet. That saves a round trip through
+    // the state machine for each `<` in inline scripts, which are full of them.
+    #[inline]
+    fn skip_until_markup_start(&mut self, input: &[u8], next_chs: &[u8]) {
+        let mut pos = self.pos() + 1;
+
+        trace!(@chars "skip until markup start");
+
+        loop {
+            let rest = input.get(pos..).unwrap_or_default();
+
+            match memchr(b'<', rest) {
+                Some(offset) => {
+                    pos += offset;
+
+                    match input.get(pos + 1) {
+                        Some(ch) if !next_chs.contains(ch) => pos += 1,
+                        _ => break,
+                    }
+                }
+                None => {
+                    pos = input.len();
+                    break;
+                }
+            }
+        }
+
+        self.set_pos(pos);
+    }
+
+    #[inline]
+    fn skip_to_end(&mut self, _context: &mut Self::Context, input: &[u8]) {
+        trace!(@chars "skip to end");
+
+        self.set_pos(input.len());
+    }
+
     #[inline]
     fn create_bookmark(
         &self,
@@ -4,7 +4,7 @@ define_state_group!(rcdata_states_group = {
         b'<' => ( emit_text?; mark_tag_start; --> rcdata_less_than_sign_state )
         eoc  => ( emit_text?; )
         eof  => ( emit_text?; emit_eof?; )
-        _    => ()
+        _    => ( skip_raw_text b"/"; )
     }
 
     rcdata_less_than_sign_state {
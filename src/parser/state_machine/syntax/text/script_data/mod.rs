@@ -10,7 +10,7 @@ define_state_group!(script_data_states_group = {
         b'<' => ( emit_text?; mark_tag_start; --> script_data_less_than_sign_state )
         eoc  => ( emit_text?; )
         eof  => ( emit_text?; emit_eof?; )
-        _    => ()
+        _    => ( skip_raw_text b"/!"; )
     }
 
     script_data_less_than_sign_state {
@@ -112,6 +112,13 @@ impl<S: TagHintSink> StateMachineActions for TagScanner<S> {
         finish_attr
     );
 
+    // NOTE: the tag scanner doesn't emit text, so it doesn't need to stop at
+    // the `<` characters that can't start markup.
+    #[inline]
+    fn skip_raw_text(&mut self, _context: &mut ParserContext<S>, input: &[u8], next_chs: &[u8]) {
+        self.skip_until_markup_start(input, next_chs);
+    }
+
     #[inline]
     fn shift_comment_text_end_by(
         &mut self,
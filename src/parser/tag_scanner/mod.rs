@@ -18,6 +18,7 @@ pub(crate) trait TagHintSink {
     fn handle_end_tag_hint(
         &mut self,
         name: LocalName<'_>,
+        ns: Namespace,
     ) -> Result<ParserDirective, RewritingError>;
 }
 
@@ -88,13 +89,13 @@ impl<S: TagHintSink> TagScanner<S> {
 
         trace!(@output name);
 
+        let ns = context.tree_builder_simulator.current_ns();
+
         if is_in_end_tag {
-            context.output_sink.handle_end_tag_hint(name)
+            context.output_sink.handle_end_tag_hint(name, ns)
         } else {
             self.last_start_tag_name_hash = self.tag_name_hash;
 
-            let ns = context.tree_builder_simulator.current_ns();
-
             context.output_sink.handle_start_tag_hint(name, ns)
         }
     }
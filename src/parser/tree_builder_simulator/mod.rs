@@ -92,7 +92,7 @@ fn get_text_type_adjustment(tag_name: LocalNameHash) -> TreeBuilderFeedback {
 }
 
 #[inline]
-fn causes_foreign_content_exit(tag_name: LocalNameHash) -> bool {
+pub(crate) fn causes_foreign_content_exit(tag_name: LocalNameHash) -> bool {
     tag_is_one_of!(
         tag_name,
         [
@@ -137,6 +137,14 @@ impl TreeBuilderSimulator {
         simulator
     }
 
+    /// Returns the simulator to its initial state, keeping the capacity of the namespace stack.
+    pub fn reset(&mut self) {
+        self.ns_stack.clear();
+        self.ns_stack.push(Namespace::Html);
+        self.current_ns = Namespace::Html;
+        self.ambiguity_guard = AmbiguityGuard::default();
+    }
+
     pub fn get_feedback_for_start_tag(
         &mut self,
         tag_name: LocalNameHash,
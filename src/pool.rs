@@ -0,0 +1,529 @@
+//! A pool of threads that rewrite independent documents in parallel.
+
+use crate::errors::RewritingError;
+use crate::{HtmlRewriter, OutputSink, RewriterTemplate, Settings};
+use std::any::Any;
+use std::cell::RefCell;
+use std::collections::{BTreeMap, VecDeque};
+use std::iter::Fuse;
+use std::num::NonZeroUsize;
+use std::panic::{self, AssertUnwindSafe};
+use std::rc::Rc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard, PoisonError};
+use std::thread::{self, JoinHandle};
+
+// NOTE: the number of documents handed over to the workers ahead of the output that is
+// being waited for. It bounds the memory held by the documents and the reordered outputs,
+// while keeping the workers busy if some of the documents take longer than the others.
+const MAX_DOCUMENTS_IN_FLIGHT_PER_THREAD: usize = 4;
+
+/// Result of the rewriting of a single document by the [`RewritePool`].
+pub type RewriteResult = Result<Vec<u8>, RewritingError>;
+
+type Panic = Box<dyn Any + Send>;
+type JobResult = (usize, Result<RewriteResult, Panic>);
+
+struct Job {
+    document: Box<dyn AsRef<[u8]> + Send>,
+    idx: usize,
+    results: Sender<JobResult>,
+}
+
+#[inline]
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(PoisonError::into_inner)
+}
+
+/// Job queues of the workers.
+///
+/// Every worker has its own queue, and once the queue is empty, the worker steals the jobs
+/// from the queues of the other workers, so a few big documents don't hold up the rest of them.
+struct JobQueues {
+    queues: Box<[Mutex<VecDeque<Job>>]>,
+    next_queue: AtomicUsize,
+    // NOTE: idle workers wait for the jobs holding this lock, so a job that is pushed
+    // after a worker has checked the queues wakes the worker up.
+    shut_down: Mutex<bool>,
+    job_pushed: Condvar,
+}
+
+impl JobQueues {
+    fn new(queue_count: usize) -> Self {
+        Self {
+            queues: (0..queue_count).map(|_| Mutex::default()).collect(),
+            next_queue: AtomicUsize::new(0),
+            shut_down: Mutex::new(false),
+            job_pushed: Condvar::new(),
+        }
+    }
+
+    fn push(&self, job: Job) {
+        let queue_idx = self.next_queue.fetch_add(1, Ordering::Relaxed) % self.queues.len();
+
+        lock(&self.queues[queue_idx]).push_back(job);
+
+        let _shut_down = lock(&self.shut_down);
+
+        self.job_pushed.notify_one();
+    }
+
+    fn shut_down(&self) {
+        *lock(&self.shut_down) = true;
+        self.job_pushed.notify_all();
+    }
+
+    // NOTE: the oldest jobs are taken first, including the stolen ones, so that the outputs
+    // can be delivered in order as soon as possible.
+    fn find_job(&self, own_queue_idx: usize) -> Option<Job> {
+        let queue_count = self.queues.len();
+
+        (0..queue_count)
+            .find_map(|i| lock(&self.queues[(own_queue_idx + i) % queue_count]).pop_front())
+    }
+
+    /// Returns the next job for the worker, or `None` once the pool is shut down.
+    fn wait_for_job(&self, own_queue_idx: usize) -> Option<Job> {
+        if let Some(job) = self.find_job(own_queue_idx) {
+            return Some(job);
+        }
+
+        let mut shut_down = lock(&self.shut_down);
+
+        loop {
+            if let Some(job) = self.find_job(own_queue_idx) {
+                return Some(job);
+            }
+
+            if *shut_down {
+                return None;
+            }
+
+            shut_down = self
+                .job_pushed
+                .wait(shut_down)
+                .unwrap_or_else(PoisonError::into_inner);
+        }
+    }
+}
+
+#[derive(Clone, Default)]
+struct WorkerOutput(Rc<RefCell<Vec<u8>>>);
+
+impl OutputSink for WorkerOutput {
+    #[inline]
+    fn handle_chunk(&mut self, chunk: &[u8]) {
+        self.0.borrow_mut().extend_from_slice(chunk);
+    }
+}
+
+/// Rewriter state of a worker thread, which is reused for all of the documents
+/// rewritten by the worker.
+struct Worker<'t, F> {
+    template: &'t RewriterTemplate,
+    settings: &'t F,
+    output: WorkerOutput,
+    rewriter: Option<HtmlRewriter<'static, WorkerOutput>>,
+    rebuild_for_every_document: bool,
+}
+
+impl<'t, F> Worker<'t, F>
+where
+    F: Fn() -> Settings<'static, 'static>,
+{
+    fn new(template: &'t RewriterTemplate, settings: &'t F) -> Self {
+        Self {
+            template,
+            settings,
+            output: WorkerOutput::default(),
+            rewriter: None,
+            rebuild_for_every_document: false,
+        }
+    }
+
+    fn rewrite(&mut self, document: &[u8]) -> RewriteResult {
+        let mut rewriter = match self.rewriter.take() {
+            Some(rewriter) => rewriter,
+            None => {
+                let settings = (self.settings)();
+
+                self.rebuild_for_every_document = settings.has_end_handlers();
+
+                HtmlRewriter::from_template(self.template, settings, self.output.clone())
+            }
+        };
+
+        self.output.0.borrow_mut().reserve(document.len());
+
+        // NOTE: rewriters with end handlers can't be reset, so they are dropped instead.
+        let result = match rewriter.write(document) {
+            Ok(()) if self.rebuild_for_every_document => rewriter.end(),
+            Ok(()) => {
+                let result = rewriter.end_and_reset();
+
+                self.rewriter = Some(rewriter);
+                result
+            }
+            Err(e) => {
+                if !self.rebuild_for_every_document {
+                    rewriter.reset();
+                    self.rewriter = Some(rewriter);
+                }
+
+                Err(e)
+            }
+        };
+
+        let output = self.output.0.take();
+
+        result.map(|()| output)
+    }
+
+    fn run(&mut self, queues: &JobQueues, own_queue_idx: usize) {
+        while let Some(job) = queues.wait_for_job(own_queue_idx) {
+            let document: &[u8] = (*job.document).as_ref();
+            let result = panic::catch_unwind(AssertUnwindSafe(|| self.rewrite(document)));
+
+            // NOTE: the rewriter could have been left in an inconsistent state by the panic.
+            if result.is_err() {
+                self.rewriter = None;
+                self.output.0.borrow_mut().clear();
+            }
+
+            // NOTE: the result is dropped if the outputs are not awaited anymore.
+            let _ = job.results.send((job.idx, result));
+        }
+    }
+}
+
+/// A pool of threads that rewrite independent documents in parallel.
+///
+/// The pool owns its worker threads for its whole lifetime. Every worker constructs a rewriter
+/// from the shared [`RewriterTemplate`] and the settings of the pool once, and reuses it for
+/// all of the documents it rewrites (see [`HtmlRewriter::end_and_reset`]). So neither threads
+/// nor rewriters are constructed per document or per call of [`rewrite`].
+///
+/// Documents are distributed between the workers' own queues, and a worker which is done
+/// with its queue steals documents from the queues of the other workers.
+///
+/// # Example
+/// ```
+/// use lol_html::pool::RewritePool;
+/// use lol_html::{element, RewriterTemplate, Settings};
+/// use std::num::NonZeroUsize;
+///
+/// let settings = || Settings {
+///     element_content_handlers: vec![element!("a[href]", |el| {
+///         el.set_attribute("rel", "noopener")?;
+///         Ok(())
+///     })],
+///     ..Settings::new()
+/// };
+///
+/// let template = RewriterTemplate::new(&settings());
+/// let pool = RewritePool::new(template, settings, NonZeroUsize::new(2).unwrap());
+///
+/// let outputs = pool
+///     .rewrite([r#"<a href="/1">"#, r#"<a href="/2">"#])
+///     .collect::<Vec<_>>();
+///
+/// assert_eq!(outputs[0].as_ref().unwrap(), br#"<a href="/1" rel="noopener">"#);
+/// assert_eq!(outputs[1].as_ref().unwrap(), br#"<a href="/2" rel="noopener">"#);
+/// ```
+///
+/// [`rewrite`]: #method.rewrite
+/// [`RewriterTemplate`]: ../struct.RewriterTemplate.html
+/// [`HtmlRewriter::end_and_reset`]: ../struct.HtmlRewriter.html#method.end_and_reset
+pub struct RewritePool {
+    queues: Arc<JobQueues>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+impl RewritePool {
+    /// Spawns `thread_count` worker threads that rewrite documents with the rewriters
+    /// constructed from the `template` and the `settings`.
+    ///
+    /// `settings` are constructed once per worker, on the worker thread, and should be
+    /// compatible with the `template` (see [`HtmlRewriter::from_template`]). Document end
+    /// handlers are invoked only once per rewriter, so if the settings have them, the rewriter
+    /// is constructed from new `settings` for every document instead of being reused.
+    ///
+    /// [`HtmlRewriter::from_template`]: ../struct.HtmlRewriter.html#method.from_template
+    #[must_use]
+    pub fn new<F>(template: RewriterTemplate, settings: F, thread_count: NonZeroUsize) -> Self
+    where
+        F: Fn() -> Settings<'static, 'static> + Send + Sync + 'static,
+    {
+        let queues = Arc::new(JobQueues::new(thread_count.get()));
+        let settings = Arc::new(settings);
+
+        let workers = (0..thread_count.get())
+            .map(|queue_idx| {
+                let queues = Arc::clone(&queues);
+                let template = template.clone();
+                let settings = Arc::clone(&settings);
+
+                thread::spawn(move || {
+                    Worker::new(&template, &*settings).run(&queues, queue_idx);
+                })
+            })
+            .collect();
+
+        Self { queues, workers }
+    }
+
+    /// Returns the number of worker threads of the pool.
+    #[inline]
+    #[must_use]
+    pub fn thread_count(&self) -> usize {
+        self.workers.len()
+    }
+
+    /// Rewrites every document from `documents` and returns an iterator over the outputs in
+    /// the order of the documents.
+    ///
+    /// The documents are taken from `documents` lazily, as the outputs are consumed, so
+    /// `documents` can be an endless stream. Only a few documents per worker are rewritten
+    /// ahead of the output that is returned next.
+    ///
+    /// An error in one of the documents doesn't affect the rest of them. The pool can be used
+    /// from several threads at once.
+    ///
+    /// # Panics
+    /// The returned iterator panics if one of the handlers or the `settings` panic while
+    /// rewriting the document whose output is returned.
+    pub fn rewrite<I>(&self, documents: I) -> Rewrites<'_, I::IntoIter>
+    where
+        I: IntoIterator,
+        I::Item: AsRef<[u8]> + Send + 'static,
+    {
+        let (sender, receiver) = mpsc::channel();
+
+        Rewrites {
+            pool: self,
+            documents: documents.into_iter().fuse(),
+            sender,
+            receiver,
+            reordered: BTreeMap::new(),
+            submitted_count: 0,
+            next_idx: 0,
+        }
+    }
+}
+
+impl Drop for RewritePool {
+    fn drop(&mut self) {
+        self.queues.shut_down();
+
+        for worker in self.workers.drain(..) {
+            // NOTE: panics are passed to the callers of `rewrite`, so the workers don't panic.
+            let _ = worker.join();
+        }
+    }
+}
+
+/// An iterator over the outputs of the documents rewritten by the [`RewritePool`],
+/// in the order of the documents.
+///
+/// The iterator is returned by [`RewritePool::rewrite`].
+///
+/// [`RewritePool::rewrite`]: struct.RewritePool.html#method.rewrite
+pub struct Rewrites<'p, I> {
+    pool: &'p RewritePool,
+    documents: Fuse<I>,
+    sender: Sender<JobResult>,
+    receiver: Receiver<JobResult>,
+    // NOTE: the outputs of the documents that are done before the output which is returned next.
+    reordered: BTreeMap<usize, Result<RewriteResult, Panic>>,
+    submitted_count: usize,
+    next_idx: usize,
+}
+
+impl<I> Rewrites<'_, I>
+where
+    I: Iterator,
+    I::Item: AsRef<[u8]> + Send + 'static,
+{
+    fn submit_documents(&mut self) {
+        let max_in_flight = self.pool.thread_count() * MAX_DOCUMENTS_IN_FLIGHT_PER_THREAD;
+
+        while self.submitted_count - self.next_idx < max_in_flight {
+            let Some(document) = self.documents.next() else {
+                break;
+            };
+
+            self.pool.queues.push(Job {
+                document: Box::new(document),
+                idx: self.submitted_count,
+                results: self.sender.clone(),
+            });
+
+            self.submitted_count += 1;
+        }
+    }
+}
+
+impl<I> Iterator for Rewrites<'_, I>
+where
+    I: Iterator,
+    I::Item: AsRef<[u8]> + Send + 'static,
+{
+    type Item = RewriteResult;
+
+    fn next(&mut self) -> Option<RewriteResult> {
+        self.submit_documents();
+
+        if self.next_idx == self.submitted_count {
+            return None;
+        }
+
+        let result = loop {
+            if let Some(result) = self.reordered.remove(&self.next_idx) {
+                break result;
+            }
+
+            // NOTE: the workers catch panics, so every submitted document gets its result.
+            let (idx, result) = self
+                .receiver
+                .recv()
+                .expect("The iterator should keep the results channel open");
+
+            self.reordered.insert(idx, result);
+        };
+
+        self.next_idx += 1;
+
+        match result {
+            Ok(result) => Some(result),
+            Err(panic) => panic::resume_unwind(panic),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::html_content::ContentType;
+
+    fn thread_count(count: usize) -> NonZeroUsize {
+        NonZeroUsize::new(count).unwrap()
+    }
+
+    #[test]
+    fn outputs_in_order() {
+        let settings = || Settings {
+            element_content_handlers: vec![element!("p", |el| {
+                el.prepend("!", ContentType::Text);
+                Ok(())
+            })],
+            ..Settings::new()
+        };
+
+        let documents = (0..100).map(|i| format!("<p>{i}</p>")).collect::<Vec<_>>();
+
+        for count in [1, 3, 8] {
+            let template = RewriterTemplate::new(&settings());
+            let pool = RewritePool::new(template, settings, thread_count(count));
+            let outputs = pool.rewrite(documents.clone()).collect::<Vec<_>>();
+
+            assert_eq!(outputs.len(), documents.len());
+
+            for (i, output) in outputs.into_iter().enumerate() {
+                assert_eq!(output.unwrap(), format!("<p>!{i}</p>").as_bytes());
+            }
+        }
+    }
+
+    #[test]
+    fn rewriters_reused_across_calls() {
+        let settings_count = Arc::new(AtomicUsize::new(0));
+
+        let settings = {
+            let settings_count = Arc::clone(&settings_count);
+
+            move || {
+                settings_count.fetch_add(1, Ordering::Relaxed);
+                Settings::new()
+            }
+        };
+
+        let template = RewriterTemplate::new(&Settings::new());
+        let pool = RewritePool::new(template, settings, thread_count(4));
+
+        for _ in 0..3 {
+            assert!(pool.rewrite(["<div>"; 16]).all(|o| o.unwrap() == b"<div>"));
+        }
+
+        assert!(settings_count.load(Ordering::Relaxed) <= 4);
+    }
+
+    #[test]
+    fn end_handlers_invoked_for_every_document() {
+        let end_count = Arc::new(AtomicUsize::new(0));
+
+        let settings = {
+            let end_count = Arc::clone(&end_count);
+
+            move || {
+                let end_count = Arc::clone(&end_count);
+
+                Settings {
+                    document_content_handlers: vec![end!(move |end| {
+                        end_count.fetch_add(1, Ordering::Relaxed);
+                        end.append("!", ContentType::Text);
+                        Ok(())
+                    })],
+                    ..Settings::new()
+                }
+            }
+        };
+
+        let template = RewriterTemplate::new(&settings());
+        let pool = RewritePool::new(template, settings, thread_count(2));
+
+        assert!(pool.rewrite(["<div>"; 8]).all(|o| o.unwrap() == b"<div>!"));
+
+        assert_eq!(end_count.load(Ordering::Relaxed), 8);
+    }
+
+    #[test]
+    fn error_doesnt_affect_other_documents() {
+        let settings = || Settings {
+            element_content_handlers: vec![element!("[fail]", |_| Err("Error".into()))],
+            ..Settings::new()
+        };
+
+        let template = RewriterTemplate::new(&settings());
+        let pool = RewritePool::new(template, settings, thread_count(2));
+        let outputs = pool
+            .rewrite(["<div>1</div>", "<div fail>2</div>", "<div>3</div>"])
+            .collect::<Vec<_>>();
+
+        assert_eq!(outputs[0].as_ref().unwrap(), b"<div>1</div>");
+        assert!(matches!(
+            outputs[1],
+            Err(RewritingError::ContentHandlerError(_))
+        ));
+        assert_eq!(outputs[2].as_ref().unwrap(), b"<div>3</div>");
+    }
+
+    #[test]
+    fn handler_panic_is_passed_to_caller() {
+        let settings = || Settings {
+            element_content_handlers: vec![element!("[panic]", |_| panic!("Handler panic"))],
+            ..Settings::new()
+        };
+
+        let template = RewriterTemplate::new(&settings());
+        let pool = RewritePool::new(template, settings, thread_count(1));
+
+        let res = panic::catch_unwind(AssertUnwindSafe(|| {
+            pool.rewrite(["<div panic>"]).for_each(drop);
+        }));
+
+        assert!(res.is_err());
+
+        assert_eq!(pool.rewrite(["<div>"]).next().unwrap().unwrap(), b"<div>");
+    }
+}
@@ -192,24 +192,27 @@ impl<'r, 't, H: HandlerTypes> Element<'r, 't, H> {
     #[inline]
     #[must_use]
     pub fn get_attribute(&self, name: &str) -> Option<String> {
-        let name = name.to_ascii_lowercase();
+        self.get_attribute_ref(name).map(Attribute::value)
+    }
 
-        self.attributes().iter().find_map(|attr| {
-            if attr.name() == name {
-                Some(attr.value())
-            } else {
-                None
-            }
-        })
+    /// Returns an attribute with the `name` without copying its name or value.
+    ///
+    /// Returns `None` if the element doesn't have an attribute with the `name`. Unlike
+    /// [`get_attribute`], this method doesn't allocate for ASCII names, and the value can be
+    /// accessed without allocation with [`Attribute::value_bytes`] or [`Attribute::value_str`].
+    ///
+    /// [`get_attribute`]: #method.get_attribute
+    #[inline]
+    #[must_use]
+    pub fn get_attribute_ref(&self, name: &str) -> Option<&Attribute<'t>> {
+        self.attributes().iter().find(|attr| attr.has_name(name))
     }
 
     /// Returns `true` if the element has an attribute with `name`.
     #[inline]
     #[must_use]
     pub fn has_attribute(&self, name: &str) -> bool {
-        let name = name.to_ascii_lowercase();
-
-        self.attributes().iter().any(|attr| attr.name() == name)
+        self.get_attribute_ref(name).is_some()
     }
 
     /// Sets `value` of element's attribute with `name`.
@@ -738,6 +741,7 @@ mod tests {
     use crate::*;
     use encoding_rs::{Encoding, EUC_JP, UTF_8};
     use rewritable_units::StreamingHandlerSink;
+    use std::borrow::Cow;
 
     fn rewrite_element(
         html: &[u8],
@@ -1125,6 +1129,50 @@ mod tests {
         }
     }
 
+    #[test]
+    fn get_attr_refs() {
+        for (html, enc) in encoded("<Foo Fooα1=Barβ1 Foo2=Bar2>") {
+            rewrite_element(&html, enc, "foo", |el| {
+                let attr = el.get_attribute_ref("FOOα1").unwrap();
+
+                assert_eq!(
+                    attr.value_str().unwrap(),
+                    "Barβ1",
+                    "Encoding: {}",
+                    enc.name()
+                );
+                assert_eq!(
+                    enc.decode_without_bom_handling(attr.value_bytes()).0,
+                    "Barβ1",
+                    "Encoding: {}",
+                    enc.name()
+                );
+
+                let attr = el.get_attribute_ref("fOO2").unwrap();
+
+                assert_eq!(attr.value_bytes(), b"Bar2", "Encoding: {}", enc.name());
+                assert!(
+                    matches!(attr.value_str(), Some(Cow::Borrowed("Bar2"))),
+                    "Encoding: {}",
+                    enc.name()
+                );
+
+                assert!(el.get_attribute_ref("foo3").is_none());
+            });
+        }
+    }
+
+    #[test]
+    fn malformed_attr_value_str() {
+        rewrite_element(b"<foo bar=\"\xFF\">", UTF_8, "foo", |el| {
+            let attr = el.get_attribute_ref("bar").unwrap();
+
+            assert_eq!(attr.value_bytes(), b"\xFF");
+            assert_eq!(attr.value_str(), None);
+            assert_eq!(attr.value(), "\u{FFFD}");
+        });
+    }
+
     #[test]
     fn has_attr() {
         for (html, enc) in encoded("<Foo FooѦ1=Bar1 FooѤ2=Bar2>") {
@@ -6,7 +6,7 @@ use std::sync::Mutex;
 type BoxResult = Result<(), Box<dyn StdError + Send + Sync>>;
 
 /// The type of inserted content.
-#[derive(Copy, Clone)]
+#[derive(Copy, Clone, Debug)]
 pub enum ContentType {
     /// HTML content type. The rewriter will insert the content as is.
     Html,
@@ -1,25 +1,66 @@
 use crate::base::SharedEncoding;
+use crate::memory::BufferPool;
 use crate::rewriter::RewritingError;
+use crate::stats::SharedStats;
 use encoding_rs::{CoderResult, Decoder, Encoding, UTF_8};
+use std::mem;
+
+/// The size of the text buffer used if `Settings::text_decoder_buffer_size` is `0`.
+const DEFAULT_TEXT_BUFFER_SIZE: usize = 1024;
+
+/// The decoder can't make progress with a buffer that doesn't fit a character.
+const MIN_TEXT_BUFFER_SIZE: usize = 4;
 
 pub(crate) struct TextDecoder {
     encoding: SharedEncoding,
     pending_text_streaming_decoder: Option<Decoder>,
     text_buffer: String,
+    buffer_pool: Option<BufferPool>,
+    stats: SharedStats,
 }
 
 impl TextDecoder {
     #[inline]
     #[must_use]
-    pub fn new(encoding: SharedEncoding) -> Self {
+    pub fn new(
+        encoding: SharedEncoding,
+        text_buffer_size: usize,
+        buffer_pool: Option<BufferPool>,
+        stats: SharedStats,
+    ) -> Self {
+        let text_buffer_size = if text_buffer_size == 0 {
+            DEFAULT_TEXT_BUFFER_SIZE
+        } else {
+            text_buffer_size.max(MIN_TEXT_BUFFER_SIZE)
+        };
+
+        let text_buffer = match buffer_pool {
+            Some(ref pool) => {
+                // NOTE: the buffer isn't accounted by the memory limiter, so it shouldn't be
+                // any larger than the buffer that would be allocated without the pool.
+                let mut buffer = pool.take(text_buffer_size, text_buffer_size);
+
+                buffer.resize(text_buffer_size, 0);
+                buffer
+            }
+            None => vec![0u8; text_buffer_size],
+        };
+
         Self {
             encoding,
             pending_text_streaming_decoder: None,
-            // TODO make adjustable
-            text_buffer: String::from_utf8(vec![0u8; 1024]).unwrap(),
+            text_buffer: String::from_utf8(text_buffer).unwrap(),
+            buffer_pool,
+            stats,
         }
     }
 
+    /// Drops the state of the pending text, keeping the text buffer.
+    #[inline]
+    pub fn reset(&mut self) {
+        self.pending_text_streaming_decoder = None;
+    }
+
     #[inline]
     pub fn flush_pending(
         &mut self,
@@ -52,6 +93,8 @@ impl TextDecoder {
             }
         }
 
+        self.stats.add_decoder_slow_path_bytes(raw_input.len());
+
         let decoder = self
             .pending_text_streaming_decoder
             .get_or_insert_with(|| encoding.new_decoder_without_bom_handling());
@@ -110,7 +153,7 @@ impl TextDecoder {
         match text_or_len {
             Ok(utf8_text) => Some((utf8_text, &[][..])),
             Err(valid_up_to) => {
-                // The slow path buffers 1KB, and even though this shouldn't matter,
+                // The slow path buffers up to the text buffer size, and even though this shouldn't matter,
                 // it is an observable behavior, and it makes bugs worse for text handlers
                 // that assume they'll get only a single chunk.
                 if valid_up_to != raw_input.len() && valid_up_to < self.text_buffer.len() {
@@ -123,3 +166,11 @@ impl TextDecoder {
         }
     }
 }
+
+impl Drop for TextDecoder {
+    fn drop(&mut self) {
+        if let Some(ref pool) = self.buffer_pool {
+            pool.give_back(&mut mem::take(&mut self.text_buffer).into_bytes());
+        }
+    }
+}
@@ -4,6 +4,7 @@ use crate::html::escape_double_quotes_only;
 use crate::parser::AttributeBuffer;
 use crate::rewritable_units::Serialize;
 use encoding_rs::Encoding;
+use std::borrow::Cow;
 use std::cell::OnceCell;
 use std::fmt::{self, Debug};
 use std::ops::Deref;
@@ -119,6 +120,52 @@ impl<'i> Attribute<'i> {
         self.value.as_string(self.encoding)
     }
 
+    /// Returns the value of the attribute as it is encoded in the document, without copying it.
+    ///
+    /// The bytes are in the document's [`encoding`], and character references in them
+    /// are not decoded.
+    ///
+    /// [`encoding`]: ../struct.Settings.html#structfield.encoding
+    #[inline]
+    #[must_use]
+    pub fn value_bytes(&self) -> &[u8] {
+        &self.value
+    }
+
+    /// Returns the value of the attribute, borrowing it from the document where possible.
+    ///
+    /// The value is not copied if the document is UTF-8 or if the value consists only of ASCII
+    /// characters. Returns `None` if the value is malformed in the document's [`encoding`],
+    /// in which case [`value`] can be used to get the value with replacement characters.
+    ///
+    /// [`encoding`]: ../struct.Settings.html#structfield.encoding
+    /// [`value`]: #method.value
+    #[inline]
+    #[must_use]
+    pub fn value_str(&self) -> Option<Cow<'_, str>> {
+        self.encoding
+            .decode_without_bom_handling_and_without_replacement(&self.value)
+    }
+
+    /// Returns the name of the attribute as it is encoded in the document.
+    #[inline]
+    pub(crate) fn name_bytes(&self) -> &[u8] {
+        &self.name
+    }
+
+    /// Checks whether the attribute has the `name`, ignoring ASCII case, without allocating
+    /// in the common case of ASCII names.
+    #[inline]
+    pub(crate) fn has_name(&self, name: &str) -> bool {
+        // NOTE: ASCII bytes map to the same characters in all ASCII-compatible encodings,
+        // so ASCII names can be compared without decoding.
+        if name.is_ascii() && self.name.is_ascii() {
+            self.name.eq_ignore_ascii_case(name.as_bytes())
+        } else {
+            self.name() == name.to_ascii_lowercase()
+        }
+    }
+
     #[inline]
     fn set_value(&mut self, value: &str) {
         self.value = BytesCow::from_str(value, self.encoding).into_owned();
@@ -180,13 +227,16 @@ impl<'i> Attributes<'i> {
         value: &str,
         encoding: &'static Encoding,
     ) -> Result<(), AttributeNameError> {
-        let name = name.to_ascii_lowercase();
         let items = self.as_mut_vec();
 
-        match items.iter_mut().find(|attr| attr.name() == name.as_str()) {
+        match items.iter_mut().find(|attr| attr.has_name(name)) {
             Some(attr) => attr.set_value(value),
             None => {
-                items.push(Attribute::try_from(&name, value, encoding)?);
+                items.push(Attribute::try_from(
+                    &name.to_ascii_lowercase(),
+                    value,
+                    encoding,
+                )?);
             }
         }
 
@@ -194,12 +244,11 @@ impl<'i> Attributes<'i> {
     }
 
     pub fn remove_attribute(&mut self, name: &str) -> bool {
-        let name = name.to_ascii_lowercase();
         let items = self.as_mut_vec();
         let mut i = 0;
 
         while i < items.len() {
-            if items[i].name() == name.as_str() {
+            if items[i].has_name(name) {
                 items.remove(i);
                 return true;
             }
@@ -210,6 +259,17 @@ impl<'i> Attributes<'i> {
         false
     }
 
+    /// Removes the attributes for which `f` returns `false`. Returns `true` if any attribute
+    /// has been removed.
+    pub fn retain(&mut self, f: impl FnMut(&Attribute<'i>) -> bool) -> bool {
+        let items = self.as_mut_vec();
+        let len = items.len();
+
+        items.retain(f);
+
+        items.len() != len
+    }
+
     fn init_items(&self) -> Vec<Attribute<'i>> {
         self.attribute_buffer
             .iter()
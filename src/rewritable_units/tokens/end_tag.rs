@@ -51,6 +51,12 @@ impl<'i> EndTag<'i> {
         self.name.as_string(self.encoding)
     }
 
+    /// Returns the name of the tag as it is encoded in the document.
+    #[inline]
+    pub(crate) fn name_bytes(&self) -> &[u8] {
+        &self.name
+    }
+
     #[doc(hidden)]
     #[deprecated(
         note = "this method won't convert the string encoding, and the type of the argument is a private implementation detail. Use set_name_str() instead"
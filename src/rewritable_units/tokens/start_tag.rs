@@ -59,6 +59,12 @@ impl<'i> StartTag<'i> {
         self.name.as_string(self.attributes.encoding)
     }
 
+    /// Returns the name of the tag as it is encoded in the document.
+    #[inline]
+    pub(crate) fn name_bytes(&self) -> &[u8] {
+        &self.name
+    }
+
     /// Sets the name of the tag.
     #[inline]
     pub(crate) fn set_name_raw(&mut self, name: BytesCow<'static>) {
@@ -116,6 +122,14 @@ impl<'i> StartTag<'i> {
         }
     }
 
+    /// Removes the attributes for which `f` returns `false`.
+    #[inline]
+    pub(crate) fn retain_attributes(&mut self, f: impl FnMut(&Attribute<'i>) -> bool) {
+        if self.attributes.retain(f) {
+            self.raw = None;
+        }
+    }
+
     /// Whether the tag syntactically ends with `/>`. In HTML content this is purely a decorative, unnecessary, and has no effect of any kind.
     ///
     /// The `/>` syntax only affects parsing of elements in foreign content (SVG and MathML).
@@ -2,6 +2,7 @@ use super::settings::*;
 use super::ElementDescriptor;
 use crate::rewritable_units::{DocumentEnd, Element, StartTag, Token, TokenCaptureFlags};
 use crate::selectors_vm::MatchInfo;
+use crate::stats::SharedStats;
 
 #[derive(Copy, Clone, Default, Debug, PartialEq, Eq, Hash)]
 pub(crate) struct SelectorHandlersLocator {
@@ -13,11 +14,15 @@ pub(crate) struct SelectorHandlersLocator {
 struct HandlerVecItem<H> {
     handler: H,
     user_count: usize,
+    always_active: bool,
+    once: bool,
+    exhausted: bool,
 }
 
 struct HandlerVec<H> {
     items: Vec<HandlerVecItem<H>>,
     user_count: usize,
+    exhausted_count: usize,
 }
 
 impl<H> Default for HandlerVec<H> {
@@ -25,16 +30,20 @@ impl<H> Default for HandlerVec<H> {
         Self {
             items: Vec::default(),
             user_count: 0,
+            exhausted_count: 0,
         }
     }
 }
 
 impl<H> HandlerVec<H> {
     #[inline]
-    pub fn push(&mut self, handler: H, always_active: bool) {
+    pub fn push(&mut self, handler: H, always_active: bool, once: bool) {
         let item = HandlerVecItem {
             handler,
             user_count: usize::from(always_active),
+            always_active,
+            once,
+            exhausted: false,
         };
 
         self.user_count += item.user_count;
@@ -46,16 +55,55 @@ impl<H> HandlerVec<H> {
         self.items.len()
     }
 
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.items.is_empty()
+    }
+
+    /// Returns `true` if none of the handlers can be invoked anymore.
+    #[inline]
+    pub fn is_exhausted(&self) -> bool {
+        self.exhausted_count == self.items.len()
+    }
+
+    /// Deactivates all of the handlers, except for the ones that are always active.
+    /// Handlers that are invoked at most once can be invoked again.
+    pub fn reset(&mut self) {
+        self.user_count = 0;
+        self.exhausted_count = 0;
+
+        for item in &mut self.items {
+            item.user_count = usize::from(item.always_active);
+            item.exhausted = false;
+            self.user_count += item.user_count;
+        }
+    }
+
+    #[inline]
+    pub fn clear(&mut self) {
+        self.items.clear();
+        self.user_count = 0;
+        self.exhausted_count = 0;
+    }
+
     #[inline]
     pub fn inc_user_count(&mut self, idx: usize) {
-        self.items[idx].user_count += 1;
-        self.user_count += 1;
+        let item = &mut self.items[idx];
+
+        if !item.exhausted {
+            item.user_count += 1;
+            self.user_count += 1;
+        }
     }
 
     #[inline]
     pub fn dec_user_count(&mut self, idx: usize) {
-        self.items[idx].user_count -= 1;
-        self.user_count -= 1;
+        let item = &mut self.items[idx];
+
+        if !item.exhausted {
+            item.user_count -= 1;
+            self.user_count -= 1;
+        }
     }
 
     #[inline]
@@ -63,6 +111,11 @@ impl<H> HandlerVec<H> {
         self.user_count > 0
     }
 
+    #[inline]
+    pub fn is_active(&self, idx: usize) -> bool {
+        self.items[idx].user_count > 0
+    }
+
     #[inline]
     pub fn for_each_active(
         &mut self,
@@ -71,6 +124,13 @@ impl<H> HandlerVec<H> {
         for item in &mut self.items {
             if item.user_count > 0 {
                 cb(&mut item.handler)?;
+
+                if item.once {
+                    self.user_count -= item.user_count;
+                    item.user_count = 0;
+                    item.exhausted = true;
+                    self.exhausted_count += 1;
+                }
             }
         }
 
@@ -87,6 +147,11 @@ impl<H> HandlerVec<H> {
                 cb(&mut item.handler)?;
                 self.user_count -= item.user_count;
                 item.user_count = 0;
+
+                if item.once {
+                    item.exhausted = true;
+                    self.exhausted_count += 1;
+                }
             }
         }
 
@@ -119,8 +184,14 @@ pub(crate) struct ContentHandlersDispatcher<'h, H: HandlerTypes> {
     end_tag_handlers: HandlerVec<H::EndTagHandler<'static>>,
     element_handlers: HandlerVec<H::ElementHandler<'h>>,
     end_handlers: HandlerVec<H::EndHandler<'h>>,
+    /// Handlers of the selectors, indexed by the selector payloads of the matching VM.
+    selector_handlers: Vec<SelectorHandlersLocator>,
+    /// Indices of the text handlers that receive whole text nodes, along with the maximum
+    /// size of the text nodes.
+    whole_text_node_limits: Vec<(usize, usize)>,
     next_element_can_have_content: bool,
     matched_elements_with_removed_content: usize,
+    stats: SharedStats,
 }
 
 impl<H: HandlerTypes> Default for ContentHandlersDispatcher<'_, H> {
@@ -132,51 +203,125 @@ impl<H: HandlerTypes> Default for ContentHandlersDispatcher<'_, H> {
             end_tag_handlers: Default::default(),
             element_handlers: Default::default(),
             end_handlers: Default::default(),
+            selector_handlers: Vec::default(),
+            whole_text_node_limits: Vec::default(),
             next_element_can_have_content: false,
             matched_elements_with_removed_content: 0,
+            stats: SharedStats::default(),
         }
     }
 }
 
 impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
+    /// Creates a dispatcher that accounts the time spent in the handlers in the `stats`.
+    #[inline]
+    pub fn with_stats(stats: SharedStats) -> Self {
+        Self {
+            stats,
+            ..Self::default()
+        }
+    }
+
     #[inline]
     pub fn add_document_content_handlers(&mut self, handlers: DocumentContentHandlers<'h, H>) {
         if let Some(handler) = handlers.doctype {
-            self.doctype_handlers.push(handler, true);
+            self.doctype_handlers.push(handler, true, handlers.once);
         }
 
         if let Some(handler) = handlers.comments {
-            self.comment_handlers.push(handler, true);
+            self.comment_handlers.push(handler, true, handlers.once);
         }
 
         if let Some(handler) = handlers.text {
-            self.text_handlers.push(handler, true);
+            self.add_text_handler(handler, handlers.whole_text_nodes, true, handlers.once);
         }
 
         if let Some(handler) = handlers.end {
-            self.end_handlers.push(handler, true);
+            // NOTE: the document end handler is invoked once anyway.
+            self.end_handlers.push(handler, true, false);
         }
     }
 
+    /// Adds the handlers of the next selector. The selector should be added to the matching
+    /// VM with its index, the number of selectors added before it, as the payload.
     #[inline]
     pub fn add_selector_associated_handlers(
         &mut self,
         handlers: ElementContentHandlers<'h, H>,
     ) -> SelectorHandlersLocator {
-        SelectorHandlersLocator {
+        let locator = SelectorHandlersLocator {
             element_handler_idx: handlers.element.map(|h| {
-                self.element_handlers.push(h, false);
+                self.element_handlers.push(h, false, handlers.once);
                 self.element_handlers.len() - 1
             }),
             comment_handler_idx: handlers.comments.map(|h| {
-                self.comment_handlers.push(h, false);
+                self.comment_handlers.push(h, false, handlers.once);
                 self.comment_handlers.len() - 1
             }),
-            text_handler_idx: handlers.text.map(|h| {
-                self.text_handlers.push(h, false);
-                self.text_handlers.len() - 1
-            }),
+            text_handler_idx: handlers
+                .text
+                .map(|h| self.add_text_handler(h, handlers.whole_text_nodes, false, handlers.once)),
+        };
+
+        self.selector_handlers.push(locator);
+
+        locator
+    }
+
+    #[inline]
+    fn add_text_handler(
+        &mut self,
+        handler: H::TextHandler<'h>,
+        whole_text_nodes: Option<usize>,
+        always_active: bool,
+        once: bool,
+    ) -> usize {
+        let idx = self.text_handlers.len();
+
+        self.text_handlers.push(handler, always_active, once);
+
+        if let Some(max_size) = whole_text_nodes {
+            self.whole_text_node_limits.push((idx, max_size));
         }
+
+        idx
+    }
+
+    /// Returns the dispatcher to the state it had before the first document. Document end
+    /// handlers that have already been invoked are not restored.
+    pub fn reset(&mut self) {
+        self.doctype_handlers.reset();
+        self.comment_handlers.reset();
+        self.text_handlers.reset();
+        self.element_handlers.reset();
+        self.end_handlers.reset();
+
+        // NOTE: end tag handlers are attached to the elements of the previous document.
+        self.end_tag_handlers.clear();
+
+        self.next_element_can_have_content = false;
+        self.matched_elements_with_removed_content = 0;
+    }
+
+    /// Returns `true` if none of the handlers can be invoked for the rest of the document.
+    ///
+    /// At least one handler should have been exhausted by its invocation, so the documents
+    /// are still parsed as a whole if there are no `once` handlers, or no handlers at all.
+    #[inline]
+    pub fn is_exhausted(&self) -> bool {
+        let exhausted_count = self.doctype_handlers.exhausted_count
+            + self.comment_handlers.exhausted_count
+            + self.text_handlers.exhausted_count
+            + self.element_handlers.exhausted_count;
+
+        exhausted_count > 0
+            && self.doctype_handlers.is_exhausted()
+            && self.comment_handlers.is_exhausted()
+            && self.text_handlers.is_exhausted()
+            && self.element_handlers.is_exhausted()
+            && self.end_tag_handlers.is_empty()
+            && self.end_handlers.is_empty()
+            && self.matched_elements_with_removed_content == 0
     }
 
     #[inline]
@@ -185,8 +330,8 @@ impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
     }
 
     #[inline]
-    pub fn start_matching(&mut self, match_info: &MatchInfo<SelectorHandlersLocator>) {
-        let locator = match_info.payload;
+    pub fn start_matching(&mut self, match_info: &MatchInfo<usize>) {
+        let locator = self.selector_handlers[match_info.payload];
 
         if match_info.with_content {
             if let Some(idx) = locator.comment_handler_idx {
@@ -207,7 +352,9 @@ impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
 
     #[inline]
     pub fn stop_matching(&mut self, elem_desc: ElementDescriptor) {
-        for locator in elem_desc.matched_content_handlers {
+        for selector_idx in elem_desc.matched_content_handlers.iter() {
+            let locator = self.selector_handlers[selector_idx];
+
             if let Some(idx) = locator.comment_handler_idx {
                 self.comment_handlers.dec_user_count(idx);
             }
@@ -238,7 +385,7 @@ impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
         let mut element = Element::new(start_tag, self.next_element_can_have_content);
 
         self.element_handlers
-            .do_for_each_active_and_deactivate(|h| h(&mut element))?;
+            .do_for_each_active_and_deactivate(|h| self.stats.time_handlers(|| h(&mut element)))?;
 
         if self.next_element_can_have_content {
             if let Some(elem_desc) = current_element_data {
@@ -250,7 +397,7 @@ impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
                 if let Some(handler) = element.into_end_tag_handler() {
                     elem_desc.end_tag_handler_idx = Some(self.end_tag_handlers.len());
 
-                    self.end_tag_handlers.push(handler, false);
+                    self.end_tag_handlers.push(handler, false, false);
                 }
             }
         }
@@ -263,20 +410,41 @@ impl<'h, H: HandlerTypes> ContentHandlersDispatcher<'h, H> {
         token: &mut Token<'_>,
         current_element_data: Option<&mut ElementDescriptor>,
     ) -> HandlerResult {
+        let stats = &self.stats;
+
         match token {
-            Token::Doctype(doctype) => self.doctype_handlers.for_each_active(|h| h(doctype)),
+            Token::Doctype(doctype) => self
+                .doctype_handlers
+                .for_each_active(|h| stats.time_handlers(|| h(doctype))),
             Token::StartTag(start_tag) => self.handle_start_tag(start_tag, current_element_data),
             Token::EndTag(end_tag) => self
                 .end_tag_handlers
-                .do_for_each_active_and_remove(|h| h(end_tag)),
-            Token::TextChunk(text) => self.text_handlers.for_each_active(|h| h(text)),
-            Token::Comment(comment) => self.comment_handlers.for_each_active(|h| h(comment)),
+                .do_for_each_active_and_remove(|h| stats.time_handlers(|| h(end_tag))),
+            Token::TextChunk(text) => self
+                .text_handlers
+                .for_each_active(|h| stats.time_handlers(|| h(text))),
+            Token::Comment(comment) => self
+                .comment_handlers
+                .for_each_active(|h| stats.time_handlers(|| h(comment))),
         }
     }
 
     pub fn handle_end(&mut self, document_end: &mut DocumentEnd<'_>) -> HandlerResult {
+        let stats = &self.stats;
+
         self.end_handlers
-            .do_for_each_active_and_remove(|h| h(document_end))
+            .do_for_each_active_and_remove(|h| stats.time_handlers(|| h(document_end)))
+    }
+
+    /// Returns the largest text node size requested by the active text handlers that
+    /// receive whole text nodes.
+    #[inline]
+    pub fn whole_text_node_limit(&self) -> Option<usize> {
+        self.whole_text_node_limits
+            .iter()
+            .filter(|&&(idx, _)| self.text_handlers.is_active(idx))
+            .map(|&(_, max_size)| max_size)
+            .max()
     }
 
     #[inline]
@@ -1,21 +1,31 @@
 mod handlers_dispatcher;
 mod rewrite_controller;
+mod rewrite_rule;
+mod sanitizer;
 
 #[macro_use]
 pub(crate) mod settings;
 
+mod template;
+
 use self::rewrite_controller::{ElementDescriptor, HtmlRewriteController};
+pub use self::rewrite_rule::RewriteRule;
+pub use self::sanitizer::SanitizerPolicy;
 pub use self::settings::*;
+pub use self::template::RewriterTemplate;
 use crate::base::SharedEncoding;
 use crate::memory::{MemoryLimitExceededError, SharedMemoryLimiter};
 use crate::parser::ParsingAmbiguityError;
 use crate::rewritable_units::Element;
+use crate::stats::SharedStats;
 use crate::transform_stream::*;
 use encoding_rs::Encoding;
 use mime::Mime;
 use std::borrow::Cow;
 use std::error::Error as StdError;
 use std::fmt::{self, Debug};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
 use thiserror::Error;
 
 /// This is an encoding known to be ASCII-compatible.
@@ -62,10 +72,11 @@ impl TryFrom<&'static Encoding> for AsciiCompatibleEncoding {
 ///
 /// # Note
 /// This error is unrecoverable. The rewriter instance will panic on attempt to use it after such an
-/// error.
+/// error, unless it is [`reset`].
 ///
 /// [`write`]: ../struct.HtmlRewriter.html#method.write
 /// [`end`]: ../struct.HtmlRewriter.html#method.end
+/// [`reset`]: ../struct.HtmlRewriter.html#method.reset
 #[derive(Error, Debug)]
 pub enum RewritingError {
     /// See [`MemoryLimitExceededError`].
@@ -128,6 +139,10 @@ pub enum RewritingError {
 pub struct HtmlRewriter<'h, O: OutputSink, H: HandlerTypes = LocalHandlerTypes> {
     stream: TransformStream<HtmlRewriteController<'h, H>, O>,
     poisoned: bool,
+    // NOTE: document end handlers are invoked only once, so a rewriter that has them can't be
+    // reset, and can't be used once its document is ended.
+    has_end_handlers: bool,
+    ended: bool,
 }
 
 macro_rules! guarded {
@@ -137,6 +152,8 @@ macro_rules! guarded {
             "Attempt to use the HtmlRewriter after a fatal error."
         );
 
+        $self.assert_reusable();
+
         let res = $expr;
 
         if res.is_err() {
@@ -157,31 +174,164 @@ impl<'h, O: OutputSink, H: HandlerTypes> HtmlRewriter<'h, O, H> {
     ///
     /// [`OutputSink`]: trait.OutputSink.html
     pub fn new<'s>(settings: Settings<'h, 's, H>, output_sink: O) -> Self {
-        let preallocated_parsing_buffer_size =
-            settings.memory_settings.preallocated_parsing_buffer_size;
+        Self::new_with_template(settings, None, output_sink)
+    }
+
+    /// Constructs a new rewriter with selectors that have been compiled ahead of time
+    /// into the `template`.
+    ///
+    /// Selectors of the `settings` are not compiled again, which makes the construction
+    /// considerably cheaper. Refer to [`RewriterTemplate`] documentation for more information.
+    ///
+    /// # Panics
+    ///  * If `settings` have different selectors, handler kinds, encoding or selector-related
+    ///    options than the settings the `template` has been created from.
+    ///
+    /// [`RewriterTemplate`]: struct.RewriterTemplate.html
+    pub fn from_template<'s>(
+        template: &RewriterTemplate,
+        settings: Settings<'h, 's, H>,
+        output_sink: O,
+    ) -> Self {
+        template.assert_compatible_with(&settings);
+
+        Self::new_with_template(settings, Some(template), output_sink)
+    }
+
+    /// Same as [`HtmlRewriter::new`], but returns an error instead of panicking if
+    /// the preallocated memory exceeds the [`MemorySettings::max_allowed_memory_usage`], and
+    /// if the [`Settings::memory_budget`] can't cover the preallocated memory.
+    ///
+    /// This allows for the admission control of the rewriters that share a memory budget:
+    /// a rewriter is only constructed if there is enough memory left in the budget to start
+    /// rewriting.
+    ///
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    /// [`Settings::memory_budget`]: struct.Settings.html#structfield.memory_budget
+    pub fn try_new<'s>(
+        settings: Settings<'h, 's, H>,
+        output_sink: O,
+    ) -> Result<Self, MemoryLimitExceededError> {
+        Self::try_new_with_template(settings, None, output_sink)
+    }
+
+    /// Same as [`HtmlRewriter::from_template`], but returns an error instead of panicking if
+    /// the preallocated memory can't be accounted. See [`HtmlRewriter::try_new`].
+    ///
+    /// # Panics
+    ///  * If `settings` have different selectors, handler kinds, encoding or selector-related
+    ///    options than the settings the `template` has been created from.
+    pub fn try_from_template<'s>(
+        template: &RewriterTemplate,
+        settings: Settings<'h, 's, H>,
+        output_sink: O,
+    ) -> Result<Self, MemoryLimitExceededError> {
+        template.assert_compatible_with(&settings);
+
+        Self::try_new_with_template(settings, Some(template), output_sink)
+    }
+
+    fn new_with_template(
+        settings: Settings<'h, '_, H>,
+        template: Option<&RewriterTemplate>,
+        output_sink: O,
+    ) -> Self {
+        let memory_limiter = SharedMemoryLimiter::with_budget(
+            settings.memory_settings.max_allowed_memory_usage,
+            settings.memory_budget.clone(),
+        );
+
+        let preallocated_parsing_buffer_size = settings.preallocated_parsing_buffer_size();
+
+        Self::new_with_memory_limiter(
+            settings,
+            template,
+            memory_limiter,
+            preallocated_parsing_buffer_size,
+            output_sink,
+        )
+    }
+
+    fn try_new_with_template(
+        settings: Settings<'h, '_, H>,
+        template: Option<&RewriterTemplate>,
+        output_sink: O,
+    ) -> Result<Self, MemoryLimitExceededError> {
+        let memory_limiter = SharedMemoryLimiter::with_budget(
+            settings.memory_settings.max_allowed_memory_usage,
+            settings.memory_budget.clone(),
+        );
+
+        // NOTE: the size is computed once, since a shared histogram can change in the
+        // meantime. Once the credit is taken, the preallocation of this size can't fail.
+        let preallocated_parsing_buffer_size = settings.preallocated_parsing_buffer_size();
+
+        memory_limiter.reserve_credit(preallocated_parsing_buffer_size)?;
+
+        Ok(Self::new_with_memory_limiter(
+            settings,
+            template,
+            memory_limiter,
+            preallocated_parsing_buffer_size,
+            output_sink,
+        ))
+    }
+
+    fn new_with_memory_limiter(
+        settings: Settings<'h, '_, H>,
+        template: Option<&RewriterTemplate>,
+        memory_limiter: SharedMemoryLimiter,
+        preallocated_parsing_buffer_size: usize,
+        output_sink: O,
+    ) -> Self {
+        let buffer_pool = settings.buffer_pool.clone();
+        let parsing_buffer_histogram = settings.parsing_buffer_histogram.clone();
+        let text_decoder_buffer_size = settings.text_decoder_buffer_size;
+        let input_encoding = settings.input_encoding;
+        let disable_output = settings.disable_output;
         let strict = settings.strict;
+        let has_end_handlers = settings.has_end_handlers();
+
+        assert!(
+            input_encoding.is_none()
+                || (settings.encoding == AsciiCompatibleEncoding::utf_8()
+                    && !settings.adjust_charset_on_meta_tag),
+            "Transcoded input can only be rewritten in UTF-8 without charset adjustment."
+        );
 
         let encoding = SharedEncoding::new(settings.encoding);
 
-        let memory_limiter =
-            SharedMemoryLimiter::new(settings.memory_settings.max_allowed_memory_usage);
+        #[cfg(feature = "stats")]
+        let stats = SharedStats::new(settings.enable_stats);
+        #[cfg(not(feature = "stats"))]
+        let stats = SharedStats::default();
 
         let stream = TransformStream::new(TransformStreamSettings {
             transform_controller: HtmlRewriteController::from_settings(
                 settings,
+                template,
                 &memory_limiter,
                 &encoding,
+                &stats,
             ),
             output_sink,
             preallocated_parsing_buffer_size,
+            text_decoder_buffer_size,
             memory_limiter,
+            buffer_pool,
+            parsing_buffer_histogram,
             encoding,
+            input_encoding,
+            disable_output,
             strict,
+            stats,
         });
 
         HtmlRewriter {
             stream,
             poisoned: false,
+            has_end_handlers,
+            ended: false,
         }
     }
 
@@ -212,6 +362,174 @@ impl<'h, O: OutputSink, H: HandlerTypes> HtmlRewriter<'h, O, H> {
     pub fn end(mut self) -> Result<(), RewritingError> {
         guarded!(self, self.stream.end())
     }
+
+    /// Finalizes the rewriting process like [`end`] does, and then [`reset`]s the rewriter,
+    /// so it can be used to rewrite the next document.
+    ///
+    /// The rewriter is reset even if the method returns an error.
+    ///
+    /// If the rewriter has document end handlers, it can't be reset (see [`reset`]). Then it's
+    /// kept only for its [`stats`], and any further attempt to use it panics.
+    ///
+    /// # Panics
+    ///  * If previous invocation of [`write`] returned a [`RewritingError`] (these errors
+    ///    are unrecovarable).
+    ///
+    /// [`RewritingError`]: errors/enum.RewritingError.html
+    /// [`end`]: struct.HtmlRewriter.html#method.end
+    /// [`reset`]: struct.HtmlRewriter.html#method.reset
+    /// [`stats`]: struct.HtmlRewriter.html#method.stats
+    /// [`write`]: struct.HtmlRewriter.html#method.write
+    pub fn end_and_reset(&mut self) -> Result<(), RewritingError> {
+        let res = guarded!(self, self.stream.end());
+
+        if self.has_end_handlers {
+            self.ended = true;
+        } else {
+            self.reset();
+        }
+
+        res
+    }
+
+    /// Returns the rewriter to its initial state, discarding the state of the document that
+    /// is currently being rewritten, if any.
+    ///
+    /// Buffers allocated by the rewriter are kept, so reusing one rewriter for many documents
+    /// is cheaper than constructing a new rewriter for each of them. The rewriter can be reset
+    /// after a [`RewritingError`] as well. The output sink is reset too (see
+    /// [`OutputSink::reset`]), so the output it has buffered for the discarded document is
+    /// dropped.
+    ///
+    /// # Note
+    /// Element end tag handlers registered for the elements of the discarded document are
+    /// dropped without being invoked.
+    ///
+    /// # Panics
+    ///  * If the rewriter has document end handlers. They are [`FnOnce`] and can only be invoked
+    ///    at the end of one document, so a new rewriter should be constructed for every
+    ///    document instead.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{element, HtmlRewriter, Settings};
+    ///
+    /// let mut output = vec![];
+    /// let mut rewriter = HtmlRewriter::new(
+    ///     Settings {
+    ///         element_content_handlers: vec![element!("b", |el| {
+    ///             el.set_tag_name("strong")?;
+    ///             Ok(())
+    ///         })],
+    ///         ..Settings::new()
+    ///     },
+    ///     |c: &[u8]| output.extend_from_slice(c),
+    /// );
+    ///
+    /// for doc in ["<b>1</b>", "<b>2</b>"] {
+    ///     rewriter.write(doc.as_bytes()).unwrap();
+    ///     rewriter.end_and_reset().unwrap();
+    /// }
+    ///
+    /// drop(rewriter);
+    ///
+    /// assert_eq!(output, b"<strong>1</strong><strong>2</strong>");
+    /// ```
+    ///
+    /// [`RewritingError`]: errors/enum.RewritingError.html
+    /// [`OutputSink::reset`]: trait.OutputSink.html#method.reset
+    /// [`FnOnce`]: https://doc.rust-lang.org/std/ops/trait.FnOnce.html
+    pub fn reset(&mut self) {
+        // NOTE: the end handlers would be lost in the next document.
+        self.ended |= self.has_end_handlers;
+        self.assert_reusable();
+        self.stream.reset();
+        self.poisoned = false;
+    }
+
+    #[inline]
+    #[track_caller]
+    fn assert_reusable(&self) {
+        assert!(
+            !self.ended,
+            "Rewriters with document end handlers can't be reused for another document."
+        );
+    }
+
+    /// Returns the stats collected by the rewriter, or `None` if the rewriter has been created
+    /// without [`Settings::enable_stats`].
+    ///
+    /// The stats accumulate over all of the documents rewritten by the rewriter, they are not
+    /// cleared by [`reset`]. Use [`end_and_reset`] instead of [`end`] to get the stats that
+    /// include the end of the last document.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{element, HtmlRewriter, Settings};
+    ///
+    /// let mut rewriter = HtmlRewriter::new(
+    ///     Settings {
+    ///         element_content_handlers: vec![element!("a[href]", |_| Ok(()))],
+    ///         enable_stats: true,
+    ///         ..Settings::new()
+    ///     },
+    ///     |_: &[u8]| {},
+    /// );
+    ///
+    /// rewriter.write(br#"<div><a href="/">"#).unwrap();
+    /// rewriter.end_and_reset().unwrap();
+    ///
+    /// let stats = rewriter.stats().unwrap();
+    ///
+    /// assert_eq!(stats.selector_vm_bailouts, 1);
+    /// ```
+    ///
+    /// [`Settings::enable_stats`]: struct.Settings.html#structfield.enable_stats
+    /// [`reset`]: struct.HtmlRewriter.html#method.reset
+    /// [`end_and_reset`]: struct.HtmlRewriter.html#method.end_and_reset
+    /// [`end`]: struct.HtmlRewriter.html#method.end
+    #[cfg(feature = "stats")]
+    #[must_use]
+    pub fn stats(&self) -> Option<crate::RewriterStats> {
+        self.stream.stats().snapshot()
+    }
+
+    /// Returns a mutable reference to the output sink of the rewriter.
+    ///
+    /// This allows the output sink to be accessed in the middle of the document, e.g. to
+    /// [`flush`] the output of a [`BufferedOutputSink`], so that a streaming client doesn't
+    /// wait for the buffer to fill up.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{BufferedOutputSink, HtmlRewriter, Settings};
+    ///
+    /// let mut output = vec![];
+    ///
+    /// {
+    ///     let mut rewriter = HtmlRewriter::new(
+    ///         Settings::new(),
+    ///         BufferedOutputSink::new(4096, |c: &[u8]| output.push(c.to_vec())),
+    ///     );
+    ///
+    ///     rewriter.write(b"<div>foo</div>").unwrap();
+    ///     rewriter.output_sink_mut().flush();
+    ///     rewriter.write(b"<div>bar</div>").unwrap();
+    ///     rewriter.end().unwrap();
+    /// }
+    ///
+    /// assert_eq!(
+    ///     output,
+    ///     [b"<div>foo</div>".to_vec(), b"<div>bar</div>".to_vec(), vec![]]
+    /// );
+    /// ```
+    ///
+    /// [`flush`]: struct.BufferedOutputSink.html#method.flush
+    /// [`BufferedOutputSink`]: struct.BufferedOutputSink.html
+    #[inline]
+    pub fn output_sink_mut(&mut self) -> &mut O {
+        self.stream.output_sink_mut()
+    }
 }
 
 // NOTE: this opaque Debug implementation is required to make
@@ -224,46 +542,73 @@ impl<O: OutputSink, H: HandlerTypes> Debug for HtmlRewriter<'_, O, H> {
     }
 }
 
-fn handler_adjust_charset_on_meta_tag<'h, H: HandlerTypes>(
+/// Changes the encoding of the rewriter once a `<meta>` tag with a charset is
+/// encountered (see [`Settings::adjust_charset_on_meta_tag`]).
+pub(crate) struct CharsetAdjustment {
     encoding: SharedEncoding,
-) -> (Cow<'h, crate::Selector>, ElementContentHandlers<'h, H>) {
+    initial_encoding: AsciiCompatibleEncoding,
     // HTML5 allows encoding to be set only once
-    let mut found = false;
+    found: Arc<AtomicBool>,
+}
 
-    let handler = move |el: &mut Element<'_, '_, H>| {
-        if found {
-            return Ok(());
+impl CharsetAdjustment {
+    pub fn new(encoding: SharedEncoding, initial_encoding: AsciiCompatibleEncoding) -> Self {
+        Self {
+            encoding,
+            initial_encoding,
+            found: Arc::default(),
         }
+    }
 
-        let charset = el.get_attribute("charset").and_then(|cs| {
-            AsciiCompatibleEncoding::new(Encoding::for_label_no_replacement(cs.as_bytes())?)
-        });
+    pub fn handlers<'h, H: HandlerTypes>(
+        &self,
+    ) -> (Cow<'h, crate::Selector>, ElementContentHandlers<'h, H>) {
+        let encoding = SharedEncoding::clone(&self.encoding);
+        let found = Arc::clone(&self.found);
 
-        let charset = charset.or_else(|| {
-            el.get_attribute("http-equiv")
-                .filter(|http_equiv| http_equiv.eq_ignore_ascii_case("Content-Type"))
-                .and_then(|_| {
-                    AsciiCompatibleEncoding::from_mimetype(
-                        &el.get_attribute("content")?.parse::<Mime>().ok()?,
-                    )
-                })
-        });
+        let handler = move |el: &mut Element<'_, '_, H>| {
+            if found.load(Ordering::Relaxed) {
+                return Ok(());
+            }
 
-        if let Some(charset) = charset {
-            found = true;
-            encoding.set(charset);
-        }
+            let charset = el.get_attribute("charset").and_then(|cs| {
+                AsciiCompatibleEncoding::new(Encoding::for_label_no_replacement(cs.as_bytes())?)
+            });
+
+            let charset = charset.or_else(|| {
+                el.get_attribute("http-equiv")
+                    .filter(|http_equiv| http_equiv.eq_ignore_ascii_case("Content-Type"))
+                    .and_then(|_| {
+                        AsciiCompatibleEncoding::from_mimetype(
+                            &el.get_attribute("content")?.parse::<Mime>().ok()?,
+                        )
+                    })
+            });
+
+            if let Some(charset) = charset {
+                found.store(true, Ordering::Relaxed);
+                encoding.set(charset);
+            }
+
+            Ok(())
+        };
 
-        Ok(())
-    };
+        let content_handlers = ElementContentHandlers {
+            element: Some(H::new_element_handler(handler)),
+            comments: None,
+            text: None,
+            whole_text_nodes: None,
+            once: false,
+        };
 
-    let content_handlers = ElementContentHandlers {
-        element: Some(H::new_element_handler(handler)),
-        comments: None,
-        text: None,
-    };
+        (Cow::Owned("meta".parse().unwrap()), content_handlers)
+    }
 
-    (Cow::Owned("meta".parse().unwrap()), content_handlers)
+    /// Restores the initial encoding, so the charset can be adjusted again in the next document.
+    pub fn reset(&self) {
+        self.encoding.set(self.initial_encoding);
+        self.found.store(false, Ordering::Relaxed);
+    }
 }
 
 /// Rewrites given `html` string with the provided `settings`.
@@ -773,6 +1118,399 @@ mod tests {
         assert_eq!(transformed_charset_adjustment, expected);
     }
 
+    #[test]
+    fn reuse_after_reset() {
+        let mut output = vec![];
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                element_content_handlers: vec![
+                    element!("span", |el| {
+                        el.set_inner_content("x", ContentType::Text);
+                        Ok(())
+                    }),
+                    element!("body > p", |el| {
+                        el.set_attribute("class", "x")?;
+                        Ok(())
+                    }),
+                ],
+                ..Settings::new()
+            },
+            |c: &[u8]| output.extend_from_slice(c),
+        );
+
+        // NOTE: leave the parser in the script data state with removed content
+        // and unclosed elements on the stack.
+        rewriter.write(b"<body><span><script>foo</sc").unwrap();
+        rewriter.reset();
+
+        for _ in 0..2 {
+            rewriter.write(b"<body><p>1</").unwrap();
+            rewriter.write(b"p></body>").unwrap();
+            rewriter.end_and_reset().unwrap();
+        }
+
+        drop(rewriter);
+
+        assert_eq!(
+            String::from_utf8(output).unwrap(),
+            concat!(
+                "<body><span>x",
+                r#"<body><p class="x">1</p></body>"#,
+                r#"<body><p class="x">1</p></body>"#,
+            )
+        );
+    }
+
+    #[test]
+    fn reset_restores_encoding() {
+        use crate::html_content::TextChunk;
+        use std::cell::RefCell;
+
+        let text = RefCell::new(String::new());
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                document_content_handlers: vec![doc_text!(|t: &mut TextChunk<'_>| {
+                    text.borrow_mut().push_str(t.as_str());
+                    Ok(())
+                })],
+                adjust_charset_on_meta_tag: true,
+                ..Settings::new()
+            },
+            |_: &[u8]| {},
+        );
+
+        rewriter
+            .write(b"<meta charset=\"windows-1251\">\xd5")
+            .unwrap();
+        rewriter.end_and_reset().unwrap();
+
+        // NOTE: the document starts in UTF-8 again and can change the encoding once more.
+        rewriter.write("é".as_bytes()).unwrap();
+        rewriter
+            .write(b"<meta charset=\"windows-1251\">\xd5")
+            .unwrap();
+        rewriter.end().unwrap();
+
+        assert_eq!(*text.borrow(), "ХéХ");
+    }
+
+    #[test]
+    #[should_panic(
+        expected = "Rewriters with document end handlers can't be reused for another document."
+    )]
+    fn reset_with_end_handlers() {
+        let mut output = vec![];
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                document_content_handlers: vec![end!(|end| {
+                    end.append("!", ContentType::Text);
+                    Ok(())
+                })],
+                ..Settings::new()
+            },
+            |c: &[u8]| output.extend_from_slice(c),
+        );
+
+        // NOTE: the end handler can't be invoked at the end of the second document.
+        rewriter.write(b"<div>1</div>").unwrap();
+        rewriter.end_and_reset().unwrap();
+        rewriter.write(b"<div>2</div>").unwrap();
+        rewriter.end().unwrap();
+    }
+
+    #[test]
+    fn whole_text_nodes() {
+        use crate::html_content::TextChunk;
+        use std::borrow::Cow;
+        use std::cell::RefCell;
+
+        let rewrite = |max_size: usize, chunks: &[&str]| {
+            let text_chunks = RefCell::new(vec![]);
+            let mut output = vec![];
+
+            let mut rewriter = HtmlRewriter::new(
+                Settings {
+                    element_content_handlers: vec![(
+                        Cow::Owned("p".parse().unwrap()),
+                        ElementContentHandlers::default()
+                            .text(|t: &mut TextChunk<'_>| {
+                                text_chunks
+                                    .borrow_mut()
+                                    .push((t.as_str().to_owned(), t.last_in_text_node()));
+
+                                let new_text = t.as_str().to_uppercase();
+
+                                t.replace(&new_text, ContentType::Text);
+
+                                Ok(())
+                            })
+                            .whole_text_nodes(max_size),
+                    )],
+                    ..Settings::new()
+                },
+                |c: &[u8]| output.extend_from_slice(c),
+            );
+
+            for chunk in chunks {
+                rewriter.write(chunk.as_bytes()).unwrap();
+            }
+
+            rewriter.end().unwrap();
+
+            (text_chunks.into_inner(), String::from_utf8(output).unwrap())
+        };
+
+        let chunks = ["<p>Hel", "lo w", "orld</p><div>foo</div><p>bar"];
+
+        assert_eq!(
+            rewrite(1024, &chunks),
+            (
+                vec![("Hello world".into(), true), ("bar".into(), true)],
+                "<p>HELLO WORLD</p><div>foo</div><p>BAR".into()
+            )
+        );
+
+        assert_eq!(
+            rewrite(8, &chunks),
+            (
+                vec![
+                    ("Hello w".into(), false),
+                    ("orld".into(), true),
+                    ("bar".into(), true)
+                ],
+                "<p>HELLO WORLD</p><div>foo</div><p>BAR".into()
+            )
+        );
+    }
+
+    #[test]
+    fn text_decoder_buffer_size() {
+        use crate::html_content::TextChunk;
+
+        let mut text_chunks = vec![];
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                document_content_handlers: vec![doc_text!(|t: &mut TextChunk<'_>| {
+                    text_chunks.push(t.as_str().to_owned());
+                    Ok(())
+                })],
+                encoding: AsciiCompatibleEncoding::new(encoding_rs::WINDOWS_1251).unwrap(),
+                text_decoder_buffer_size: 4,
+                ..Settings::new()
+            },
+            |_: &[u8]| {},
+        );
+
+        rewriter.write(b"\xd5\xd5\xd5\xd5\xd5").unwrap();
+        rewriter.end().unwrap();
+
+        drop(rewriter);
+
+        assert!(text_chunks.len() > 2);
+        assert!(text_chunks.iter().all(|c| c.len() <= 4));
+        assert_eq!(text_chunks.concat(), "ХХХХХ");
+    }
+
+    #[test]
+    fn once_handlers() {
+        use crate::html_content::{Element, TextChunk};
+        use std::borrow::Cow;
+        use std::cell::Cell;
+
+        let element_calls = Cell::new(0);
+        let text_calls = Cell::new(0);
+        let mut output = vec![];
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                element_content_handlers: vec![(
+                    Cow::Owned("head".parse().unwrap()),
+                    ElementContentHandlers::default()
+                        .element(|el: &mut Element<'_, '_>| {
+                            element_calls.set(element_calls.get() + 1);
+                            el.prepend("<script></script>", ContentType::Html);
+                            Ok(())
+                        })
+                        .once(),
+                )],
+                document_content_handlers: vec![DocumentContentHandlers::default()
+                    .text(|t: &mut TextChunk<'_>| {
+                        text_calls.set(text_calls.get() + 1);
+                        t.before("[", ContentType::Text);
+                        Ok(())
+                    })
+                    .once()],
+                ..Settings::new()
+            },
+            |c: &[u8]| output.extend_from_slice(c),
+        );
+
+        for _ in 0..2 {
+            rewriter.write(b"foo<html><he").unwrap();
+            rewriter.write(b"ad></head><bo").unwrap();
+            rewriter
+                .write(b"dy><head>bar</head></body></html>")
+                .unwrap();
+            rewriter.end_and_reset().unwrap();
+        }
+
+        drop(rewriter);
+
+        assert_eq!(element_calls.get(), 2);
+        assert_eq!(text_calls.get(), 2);
+
+        assert_eq!(
+            String::from_utf8(output).unwrap(),
+            concat!(
+                "[foo<html><head><script></script></head><body><head>bar</head></body></html>",
+                "[foo<html><head><script></script></head><body><head>bar</head></body></html>",
+            )
+        );
+    }
+
+    #[test]
+    fn disabled_output() {
+        use std::cell::RefCell;
+
+        let links = RefCell::new(vec![]);
+        let text = RefCell::new(String::new());
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                element_content_handlers: vec![
+                    element!("a[href]", |el| {
+                        links.borrow_mut().push(el.get_attribute("href").unwrap());
+                        el.set_attribute("href", "#")?;
+                        Ok(())
+                    }),
+                    text!("a", |t| {
+                        text.borrow_mut().push_str(t.as_str());
+                        t.replace("bar", ContentType::Text);
+                        Ok(())
+                    }),
+                ],
+                document_content_handlers: vec![end!(|end| {
+                    end.append("<!-- end -->", ContentType::Html);
+                    Ok(())
+                })],
+                disable_output: true,
+                ..Settings::new()
+            },
+            |_: &[u8]| panic!("Output sink shouldn't be called"),
+        );
+
+        rewriter.write(b"<div><a href=/foo>f").unwrap();
+        rewriter.write(b"oo</a><a href=/bar></a></div>").unwrap();
+        rewriter.end().unwrap();
+
+        assert_eq!(*links.borrow(), ["/foo", "/bar"]);
+        assert_eq!(*text.borrow(), "foo");
+    }
+
+    #[test]
+    fn remove_raw_text_content() {
+        let html = concat!(
+            "<script>if (a<b && c</d) x = '<!-- </scrip'; </scriptx></script>",
+            "<style>a<b</style><textarea>a</b</TEXTAREA><p>1</p>"
+        );
+
+        for split in 0..=html.len() {
+            let mut output = vec![];
+
+            let mut rewriter = HtmlRewriter::new(
+                Settings {
+                    element_content_handlers: vec![
+                        element!("script, style, textarea", |el| {
+                            el.set_inner_content("x", ContentType::Text);
+                            Ok(())
+                        }),
+                        element!("p", |el| {
+                            el.set_attribute("class", "y")?;
+                            Ok(())
+                        }),
+                    ],
+                    ..Settings::new()
+                },
+                |c: &[u8]| output.extend_from_slice(c),
+            );
+
+            rewriter.write(&html.as_bytes()[..split]).unwrap();
+            rewriter.write(&html.as_bytes()[split..]).unwrap();
+            rewriter.end().unwrap();
+
+            drop(rewriter);
+
+            assert_eq!(
+                String::from_utf8(output).unwrap(),
+                concat!(
+                    "<script>x</script><style>x</style><textarea>x</TEXTAREA>",
+                    r#"<p class="y">1</p>"#
+                ),
+                "split at {split}"
+            );
+        }
+    }
+
+    #[test]
+    fn transcode_input() {
+        let html: Vec<u8> = "<div>héllo</div><p>wörld</p>"
+            .encode_utf16()
+            .flat_map(u16::to_le_bytes)
+            .collect();
+
+        let mut output = vec![];
+
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                element_content_handlers: vec![
+                    element!("div", |el| {
+                        el.set_attribute("lang", "fr")?;
+                        Ok(())
+                    }),
+                    text!("p", |t| {
+                        if t.last_in_text_node() {
+                            t.after("!", ContentType::Text);
+                        }
+
+                        Ok(())
+                    }),
+                ],
+                input_encoding: Some(encoding_rs::UTF_16LE),
+                ..Settings::new()
+            },
+            |c: &[u8]| output.extend_from_slice(c),
+        );
+
+        // NOTE: odd chunk size splits the code units.
+        for chunk in html.chunks(3) {
+            rewriter.write(chunk).unwrap();
+        }
+
+        rewriter.end().unwrap();
+
+        assert_eq!(
+            String::from_utf8(output).unwrap(),
+            r#"<div lang="fr">héllo</div><p>wörld!</p>"#
+        );
+    }
+
+    #[test]
+    #[should_panic(expected = "Transcoded input can only be rewritten in UTF-8")]
+    fn transcode_input_to_non_utf8() {
+        HtmlRewriter::new(
+            Settings {
+                encoding: encoding_rs::WINDOWS_1251.try_into().unwrap(),
+                input_encoding: Some(encoding_rs::UTF_16LE),
+                ..Settings::new()
+            },
+            |_: &[u8]| {},
+        );
+    }
+
     mod fatal_errors {
         use super::*;
         use crate::html_content::Comment;
@@ -789,6 +1527,7 @@ mod tests {
                     memory_settings: MemorySettings {
                         max_allowed_memory_usage,
                         preallocated_parsing_buffer_size: 0,
+                        ..MemorySettings::new()
                     },
                     ..Settings::new()
                 },
@@ -829,6 +1568,142 @@ mod tests {
             rewriter.end().unwrap_err();
         }
 
+        #[test]
+        fn reset_after_fatal_error() {
+            const MAX: usize = 10;
+
+            let mut output = vec![];
+            let mut rewriter = create_rewriter(MAX, |c: &[u8]| output.extend_from_slice(c));
+            let chunk = format!("<img alt=\"{}", "l".repeat(MAX));
+
+            rewriter.write(chunk.as_bytes()).unwrap_err();
+            rewriter.reset();
+
+            // NOTE: memory of the failed allocation shouldn't be accounted.
+            rewriter.write(b"<br").unwrap();
+            rewriter.write(b">").unwrap();
+            rewriter.end().unwrap();
+
+            assert_eq!(output, b"<br>");
+        }
+
+        #[test]
+        fn shared_memory_budget() {
+            const MAX: usize = 100;
+
+            let budget = crate::MemoryBudget::with_credit_block_size(MAX, 16);
+
+            let create_rewriter = || {
+                HtmlRewriter::new(
+                    Settings {
+                        element_content_handlers: vec![element!("*", |_| Ok(()))],
+                        memory_settings: MemorySettings {
+                            preallocated_parsing_buffer_size: 0,
+                            ..MemorySettings::new()
+                        },
+                        memory_budget: Some(budget.clone()),
+                        ..Settings::new()
+                    },
+                    |_: &[u8]| {},
+                )
+            };
+
+            let chunk = format!("<img alt=\"{}", "l".repeat(MAX / 2));
+
+            let mut rewriter_1 = create_rewriter();
+            let mut rewriter_2 = create_rewriter();
+
+            rewriter_1.write(chunk.as_bytes()).unwrap();
+
+            let write_err = rewriter_2.write(chunk.as_bytes()).unwrap_err();
+
+            match write_err {
+                RewritingError::MemoryLimitExceeded(e) => assert_eq!(e, MemoryLimitExceededError),
+                _ => panic!("{}", write_err),
+            }
+
+            drop(rewriter_1);
+            drop(rewriter_2);
+
+            assert_eq!(budget.usage(), 0);
+
+            let mut rewriter = create_rewriter();
+
+            rewriter.write(chunk.as_bytes()).unwrap();
+        }
+
+        #[test]
+        fn admission_control() {
+            let budget = crate::MemoryBudget::with_credit_block_size(100, 0);
+
+            let settings = |max_allowed_memory_usage| Settings {
+                memory_settings: MemorySettings {
+                    preallocated_parsing_buffer_size: 60,
+                    max_allowed_memory_usage,
+                    ..MemorySettings::new()
+                },
+                memory_budget: Some(budget.clone()),
+                ..Settings::new()
+            };
+
+            let rewriter = HtmlRewriter::try_new(settings(usize::MAX), |_: &[u8]| {}).unwrap();
+
+            assert_eq!(budget.usage(), 60);
+
+            let err = HtmlRewriter::try_new(settings(usize::MAX), |_: &[u8]| {}).unwrap_err();
+
+            assert_eq!(err, MemoryLimitExceededError);
+            assert_eq!(budget.usage(), 60);
+
+            drop(rewriter);
+
+            let err = HtmlRewriter::try_new(settings(50), |_: &[u8]| {}).unwrap_err();
+
+            assert_eq!(err, MemoryLimitExceededError);
+            assert_eq!(budget.usage(), 0);
+
+            HtmlRewriter::try_new(settings(usize::MAX), |_: &[u8]| {}).unwrap();
+        }
+
+        #[test]
+        fn adaptive_parsing_buffer_size() {
+            let histogram = crate::BufferSizeHistogram::new(100);
+            let budget = crate::MemoryBudget::with_credit_block_size(usize::MAX, 0);
+
+            let settings = |max_allowed_memory_usage| Settings {
+                element_content_handlers: vec![element!("*", |_| Ok(()))],
+                memory_settings: MemorySettings {
+                    preallocated_parsing_buffer_size: 0,
+                    max_allowed_memory_usage,
+                    ..MemorySettings::new()
+                },
+                memory_budget: Some(budget.clone()),
+                parsing_buffer_histogram: Some(histogram.clone()),
+                ..Settings::new()
+            };
+
+            let mut rewriter = HtmlRewriter::new(settings(usize::MAX), |_: &[u8]| {});
+
+            assert_eq!(budget.usage(), 0);
+
+            rewriter.write(b"<img alt='").unwrap();
+            rewriter.write(b"Hello, world!'>").unwrap();
+            rewriter.end().unwrap();
+
+            assert_eq!(histogram.percentile_size(), Some(32));
+
+            let rewriter = HtmlRewriter::new(settings(usize::MAX), |_: &[u8]| {});
+
+            assert_eq!(budget.usage(), 32);
+
+            drop(rewriter);
+
+            // NOTE: the size from the histogram is capped by the memory limit.
+            let _rewriter = HtmlRewriter::new(settings(16), |_: &[u8]| {});
+
+            assert_eq!(budget.usage(), 16);
+        }
+
         #[test]
         fn content_handler_error_propagation() {
             fn assert_err<'h>(
@@ -1,26 +1,28 @@
-use super::handlers_dispatcher::{ContentHandlersDispatcher, SelectorHandlersLocator};
-use super::{HandlerTypes, RewritingError, Settings};
+use super::handlers_dispatcher::ContentHandlersDispatcher;
+use super::sanitizer::Sanitizer;
+use super::{CharsetAdjustment, HandlerTypes, RewriterTemplate, RewritingError, Settings};
 use crate::base::SharedEncoding;
 use crate::html::{LocalName, Namespace};
 use crate::memory::SharedMemoryLimiter;
 use crate::rewritable_units::{DocumentEnd, Token, TokenCaptureFlags};
-use crate::selectors_vm::Ast;
+use crate::selectors_vm::{Ast, PayloadSet};
 use crate::selectors_vm::{AuxStartTagInfoRequest, ElementData, SelectorMatchingVm, VmError};
+use crate::stats::SharedStats;
 use crate::transform_stream::{DispatcherError, StartTagHandlingResult, TransformController};
-use hashbrown::HashSet;
 
 #[derive(Default)]
 pub(crate) struct ElementDescriptor {
-    pub matched_content_handlers: HashSet<SelectorHandlersLocator>,
+    /// Indices of the selectors that matched the element.
+    pub matched_content_handlers: PayloadSet,
     pub end_tag_handler_idx: Option<usize>,
     pub remove_content: bool,
 }
 
 impl ElementData for ElementDescriptor {
-    type MatchPayload = SelectorHandlersLocator;
+    type MatchPayload = usize;
 
     #[inline]
-    fn matched_payload_mut(&mut self) -> &mut HashSet<SelectorHandlersLocator> {
+    fn matched_payload_mut(&mut self) -> &mut PayloadSet {
         &mut self.matched_content_handlers
     }
 }
@@ -28,6 +30,8 @@ impl ElementData for ElementDescriptor {
 pub(crate) struct HtmlRewriteController<'h, H: HandlerTypes> {
     handlers_dispatcher: ContentHandlersDispatcher<'h, H>,
     selector_matching_vm: Option<SelectorMatchingVm<ElementDescriptor>>,
+    charset_adjustment: Option<CharsetAdjustment>,
+    sanitizer: Option<Sanitizer>,
 }
 
 impl<'h, H: HandlerTypes> HtmlRewriteController<'h, H> {
@@ -36,57 +40,84 @@ impl<'h, H: HandlerTypes> HtmlRewriteController<'h, H> {
     #[inline(never)]
     pub(super) fn from_settings(
         settings: Settings<'h, '_, H>,
+        template: Option<&RewriterTemplate>,
         memory_limiter: &SharedMemoryLimiter,
         encoding: &SharedEncoding,
+        stats: &SharedStats,
     ) -> Self {
         let mut selectors_ast = Ast::default();
-        let mut dispatcher = ContentHandlersDispatcher::<H>::default();
-        let has_selectors =
-            !settings.element_content_handlers.is_empty() || settings.adjust_charset_on_meta_tag;
-
-        let charset_adjust_handler = if settings.adjust_charset_on_meta_tag {
-            let encoding = SharedEncoding::clone(encoding);
-            Some(super::handler_adjust_charset_on_meta_tag(encoding))
-        } else {
-            None
-        };
+        let mut dispatcher = ContentHandlersDispatcher::<H>::with_stats(stats.clone());
+        let has_selectors = settings.has_selectors();
+
+        let charset_adjustment = settings
+            .adjust_charset_on_meta_tag
+            .then(|| CharsetAdjustment::new(SharedEncoding::clone(encoding), settings.encoding));
 
-        let element_content_handlers = charset_adjust_handler
+        let element_content_handlers = charset_adjustment
+            .as_ref()
+            .map(CharsetAdjustment::handlers)
             .into_iter()
             .chain(settings.element_content_handlers);
 
-        for (selector, handlers) in element_content_handlers {
+        for (idx, (selector, handlers)) in element_content_handlers.enumerate() {
             let locator = dispatcher.add_selector_associated_handlers(handlers);
 
-            selectors_ast.add_selector(&selector, locator);
+            match template {
+                // NOTE: the program is already compiled, we just need to make sure that
+                // the handlers end up where the compiled program expects them to be.
+                Some(template) => assert!(
+                    template.handlers_layout()[idx] == locator,
+                    "Settings should have the same handlers as the template."
+                ),
+                None => selectors_ast.add_selector(&selector, idx),
+            }
         }
 
         for handlers in settings.document_content_handlers {
             dispatcher.add_document_content_handlers(handlers);
         }
 
-        let selector_matching_vm = if has_selectors {
-            Some(SelectorMatchingVm::new(
+        let selector_matching_vm = match template {
+            Some(template) => template.program().map(|program| {
+                SelectorMatchingVm::with_program(
+                    program,
+                    memory_limiter.clone(),
+                    settings.enable_esi_tags,
+                    stats.clone(),
+                )
+            }),
+            None if has_selectors => Some(SelectorMatchingVm::new(
                 selectors_ast,
                 settings.encoding.into(),
                 memory_limiter.clone(),
                 settings.enable_esi_tags,
-            ))
-        } else {
-            None
+                stats.clone(),
+            )),
+            None => None,
         };
 
-        Self::new(dispatcher, selector_matching_vm)
+        let sanitizer = settings.sanitizer.map(Sanitizer::new);
+
+        Self::new(
+            dispatcher,
+            selector_matching_vm,
+            charset_adjustment,
+            sanitizer,
+        )
     }
 
     #[inline]
     pub(crate) const fn new(
         handlers_dispatcher: ContentHandlersDispatcher<'h, H>,
         selector_matching_vm: Option<SelectorMatchingVm<ElementDescriptor>>,
+        charset_adjustment: Option<CharsetAdjustment>,
+        sanitizer: Option<Sanitizer>,
     ) -> Self {
         HtmlRewriteController {
             handlers_dispatcher,
             selector_matching_vm,
+            charset_adjustment,
+            sanitizer,
         }
     }
 }
@@ -94,7 +125,7 @@ impl<'h, H: HandlerTypes> HtmlRewriteController<'h, H> {
 impl<H: HandlerTypes> HtmlRewriteController<'_, H> {
     #[inline]
     fn respond_to_aux_info_request(
-        aux_info_req: AuxStartTagInfoRequest<ElementDescriptor, SelectorHandlersLocator>,
+        aux_info_req: AuxStartTagInfoRequest<ElementDescriptor, usize>,
     ) -> StartTagHandlingResult<Self> {
         Err(DispatcherError::InfoRequest(Box::new(
             move |this, aux_info| {
@@ -112,7 +143,12 @@ impl<H: HandlerTypes> HtmlRewriteController<'_, H> {
 
     #[inline]
     fn get_capture_flags(&self) -> TokenCaptureFlags {
-        self.handlers_dispatcher.get_token_capture_flags()
+        let flags = self.handlers_dispatcher.get_token_capture_flags();
+
+        match self.sanitizer {
+            Some(ref sanitizer) => flags | sanitizer.capture_flags(),
+            None => flags,
+        }
     }
 }
 
@@ -127,6 +163,10 @@ impl<H: HandlerTypes> TransformController for HtmlRewriteController<'_, H> {
         local_name: LocalName<'_>,
         ns: Namespace,
     ) -> StartTagHandlingResult<Self> {
+        if let Some(ref mut sanitizer) = self.sanitizer {
+            sanitizer.handle_start_tag(&local_name, ns);
+        }
+
         match self.selector_matching_vm {
             Some(ref mut vm) => {
                 let mut match_handler = |m| self.handlers_dispatcher.start_matching(&m);
@@ -145,7 +185,11 @@ impl<H: HandlerTypes> TransformController for HtmlRewriteController<'_, H> {
         }
     }
 
-    fn handle_end_tag(&mut self, local_name: LocalName<'_>) -> TokenCaptureFlags {
+    fn handle_end_tag(&mut self, local_name: LocalName<'_>, ns: Namespace) -> TokenCaptureFlags {
+        if let Some(ref mut sanitizer) = self.sanitizer {
+            sanitizer.handle_end_tag(&local_name, ns);
+        }
+
         if let Some(ref mut vm) = self.selector_matching_vm {
             vm.exec_for_end_tag(local_name, |elem_desc| {
                 self.handlers_dispatcher.stop_matching(elem_desc);
@@ -164,7 +208,16 @@ impl<H: HandlerTypes> TransformController for HtmlRewriteController<'_, H> {
 
         self.handlers_dispatcher
             .handle_token(token, current_element_data)
-            .map_err(RewritingError::ContentHandlerError)
+            .map_err(RewritingError::ContentHandlerError)?;
+
+        // NOTE: the sanitizer runs after the handlers, so that the changes they make to the
+        // token are subject to the policy as well. Content inserted by the handlers is not
+        // tokenized and bypasses the sanitizer.
+        if let Some(ref mut sanitizer) = self.sanitizer {
+            sanitizer.handle_token(token);
+        }
+
+        Ok(())
     }
 
     fn handle_end(&mut self, document_end: &mut DocumentEnd<'_>) -> Result<(), RewritingError> {
@@ -173,10 +226,40 @@ impl<H: HandlerTypes> TransformController for HtmlRewriteController<'_, H> {
             .map_err(RewritingError::ContentHandlerError)
     }
 
+    #[inline]
+    fn whole_text_node_limit(&self) -> Option<usize> {
+        self.handlers_dispatcher.whole_text_node_limit()
+    }
+
+    #[inline]
+    fn is_exhausted(&self) -> bool {
+        self.sanitizer.is_none() && self.handlers_dispatcher.is_exhausted()
+    }
+
     #[inline]
     fn should_emit_content(&self) -> bool {
         !self
             .handlers_dispatcher
             .has_matched_elements_with_removed_content()
+            && !self
+                .sanitizer
+                .as_ref()
+                .is_some_and(Sanitizer::is_removing_content)
+    }
+
+    fn reset(&mut self) {
+        self.handlers_dispatcher.reset();
+
+        if let Some(ref mut vm) = self.selector_matching_vm {
+            vm.reset();
+        }
+
+        if let Some(ref charset_adjustment) = self.charset_adjustment {
+            charset_adjustment.reset();
+        }
+
+        if let Some(ref mut sanitizer) = self.sanitizer {
+            sanitizer.reset();
+        }
     }
 }
@@ -0,0 +1,220 @@
+use super::settings::HandlerTypes;
+use crate::rewritable_units::{AttributeNameError, ContentType, Element};
+
+/// A fixed modification of the elements matched by a selector.
+///
+/// Unlike a handler, a rule is applied natively by the rewriter, so for the bindings to other
+/// languages it saves a crossing of the language boundary on each matched element. Rules are
+/// attached to a selector with [`ElementContentHandlers::rules`].
+///
+/// # Example
+/// ```
+/// use lol_html::{rewrite_str, ElementContentHandlers, RewriteRule, RewriteStrSettings};
+/// use std::borrow::Cow;
+///
+/// let html = rewrite_str(
+///     r#"<a href="http://example.com">"#,
+///     RewriteStrSettings {
+///         element_content_handlers: vec![(
+///             Cow::Owned("a[href]".parse().unwrap()),
+///             ElementContentHandlers::default().rules(vec![
+///                 RewriteRule::ReplaceAttributePrefix {
+///                     name: "href".into(),
+///                     prefix: "http:".into(),
+///                     replacement: "https:".into(),
+///                 },
+///                 RewriteRule::SetAttribute {
+///                     name: "rel".into(),
+///                     value: "noopener".into(),
+///                 },
+///             ]),
+///         )],
+///         ..RewriteStrSettings::new()
+///     },
+/// )
+/// .unwrap();
+///
+/// assert_eq!(html, r#"<a href="https://example.com" rel="noopener">"#);
+/// ```
+///
+/// [`ElementContentHandlers::rules`]: struct.ElementContentHandlers.html#method.rules
+#[derive(Clone, Debug)]
+pub enum RewriteRule {
+    /// Sets the value of the attribute, adding the attribute if it doesn't exist.
+    SetAttribute {
+        /// The name of the attribute.
+        name: String,
+        /// The new value of the attribute.
+        value: String,
+    },
+
+    /// Removes the attribute.
+    RemoveAttribute {
+        /// The name of the attribute.
+        name: String,
+    },
+
+    /// Replaces the `prefix` of the attribute value with the `replacement`. The attribute is left
+    /// intact if it doesn't exist or its value doesn't start with the `prefix`.
+    ReplaceAttributePrefix {
+        /// The name of the attribute.
+        name: String,
+        /// The prefix of the attribute value to replace.
+        prefix: String,
+        /// The replacement of the prefix.
+        replacement: String,
+    },
+
+    /// Inserts the content before the element.
+    InsertBefore {
+        /// The inserted content.
+        content: String,
+        /// The type of the inserted content.
+        content_type: ContentType,
+    },
+
+    /// Inserts the content after the element.
+    InsertAfter {
+        /// The inserted content.
+        content: String,
+        /// The type of the inserted content.
+        content_type: ContentType,
+    },
+
+    /// Removes the element with its content.
+    Remove,
+}
+
+impl RewriteRule {
+    /// Applies the rule to the `element`.
+    pub fn apply<H: HandlerTypes>(
+        &self,
+        element: &mut Element<'_, '_, H>,
+    ) -> Result<(), AttributeNameError> {
+        match self {
+            Self::SetAttribute { name, value } => element.set_attribute(name, value)?,
+            Self::RemoveAttribute { name } => element.remove_attribute(name),
+            Self::ReplaceAttributePrefix {
+                name,
+                prefix,
+                replacement,
+            } => {
+                if let Some(value) = element.get_attribute(name) {
+                    if let Some(rest) = value.strip_prefix(prefix.as_str()) {
+                        element.set_attribute(name, &format!("{replacement}{rest}"))?;
+                    }
+                }
+            }
+            Self::InsertBefore {
+                content,
+                content_type,
+            } => element.before(content, *content_type),
+            Self::InsertAfter {
+                content,
+                content_type,
+            } => element.after(content, *content_type),
+            Self::Remove => element.remove(),
+        }
+
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{rewrite_str, ElementContentHandlers, RewriteStrSettings};
+    use std::borrow::Cow;
+
+    fn rewrite(html: &str, selector: &str, rules: &[RewriteRule]) -> String {
+        rewrite_str(
+            html,
+            RewriteStrSettings {
+                element_content_handlers: vec![(
+                    Cow::Owned(selector.parse().unwrap()),
+                    ElementContentHandlers::default().rules(rules),
+                )],
+                ..RewriteStrSettings::new()
+            },
+        )
+        .unwrap()
+    }
+
+    #[test]
+    fn attribute_rules() {
+        let rules = [
+            RewriteRule::ReplaceAttributePrefix {
+                name: "src".into(),
+                prefix: "http:".into(),
+                replacement: "https:".into(),
+            },
+            RewriteRule::SetAttribute {
+                name: "loading".into(),
+                value: "lazy".into(),
+            },
+            RewriteRule::RemoveAttribute {
+                name: "width".into(),
+            },
+        ];
+
+        assert_eq!(
+            rewrite(
+                r#"<img src="http://a/1.png" width=1><img src="/2.png"><img>"#,
+                "img",
+                &rules
+            ),
+            concat!(
+                r#"<img src="https://a/1.png" loading="lazy">"#,
+                r#"<img src="/2.png" loading="lazy"><img loading="lazy">"#
+            )
+        );
+
+        let err = rewrite_str(
+            "<div>",
+            RewriteStrSettings {
+                element_content_handlers: vec![(
+                    Cow::Owned("div".parse().unwrap()),
+                    ElementContentHandlers::default().rules(vec![RewriteRule::SetAttribute {
+                        name: "foo bar".into(),
+                        value: String::new(),
+                    }]),
+                )],
+                ..RewriteStrSettings::new()
+            },
+        )
+        .unwrap_err();
+
+        assert_eq!(
+            err.to_string(),
+            AttributeNameError::ForbiddenCharacter(' ').to_string()
+        );
+    }
+
+    #[test]
+    fn content_rules() {
+        let rules = [
+            RewriteRule::InsertBefore {
+                content: "<hr>".into(),
+                content_type: ContentType::Html,
+            },
+            RewriteRule::InsertAfter {
+                content: "<hr>".into(),
+                content_type: ContentType::Text,
+            },
+        ];
+
+        assert_eq!(
+            rewrite("<div><p>1</p></div>", "p", &rules),
+            "<div><hr><p>1</p>&lt;hr&gt;</div>"
+        );
+
+        assert_eq!(
+            rewrite(
+                "<div><script>foo</script>bar</div>",
+                "script",
+                &[RewriteRule::Remove]
+            ),
+            "<div>bar</div>"
+        );
+    }
+}
@@ -0,0 +1,849 @@
+use crate::html::{LocalName, LocalNameHash, Namespace, Tag, TextType};
+use crate::parser;
+use crate::rewritable_units::{Attribute, ContentType, Token, TokenCaptureFlags};
+use hashbrown::HashSet;
+
+// NOTE: longer schemes are never allowed.
+const MAX_URL_SCHEME_LEN: usize = 32;
+
+#[inline]
+fn hash_name(name: &[u8]) -> LocalNameHash {
+    let mut hash = LocalNameHash::new();
+
+    for &ch in name {
+        hash.update(ch);
+    }
+
+    hash
+}
+
+/// A set of tag or attribute names that can be checked without allocating.
+#[derive(Clone, Default, Debug)]
+struct NameSet {
+    hashes: HashSet<LocalNameHash>,
+    // NOTE: names that can't be represented by a hash, e.g. names of custom elements.
+    names: Vec<Box<[u8]>>,
+}
+
+impl NameSet {
+    fn add(&mut self, name: &str) {
+        let hash = LocalNameHash::from(name);
+
+        if hash.is_empty() {
+            self.names
+                .push(name.to_ascii_lowercase().into_bytes().into_boxed_slice());
+        } else {
+            self.hashes.insert(hash);
+        }
+    }
+
+    #[inline]
+    fn contains_bytes(&self, name: &[u8]) -> bool {
+        self.names.iter().any(|n| n.eq_ignore_ascii_case(name))
+    }
+
+    #[inline]
+    fn contains(&self, name: &[u8]) -> bool {
+        let hash = hash_name(name);
+
+        if hash.is_empty() {
+            self.contains_bytes(name)
+        } else {
+            self.hashes.contains(&hash)
+        }
+    }
+
+    #[inline]
+    fn contains_local_name(&self, name: &LocalName<'_>) -> bool {
+        match name {
+            LocalName::Hash(hash) => self.hashes.contains(hash),
+            LocalName::Bytes(bytes) => self.contains_bytes(bytes),
+        }
+    }
+}
+
+/// An allowlist policy of the built-in HTML sanitizer. See [`Settings::sanitizer`].
+///
+/// Elements that are not allowed are removed with their start and end tags, but their content
+/// is kept. The content of the elements that are parsed as text, like `script`, `style` or
+/// `textarea`, is always removed with such elements, since it could turn into markup
+/// otherwise. Attributes that are not allowed are removed from the allowed elements.
+///
+/// The `svg` and `math` elements change how their content is parsed, so their content is
+/// sanitized as it would be parsed in the output. If the `svg` or `math` element around them
+/// is not allowed, the content of the CDATA sections is escaped, and the elements that are
+/// parsed as text in HTML, like `style`, are removed with their content even if they are
+/// allowed. If a tag that is not allowed moves the parser in or out of an allowed `svg` or
+/// `math` element, the content is removed until the parser is back in the namespace of the
+/// output.
+///
+/// The names are compared ignoring ASCII case.
+///
+/// # Example
+/// ```
+/// use lol_html::{HtmlRewriter, SanitizerPolicy, Settings};
+///
+/// let mut output = vec![];
+///
+/// let mut rewriter = HtmlRewriter::new(
+///     Settings {
+///         sanitizer: Some(
+///             SanitizerPolicy::new()
+///                 .allow_elements(&["p", "a", "b"])
+///                 .allow_attributes(&["href", "title"])
+///                 .allow_url_schemes(&["http", "https"]),
+///         ),
+///         ..Settings::new()
+///     },
+///     |c: &[u8]| output.extend_from_slice(c),
+/// );
+///
+/// rewriter
+///     .write(br#"<p onclick="f()"><a href="javascript:f()">1</a><script>f()</script>"#)
+///     .unwrap();
+/// rewriter
+///     .write(br#"<i><a href="https://example.com" title="2">2</a></i><!-- 3 --></p>"#)
+///     .unwrap();
+/// rewriter.end().unwrap();
+///
+/// assert_eq!(
+///     String::from_utf8(output).unwrap(),
+///     r#"<p><a>1</a><a href="https://example.com" title="2">2</a></p>"#
+/// );
+/// ```
+///
+/// [`Settings::sanitizer`]: struct.Settings.html#structfield.sanitizer
+#[derive(Clone, Debug)]
+pub struct SanitizerPolicy {
+    elements: NameSet,
+    attributes: NameSet,
+    url_attributes: NameSet,
+    url_schemes: Vec<Box<[u8]>>,
+    removed_content: NameSet,
+    allow_comments: bool,
+}
+
+impl SanitizerPolicy {
+    /// Creates a policy that doesn't allow anything.
+    ///
+    /// `href`, `src`, `action`, `formaction`, `cite`, `poster`, `background` and `xlink:href`
+    /// attributes are treated as URLs.
+    #[must_use]
+    pub fn new() -> Self {
+        let policy = Self {
+            elements: NameSet::default(),
+            attributes: NameSet::default(),
+            url_attributes: NameSet::default(),
+            url_schemes: Vec::new(),
+            removed_content: NameSet::default(),
+            allow_comments: false,
+        };
+
+        policy.url_attributes(&[
+            "href",
+            "src",
+            "action",
+            "formaction",
+            "cite",
+            "poster",
+            "background",
+            "xlink:href",
+        ])
+    }
+
+    /// Allows the elements with the given tag names.
+    #[must_use]
+    pub fn allow_elements(mut self, names: &[&str]) -> Self {
+        for name in names {
+            self.elements.add(name);
+        }
+
+        self
+    }
+
+    /// Allows the attributes with the given names on all of the allowed elements.
+    #[must_use]
+    pub fn allow_attributes(mut self, names: &[&str]) -> Self {
+        for name in names {
+            self.attributes.add(name);
+        }
+
+        self
+    }
+
+    /// Makes the sanitizer treat the values of the attributes with the given names as URLs.
+    ///
+    /// Allowed URL attributes are only kept if they contain a relative URL or a URL with one of
+    /// the [allowed schemes](Self::allow_url_schemes).
+    #[must_use]
+    pub fn url_attributes(mut self, names: &[&str]) -> Self {
+        for name in names {
+            self.url_attributes.add(name);
+        }
+
+        self
+    }
+
+    /// Allows URLs with the given schemes, e.g. `https` or `mailto`, in the URL attributes.
+    #[must_use]
+    pub fn allow_url_schemes(mut self, schemes: &[&str]) -> Self {
+        for scheme in schemes {
+            self.url_schemes
+                .push(scheme.to_ascii_lowercase().into_bytes().into_boxed_slice());
+        }
+
+        self
+    }
+
+    /// Makes the sanitizer remove the content of the elements with the given tag names, if
+    /// the elements are not allowed.
+    #[must_use]
+    pub fn remove_content_of(mut self, names: &[&str]) -> Self {
+        for name in names {
+            self.removed_content.add(name);
+        }
+
+        self
+    }
+
+    /// Allows HTML comments.
+    #[must_use]
+    pub fn allow_comments(mut self) -> Self {
+        self.allow_comments = true;
+
+        self
+    }
+
+    #[inline]
+    fn removes_content_of(&self, name: &LocalName<'_>) -> bool {
+        is_parsed_as_text(name) || self.removed_content.contains_local_name(name)
+    }
+
+    fn is_url_allowed(&self, value: &[u8]) -> bool {
+        let mut scheme = [0; MAX_URL_SCHEME_LEN];
+        let mut scheme_len = 0;
+
+        // NOTE: browsers ignore leading spaces and control characters, as well as tabs and
+        // newlines anywhere in the URL.
+        for &ch in value.iter().skip_while(|&&ch| ch <= b' ') {
+            match ch {
+                b'\t' | b'\n' | b'\r' => continue,
+                b':' => {
+                    let scheme = &scheme[..scheme_len];
+
+                    return !scheme.is_empty() && self.url_schemes.iter().any(|s| **s == *scheme);
+                }
+                // NOTE: a character reference can hide the scheme.
+                b'&' => return false,
+                b'a'..=b'z' | b'A'..=b'Z' => (),
+                b'0'..=b'9' | b'+' | b'-' | b'.' if scheme_len > 0 => (),
+                // NOTE: the URL is relative.
+                _ => return true,
+            }
+
+            if scheme_len == MAX_URL_SCHEME_LEN {
+                return false;
+            }
+
+            scheme[scheme_len] = ch.to_ascii_lowercase();
+            scheme_len += 1;
+        }
+
+        true
+    }
+
+    #[inline]
+    fn is_attribute_allowed(&self, attr: &Attribute<'_>) -> bool {
+        let name = attr.name_bytes();
+
+        self.attributes.contains(name)
+            && (!self.url_attributes.contains(name) || self.is_url_allowed(attr.value_bytes()))
+    }
+}
+
+impl Default for SanitizerPolicy {
+    #[inline]
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// The changes made by a start tag in foreign content. Self-closing tags are only known after
+/// the start tag is handled, and they don't have end tags in foreign content, so the changes
+/// need to be reverted for them.
+#[derive(Default, Clone, Copy)]
+struct ForeignStartTag {
+    opened_removed_content: bool,
+    opened_kept_foreign_root: bool,
+}
+
+// NOTE: the change of the depth of the parser's namespace stack that can't be determined from
+// the namespaces. The foreign content removed after it is removed until the end of the document.
+const UNKNOWN_NS_DEPTH_CHANGE: isize = isize::MIN;
+
+/// The content removed after a tag that is not in the output has moved the parser in or out of
+/// foreign content inside of an allowed `svg` or `math` element. The output doesn't follow the
+/// parser, so the content would be parsed differently there.
+#[derive(Clone, Copy)]
+struct ForeignContentRemoval {
+    // NOTE: the depth of the parser's namespace stack relative to the output and the lowest
+    // depth since the removal has started.
+    depth: isize,
+    min_depth: isize,
+    // NOTE: the namespace of the allowed element that the output is in, if it's not in HTML
+    // content.
+    output_root_ns: Option<Namespace>,
+}
+
+impl ForeignContentRemoval {
+    #[inline]
+    fn new(ns_depth_change: isize, output_root_ns: Option<Namespace>) -> Self {
+        Self {
+            depth: ns_depth_change,
+            min_depth: ns_depth_change.min(0),
+            output_root_ns,
+        }
+    }
+
+    #[inline]
+    fn update(&mut self, ns_depth_change: isize) {
+        self.depth = self.depth.saturating_add(ns_depth_change);
+        self.min_depth = self.min_depth.min(self.depth);
+    }
+
+    /// Returns `true` if the parser is back in the namespace of the output, and the namespaces
+    /// below it haven't changed.
+    #[inline]
+    const fn is_in_output_ns(&self) -> bool {
+        self.depth == 0 && self.min_depth == 0
+    }
+
+    /// Returns `true` if the end tag closes the allowed element the output is in, after the
+    /// parser has left it.
+    #[inline]
+    fn is_closed_by(&self, name: &LocalName<'_>) -> bool {
+        let closes_root = match self.output_root_ns {
+            Some(Namespace::Svg) => *name == Tag::Svg,
+            Some(Namespace::MathML) => *name == Tag::Math,
+            _ => false,
+        };
+
+        closes_root && self.depth == -1 && self.min_depth == -1
+    }
+}
+
+#[inline]
+fn is_foreign_root(name: &LocalName<'_>) -> bool {
+    tag_is_one_of!(*name, [Svg, Math])
+}
+
+#[inline]
+fn is_parsed_as_text(name: &LocalName<'_>) -> bool {
+    tag_is_one_of!(
+        *name,
+        [Script, Style, Textarea, Title, Xmp, Iframe, Noembed, Noframes, Noscript, Plaintext]
+    )
+}
+
+#[inline]
+fn causes_foreign_content_exit(name: &LocalName<'_>) -> bool {
+    match name {
+        LocalName::Hash(hash) => parser::causes_foreign_content_exit(*hash),
+        LocalName::Bytes(_) => false,
+    }
+}
+
+/// Returns the change of the depth of the parser's namespace stack caused by a tag, given the
+/// namespaces of the parser before and after the tag. See `TreeBuilderSimulator` for the rules.
+fn ns_depth_change(
+    name: &LocalName<'_>,
+    is_end_tag: bool,
+    ns_before: Namespace,
+    ns: Namespace,
+) -> isize {
+    use Namespace::{Html, MathML, Svg};
+
+    match (is_end_tag, ns_before) {
+        // NOTE: the end of an integration point.
+        (true, Html) if ns != Html => -1,
+        (true, Svg) if tag_is_one_of!(*name, [Svg, P, Br]) => -1,
+        (true, MathML) if tag_is_one_of!(*name, [Math, P, Br]) => -1,
+        (true, _) => 0,
+        (false, _) if is_foreign_root(name) => 1,
+        (false, Html) => 0,
+        (false, _) if causes_foreign_content_exit(name) => -1,
+        // NOTE: `font` exits foreign content if it has some of the attributes, which doesn't
+        // change the namespace if the parser is in nested foreign content.
+        (false, _) if *name == Tag::Font && ns == ns_before => UNKNOWN_NS_DEPTH_CHANGE,
+        (false, _) if *name == Tag::Font => -1,
+        // NOTE: the start of an integration point.
+        (false, _) if ns == Html => 1,
+        (false, _) => 0,
+    }
+}
+
+/// Applies a [`SanitizerPolicy`] to the tokens of the document.
+pub(crate) struct Sanitizer {
+    policy: SanitizerPolicy,
+    // NOTE: the element which content is being removed and the number of open elements with
+    // the same name in its content.
+    removed_content: Option<(LocalName<'static>, usize)>,
+    foreign_content_removal: Option<ForeignContentRemoval>,
+    // NOTE: the namespace of the parser after the last tag.
+    ns: Namespace,
+    // NOTE: the `svg` and `math` elements that the parser is in, and whether the output is in
+    // each of them as well.
+    foreign_roots: Vec<bool>,
+    // NOTE: the number of the elements above that the output is not in.
+    removed_foreign_roots: usize,
+    // NOTE: the number of the open `svg` and `math` elements in the output.
+    kept_foreign_roots: usize,
+    foreign_start_tag: Option<ForeignStartTag>,
+    // NOTE: the last tag is removed even if the element is allowed.
+    remove_tag: bool,
+}
+
+impl Sanitizer {
+    #[inline]
+    #[must_use]
+    pub const fn new(policy: SanitizerPolicy) -> Self {
+        Self {
+            policy,
+            removed_content: None,
+            foreign_content_removal: None,
+            ns: Namespace::Html,
+            foreign_roots: Vec::new(),
+            removed_foreign_roots: 0,
+            kept_foreign_roots: 0,
+            foreign_start_tag: None,
+            remove_tag: false,
+        }
+    }
+
+    #[inline]
+    pub fn capture_flags(&self) -> TokenCaptureFlags {
+        let mut flags = TokenCaptureFlags::NEXT_START_TAG | TokenCaptureFlags::NEXT_END_TAG;
+
+        if !self.policy.allow_comments {
+            flags |= TokenCaptureFlags::COMMENTS;
+        }
+
+        if self.removed_foreign_roots > 0 {
+            flags |= TokenCaptureFlags::TEXT;
+        }
+
+        flags
+    }
+
+    #[inline]
+    pub const fn is_removing_content(&self) -> bool {
+        self.removed_content.is_some() || self.foreign_content_removal.is_some()
+    }
+
+    pub fn handle_start_tag(&mut self, name: &LocalName<'_>, ns: Namespace) {
+        let ns_before = std::mem::replace(&mut self.ns, ns);
+        let ns_depth_change = ns_depth_change(name, false, ns_before, ns);
+        let is_allowed = self.policy.elements.contains_local_name(name);
+        let mut changes = ForeignStartTag::default();
+
+        self.remove_tag = false;
+
+        match self.removed_content {
+            Some((ref removed, ref mut depth)) => {
+                if removed == name {
+                    *depth += 1;
+                    changes.opened_removed_content = true;
+                }
+            }
+            None if self.foreign_content_removal.is_some() => (),
+            None => {
+                let removes_content = if is_allowed {
+                    // NOTE: without the `svg` or `math` element around them, these elements
+                    // would be parsed as text in the output.
+                    self.removed_foreign_roots > 0 && is_parsed_as_text(name)
+                } else {
+                    self.policy.removes_content_of(name)
+                };
+
+                if removes_content {
+                    self.removed_content = Some((name.clone().into_owned(), 0));
+                    self.remove_tag = true;
+                    changes.opened_removed_content = true;
+                }
+            }
+        }
+
+        let is_in_output = is_allowed && !self.remove_tag && !self.is_removing_content();
+
+        self.handle_ns_depth_change(name, is_in_output, ns_before, ns_depth_change);
+
+        if is_foreign_root(name) {
+            let is_kept = is_allowed && !self.is_removing_content();
+
+            self.foreign_roots.push(is_kept);
+
+            if is_kept {
+                self.kept_foreign_roots += 1;
+                changes.opened_kept_foreign_root = true;
+            } else {
+                self.removed_foreign_roots += 1;
+            }
+        }
+
+        // NOTE: the self-closing syntax is ignored in HTML content.
+        self.foreign_start_tag = (ns != Namespace::Html).then_some(changes);
+    }
+
+    fn close_self_closing_tag(&mut self, changes: ForeignStartTag) {
+        if changes.opened_removed_content {
+            match self.removed_content {
+                Some((_, ref mut depth)) if *depth > 0 => *depth -= 1,
+                _ => self.removed_content = None,
+            }
+        }
+
+        // NOTE: the parser doesn't leave self-closing `svg` and `math` elements, unlike the
+        // output.
+        if changes.opened_kept_foreign_root {
+            if let Some(is_kept) = self.foreign_roots.last_mut() {
+                *is_kept = false;
+            }
+
+            self.kept_foreign_roots -= 1;
+            self.removed_foreign_roots += 1;
+        }
+    }
+
+    pub fn handle_end_tag(&mut self, name: &LocalName<'_>, ns: Namespace) {
+        let ns_before = std::mem::replace(&mut self.ns, ns);
+        let ns_depth_change = ns_depth_change(name, true, ns_before, ns);
+        let is_allowed = self.policy.elements.contains_local_name(name);
+
+        self.remove_tag = false;
+
+        let closes_removed_element = match self.removed_content {
+            Some((ref removed, ref mut depth)) if removed == name => {
+                if *depth == 0 {
+                    true
+                } else {
+                    *depth -= 1;
+                    false
+                }
+            }
+            _ => false,
+        };
+
+        if closes_removed_element {
+            self.removed_content = None;
+            self.remove_tag = true;
+        }
+
+        // NOTE: the end tag of an `svg` or `math` element is only kept if it closes the element
+        // in the output, otherwise it could close a different element there.
+        if is_foreign_root(name)
+            && !(ns_depth_change == -1 && self.foreign_roots.last() == Some(&true))
+        {
+            self.remove_tag = true;
+        }
+
+        let is_in_output = is_allowed && !self.remove_tag && !self.is_removing_content();
+
+        self.handle_ns_depth_change(name, is_in_output, ns_before, ns_depth_change);
+
+        if let Some(removal) = self.foreign_content_removal {
+            if removal.is_in_output_ns() {
+                self.foreign_content_removal = None;
+                self.remove_tag = true;
+            } else if is_allowed && removal.is_closed_by(name) {
+                // NOTE: the end tag closes the element in the output, so that it's not in
+                // foreign content either.
+                self.foreign_content_removal = None;
+                self.removed_content = None;
+                self.kept_foreign_roots -= 1;
+                self.remove_tag = false;
+            }
+        }
+    }
+
+    /// Keeps track of the parser's namespace stack. If the tag that changes it is not in the
+    /// output, the content is removed until the output and the parser are in the same namespace.
+    fn handle_ns_depth_change(
+        &mut self,
+        name: &LocalName<'_>,
+        is_in_output: bool,
+        ns_before: Namespace,
+        ns_depth_change: isize,
+    ) {
+        if ns_depth_change == 0 {
+            return;
+        }
+
+        if let Some(ref mut removal) = self.foreign_content_removal {
+            removal.update(ns_depth_change);
+        } else if self.kept_foreign_roots > 0
+            && (self.removed_content.is_some() || !is_in_output && !is_foreign_root(name))
+        {
+            // NOTE: `svg` and `math` elements that are not in the output are handled as the
+            // removed foreign roots.
+            let output_root_ns = (ns_before != Namespace::Html
+                && self.foreign_roots.last() == Some(&true))
+            .then_some(ns_before);
+
+            self.foreign_content_removal =
+                Some(ForeignContentRemoval::new(ns_depth_change, output_root_ns));
+        }
+
+        if ns_depth_change == -1 && ns_before != Namespace::Html {
+            match self.foreign_roots.pop() {
+                Some(true) if is_in_output => self.kept_foreign_roots -= 1,
+                Some(false) => self.removed_foreign_roots -= 1,
+                _ => (),
+            }
+        }
+    }
+
+    pub fn handle_token(&mut self, token: &mut Token<'_>) {
+        match token {
+            Token::StartTag(tag) => {
+                if let Some(changes) = self.foreign_start_tag.take() {
+                    if tag.self_closing() {
+                        self.close_self_closing_tag(changes);
+                    }
+                }
+
+                if !self.remove_tag && self.policy.elements.contains(tag.name_bytes()) {
+                    tag.retain_attributes(|attr| self.policy.is_attribute_allowed(attr));
+                } else {
+                    tag.remove();
+                }
+            }
+            Token::EndTag(tag) => {
+                if self.remove_tag || !self.policy.elements.contains(tag.name_bytes()) {
+                    tag.remove();
+                }
+            }
+            Token::Comment(comment) if !self.policy.allow_comments => comment.remove(),
+            // NOTE: the CDATA section delimiters are not tokens and can't be removed, but with
+            // the escaped content the section is parsed as a bogus comment in HTML.
+            Token::TextChunk(chunk)
+                if self.removed_foreign_roots > 0
+                    && chunk.text_type() == TextType::CDataSection
+                    && !chunk.removed() =>
+            {
+                let text = chunk.as_str().to_owned();
+
+                chunk.replace(&text, ContentType::Text);
+            }
+            _ => (),
+        }
+    }
+
+    #[inline]
+    pub fn reset(&mut self) {
+        self.removed_content = None;
+        self.foreign_content_removal = None;
+        self.ns = Namespace::Html;
+        self.foreign_roots.clear();
+        self.removed_foreign_roots = 0;
+        self.kept_foreign_roots = 0;
+        self.foreign_start_tag = None;
+        self.remove_tag = false;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{HtmlRewriter, Settings};
+
+    fn sanitize(html: &str, policy: SanitizerPolicy) -> String {
+        let mut result = None;
+
+        // NOTE: check every split point of the input.
+        for split in 0..=html.len() {
+            let mut output = vec![];
+
+            let mut rewriter = HtmlRewriter::new(
+                Settings {
+                    sanitizer: Some(policy.clone()),
+                    ..Settings::new()
+                },
+                |c: &[u8]| output.extend_from_slice(c),
+            );
+
+            rewriter.write(&html.as_bytes()[..split]).unwrap();
+            rewriter.write(&html.as_bytes()[split..]).unwrap();
+            rewriter.end().unwrap();
+            drop(rewriter);
+
+            let output = String::from_utf8(output).unwrap();
+
+            match result {
+                Some(ref result) => assert_eq!(*result, output, "split at {split}"),
+                None => result = Some(output),
+            }
+        }
+
+        result.unwrap()
+    }
+
+    #[test]
+    fn elements() {
+        let policy = SanitizerPolicy::new().allow_elements(&["div", "p", "my-element"]);
+
+        assert_eq!(
+            sanitize(
+                "<div><P>1<B>2</b></p><span><my-element>3</my-element></span></div>",
+                policy.clone()
+            ),
+            "<div><P>12</p><my-element>3</my-element></div>"
+        );
+
+        assert_eq!(
+            sanitize(
+                concat!(
+                    "<div><script>if (a<b) x = '</div>'</script><style>p {}</style>",
+                    "<xmp><img src=x onerror=f()></xmp><textarea></textarea>1</div>"
+                ),
+                policy.clone()
+            ),
+            "<div>1</div>"
+        );
+
+        assert_eq!(
+            sanitize(
+                "<object><object></object><p>1</p></object><p>2</p>",
+                policy.remove_content_of(&["object"])
+            ),
+            "<p>2</p>"
+        );
+    }
+
+    #[test]
+    fn attributes() {
+        let policy = SanitizerPolicy::new()
+            .allow_elements(&["a", "img"])
+            .allow_attributes(&["href", "src", "alt", "data-id"])
+            .allow_url_schemes(&["https", "mailto"]);
+
+        assert_eq!(
+            sanitize(
+                concat!(
+                    r#"<a href="/foo" onclick="f()" data-id=1 data-foo=2>1</a>"#,
+                    r#"<a HREF=" JavaScript:f()">2</a><a href="java&#x09;script:f()">3</a>"#,
+                    "<a href=\"java\tscript:f()\">4</a><a href=\"mailto:a@example.com\">5</a>",
+                    r#"<img src="https://example.com/a.png" alt="?">"#
+                ),
+                policy
+            ),
+            concat!(
+                r#"<a href="/foo" data-id=1>1</a><a>2</a><a>3</a><a>4</a>"#,
+                r#"<a href="mailto:a@example.com">5</a>"#,
+                r#"<img src="https://example.com/a.png" alt="?">"#
+            )
+        );
+    }
+
+    #[test]
+    fn comments() {
+        let html = "<p><!-- 1 -->2</p>";
+        let policy = SanitizerPolicy::new().allow_elements(&["p"]);
+
+        assert_eq!(sanitize(html, policy.clone()), "<p>2</p>");
+        assert_eq!(sanitize(html, policy.allow_comments()), html);
+    }
+
+    #[test]
+    fn cdata_sections() {
+        let html = "<svg><![CDATA[><img src=x onerror=alert(1)>]]></svg>";
+        let policy = SanitizerPolicy::new().allow_elements(&["p", "img"]);
+
+        assert_eq!(
+            sanitize(html, policy.clone()),
+            "<![CDATA[&gt;&lt;img src=x onerror=alert(1)&gt;]]>"
+        );
+
+        assert_eq!(sanitize(html, policy.allow_elements(&["svg"])), html);
+    }
+
+    #[test]
+    fn self_closing_foreign_elements() {
+        let policy = SanitizerPolicy::new().allow_elements(&["svg", "p"]);
+
+        assert_eq!(
+            sanitize(
+                "<svg><script/><title/><script><script/>1</script></svg><p>2</p>",
+                policy.clone()
+            ),
+            "<svg></svg><p>2</p>"
+        );
+
+        // NOTE: the self-closing syntax is ignored in HTML content.
+        assert_eq!(sanitize("<p><script/>1</script>2</p>", policy), "<p>2</p>");
+    }
+
+    #[test]
+    fn text_elements_in_removed_foreign_elements() {
+        let policy = SanitizerPolicy::new()
+            .allow_elements(&["style", "a"])
+            .allow_attributes(&["title"]);
+
+        assert_eq!(
+            sanitize(
+                r#"<svg><style><a title="</style><img src=x onerror=alert(1)>"></a></style></svg><a>2</a>"#,
+                policy
+            ),
+            "<a>2</a>"
+        );
+
+        let policy = SanitizerPolicy::new()
+            .allow_elements(&["style", "p"])
+            .allow_comments();
+
+        assert_eq!(
+            sanitize(
+                "<svg><style><!--</style><img src=x onerror=alert(1)>--></style></svg><p>2</p>",
+                policy
+            ),
+            "<p>2</p>"
+        );
+    }
+
+    #[test]
+    fn foreign_content_exits() {
+        let policy = SanitizerPolicy::new().allow_elements(&["svg", "style"]);
+
+        assert_eq!(
+            sanitize(
+                "<svg><b><style><img src=x onerror=alert(1)></style></b></svg><style>p {}</style>",
+                policy.clone()
+            ),
+            "<svg></svg><style>p {}</style>"
+        );
+
+        assert_eq!(
+            sanitize(
+                "<svg></p><style><img src=x onerror=alert(1)></style></svg>",
+                policy.clone()
+            ),
+            "<svg></svg>"
+        );
+
+        assert_eq!(
+            sanitize(
+                "<svg><foreignObject><style><img src=x onerror=alert(1)></style></foreignObject></svg>",
+                policy.clone()
+            ),
+            "<svg></svg>"
+        );
+
+        // NOTE: the removed content is parsed as text in the output, since `svg` is closed.
+        assert_eq!(
+            sanitize(
+                "<svg><script></svg><style><img src=x onerror=alert(1)></style>",
+                policy
+            ),
+            "<svg></svg><style><img src=x onerror=alert(1)></style>"
+        );
+    }
+}
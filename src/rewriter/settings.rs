@@ -1,7 +1,9 @@
+use crate::memory::{BufferPool, BufferSizeHistogram, MemoryBudget};
 use crate::rewritable_units::{Comment, Doctype, DocumentEnd, Element, EndTag, TextChunk};
 use crate::selectors_vm::Selector;
 // N.B. `use crate::` will break this because the constructor is not public, only the struct itself
-use super::AsciiCompatibleEncoding;
+use super::{AsciiCompatibleEncoding, RewriteRule, SanitizerPolicy};
+use encoding_rs::Encoding;
 use std::borrow::Cow;
 use std::error::Error;
 
@@ -252,6 +254,10 @@ pub struct ElementContentHandlers<'h, H: HandlerTypes = LocalHandlerTypes> {
     pub comments: Option<H::CommentHandler<'h>>,
     /// Text handler. See [`HandlerTypes::TextHandler`].
     pub text: Option<H::TextHandler<'h>>,
+    // NOTE: set with the `whole_text_nodes` method.
+    pub(crate) whole_text_nodes: Option<usize>,
+    // NOTE: set with the `once` method.
+    pub(crate) once: bool,
 }
 
 impl<H: HandlerTypes> Default for ElementContentHandlers<'_, H> {
@@ -260,6 +266,8 @@ impl<H: HandlerTypes> Default for ElementContentHandlers<'_, H> {
             element: None,
             comments: None,
             text: None,
+            whole_text_nodes: None,
+            once: false,
         }
     }
 }
@@ -291,6 +299,122 @@ impl<'h, H: HandlerTypes> ElementContentHandlers<'h, H> {
 
         self
     }
+
+    /// Sets an element handler that applies the `rules` to elements matched by a selector, in
+    /// order. Replaces the element handler if it has been set.
+    ///
+    /// See [`RewriteRule`] for an example.
+    ///
+    /// [`RewriteRule`]: enum.RewriteRule.html
+    #[inline]
+    #[must_use]
+    pub fn rules(mut self, rules: impl Into<Cow<'h, [RewriteRule]>>) -> Self {
+        let rules = rules.into();
+
+        self.element = Some(H::new_element_handler(
+            move |el: &mut Element<'_, '_, H>| -> HandlerResult {
+                for rule in rules.iter() {
+                    rule.apply(el)?;
+                }
+
+                Ok(())
+            },
+        ));
+
+        self
+    }
+
+    /// Makes the text handler receive text nodes of up to `max_size` bytes as a single
+    /// [`TextChunk`] that is the last in its text node.
+    ///
+    /// Text is buffered by the rewriter until the end of the text node, so the handler doesn't
+    /// need to concatenate the chunks itself. The buffer is accounted in the
+    /// [`MemorySettings::max_allowed_memory_usage`]. Text nodes that are larger than `max_size`
+    /// are delivered in multiple chunks, each of them up to `max_size` bytes.
+    ///
+    /// Other text handlers that are active for the same text node receive the same chunks.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{rewrite_str, ElementContentHandlers, RewriteStrSettings};
+    /// use lol_html::html_content::TextChunk;
+    /// use std::borrow::Cow;
+    ///
+    /// let mut text_nodes = vec![];
+    ///
+    /// rewrite_str(
+    ///     "<p>Hello world</p>",
+    ///     RewriteStrSettings {
+    ///         element_content_handlers: vec![(
+    ///             Cow::Owned("p".parse().unwrap()),
+    ///             ElementContentHandlers::default()
+    ///                 .text(|t: &mut TextChunk<'_>| {
+    ///                     text_nodes.push(t.as_str().to_owned());
+    ///                     Ok(())
+    ///                 })
+    ///                 .whole_text_nodes(1024),
+    ///         )],
+    ///         ..RewriteStrSettings::new()
+    ///     },
+    /// )
+    /// .unwrap();
+    ///
+    /// assert_eq!(text_nodes, ["Hello world"]);
+    /// ```
+    ///
+    /// [`TextChunk`]: html_content/struct.TextChunk.html
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    #[inline]
+    #[must_use]
+    pub fn whole_text_nodes(mut self, max_size: usize) -> Self {
+        self.whole_text_nodes = Some(max_size);
+
+        self
+    }
+
+    /// Makes each of the handlers be invoked at most once per document: the element handler
+    /// for the first matched element, the comment handler for the first comment and the text
+    /// handler for the first [`TextChunk`] in the content of the matched elements.
+    ///
+    /// Once all of the handlers of the rewriter are `once` handlers that have been invoked,
+    /// there are no end tag handlers and document end handlers pending, and no element
+    /// content is being removed, the rest of the document is passed to the output as is,
+    /// without parsing. Parsing ambiguities are not detected in that part of the document.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{rewrite_str, ElementContentHandlers, RewriteStrSettings};
+    /// use lol_html::html_content::{ContentType, Element};
+    /// use std::borrow::Cow;
+    ///
+    /// let html = rewrite_str(
+    ///     "<head></head><head></head>",
+    ///     RewriteStrSettings {
+    ///         element_content_handlers: vec![(
+    ///             Cow::Owned("head".parse().unwrap()),
+    ///             ElementContentHandlers::default()
+    ///                 .element(|el: &mut Element| {
+    ///                     el.prepend("<script></script>", ContentType::Html);
+    ///                     Ok(())
+    ///                 })
+    ///                 .once(),
+    ///         )],
+    ///         ..RewriteStrSettings::new()
+    ///     },
+    /// )
+    /// .unwrap();
+    ///
+    /// assert_eq!(html, "<head><script></script></head><head></head>");
+    /// ```
+    ///
+    /// [`TextChunk`]: html_content/struct.TextChunk.html
+    #[inline]
+    #[must_use]
+    pub fn once(mut self) -> Self {
+        self.once = true;
+
+        self
+    }
 }
 
 /// Specifies document-level content handlers.
@@ -315,8 +439,12 @@ pub struct DocumentContentHandlers<'h, H: HandlerTypes = LocalHandlerTypes> {
     pub comments: Option<H::CommentHandler<'h>>,
     /// Text handler. See [`HandlerTypes::TextHandler`].
     pub text: Option<H::TextHandler<'h>>,
+    // NOTE: set with the `whole_text_nodes` method.
+    pub(crate) whole_text_nodes: Option<usize>,
     /// End handler. See [`HandlerTypes::EndHandler`].
     pub end: Option<H::EndHandler<'h>>,
+    // NOTE: set with the `once` method.
+    pub(crate) once: bool,
 }
 
 impl<H: HandlerTypes> Default for DocumentContentHandlers<'_, H> {
@@ -325,7 +453,9 @@ impl<H: HandlerTypes> Default for DocumentContentHandlers<'_, H> {
             doctype: None,
             comments: None,
             text: None,
+            whole_text_nodes: None,
             end: None,
+            once: false,
         }
     }
 }
@@ -360,6 +490,16 @@ impl<'h, H: HandlerTypes> DocumentContentHandlers<'h, H> {
         self
     }
 
+    /// Makes the text handler receive text nodes of up to `max_size` bytes as a single chunk.
+    /// See [`ElementContentHandlers::whole_text_nodes`].
+    #[inline]
+    #[must_use]
+    pub fn whole_text_nodes(mut self, max_size: usize) -> Self {
+        self.whole_text_nodes = Some(max_size);
+
+        self
+    }
+
     /// Sets a handler for the document end, which is called after the last chunk is processed.
     #[inline]
     #[must_use]
@@ -368,6 +508,20 @@ impl<'h, H: HandlerTypes> DocumentContentHandlers<'h, H> {
 
         self
     }
+
+    /// Makes each of the handlers be invoked at most once per document: the doctype handler,
+    /// the comment handler for the first comment and the text handler for the first
+    /// [`TextChunk`]. The document end handler is always invoked once.
+    /// See [`ElementContentHandlers::once`].
+    ///
+    /// [`TextChunk`]: html_content/struct.TextChunk.html
+    #[inline]
+    #[must_use]
+    pub fn once(mut self) -> Self {
+        self.once = true;
+
+        self
+    }
 }
 
 #[doc(hidden)]
@@ -860,9 +1014,112 @@ pub struct Settings<'h, 's, H: HandlerTypes = LocalHandlerTypes> {
     /// `"utf-8"` when constructed with `Settings::new()`.
     pub encoding: AsciiCompatibleEncoding,
 
+    /// Specifies the [character encoding] of the input if it should be transcoded to UTF-8
+    /// before rewriting.
+    ///
+    /// Unlike [`encoding`], can be any of the web-compatible encodings, including `UTF-16LE` and
+    /// `UTF-16BE`. The input is decoded chunk by chunk as it is written to the rewriter, so
+    /// content handlers and the output get UTF-8 without a separate decoding pass over the
+    /// document. A byte order mark at the start of the input overrides the encoding.
+    ///
+    /// The decoding buffer is accounted in the [`MemorySettings::max_allowed_memory_usage`].
+    ///
+    /// # Panics
+    ///
+    /// The rewriter panics on construction if the input is transcoded and [`encoding`] is not
+    /// UTF-8 or [`adjust_charset_on_meta_tag`] is enabled.
+    ///
+    /// # Example
+    /// ```
+    /// use lol_html::{HtmlRewriter, Settings};
+    ///
+    /// let mut output = vec![];
+    /// let mut rewriter = HtmlRewriter::new(
+    ///     Settings {
+    ///         input_encoding: Some(encoding_rs::SHIFT_JIS),
+    ///         ..Settings::new()
+    ///     },
+    ///     |c: &[u8]| output.extend_from_slice(c),
+    /// );
+    ///
+    /// rewriter.write(b"<p>\x82\xa0</p>").unwrap();
+    /// rewriter.end().unwrap();
+    ///
+    /// assert_eq!(String::from_utf8(output).unwrap(), "<p>あ</p>");
+    /// ```
+    ///
+    /// [character encoding]: https://developer.mozilla.org/en-US/docs/Glossary/character_encoding
+    /// [`encoding`]: #structfield.encoding
+    /// [`adjust_charset_on_meta_tag`]: #structfield.adjust_charset_on_meta_tag
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    ///
+    /// ### Default
+    ///
+    /// `None` when constructed with `Settings::new()`.
+    pub input_encoding: Option<&'static Encoding>,
+
     /// Specifies the memory settings.
     pub memory_settings: MemorySettings,
 
+    /// A memory budget shared with other rewriters.
+    ///
+    /// The rewriter's memory usage is limited by the budget in addition to the
+    /// [`MemorySettings::max_allowed_memory_usage`], so a single budget can limit the total
+    /// memory usage of several rewriters, even if they run in different threads.
+    ///
+    /// ### Default
+    ///
+    /// `None` when constructed with `Settings::new()`.
+    ///
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    pub memory_budget: Option<MemoryBudget>,
+
+    /// A pool of buffers shared with other rewriters.
+    ///
+    /// If set, the rewriter takes its parsing and text decoding buffers from the pool and
+    /// returns them to the pool when it's dropped, which saves allocations when lots of
+    /// short-lived rewriters are constructed.
+    ///
+    /// ### Default
+    ///
+    /// `None` when constructed with `Settings::new()`.
+    pub buffer_pool: Option<BufferPool>,
+
+    /// A histogram of the parsing buffer sizes shared with other rewriters, usually the ones
+    /// constructed from the same settings.
+    ///
+    /// If set, the rewriter records the high-water mark of its parsing buffer in the histogram
+    /// at the end of each document, and preallocates the parsing buffer of the size taken from
+    /// the histogram instead of [`MemorySettings::preallocated_parsing_buffer_size`]. The size is
+    /// capped by [`MemorySettings::max_allowed_memory_usage`].
+    ///
+    /// ### Default
+    ///
+    /// `None` when constructed with `Settings::new()`.
+    ///
+    /// [`MemorySettings::preallocated_parsing_buffer_size`]: struct.MemorySettings.html#structfield.preallocated_parsing_buffer_size
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    pub parsing_buffer_histogram: Option<BufferSizeHistogram>,
+
+    /// Specifies the size in bytes of the buffer used to decode text in non-UTF-8 encodings for
+    /// the text handlers.
+    ///
+    /// Decoded text is passed to the text handlers in chunks no larger than this buffer. A larger
+    /// buffer means fewer text chunks and handler invocations for non-UTF-8 documents. The buffer
+    /// is allocated on [`HtmlRewriter`] instantiation and is not accounted in the
+    /// [`MemorySettings::max_allowed_memory_usage`].
+    ///
+    /// If set to `0`, the default size is used. Sizes smaller than 4 bytes are rounded up,
+    /// so that any character fits into the buffer.
+    ///
+    /// ### Default
+    ///
+    /// `1024` bytes when constructed with `Settings::new()`.
+    ///
+    /// [`HtmlRewriter`]: struct.HtmlRewriter.html
+    /// [`MemorySettings::max_allowed_memory_usage`]: struct.MemorySettings.html#structfield.max_allowed_memory_usage
+    pub text_decoder_buffer_size: usize,
+
     /// If set to `true` the rewriter bails out if it encounters markup that drives the HTML parser
     /// into ambigious state.
     ///
@@ -929,6 +1186,50 @@ pub struct Settings<'h, 's, H: HandlerTypes = LocalHandlerTypes> {
     ///
     /// `false` when constructed with `Settings::new()`.
     pub adjust_charset_on_meta_tag: bool,
+
+    /// If enabled the rewriter doesn't produce any output and never calls the output sink.
+    ///
+    /// The content handlers are still invoked and can read the content, so the rewriter can
+    /// be used to analyse documents, e.g. to extract links from them, without paying for
+    /// the serialization of the output. Modifications made by the handlers have no effect.
+    ///
+    /// ### Default
+    ///
+    /// `false` when constructed with `Settings::new()`.
+    pub disable_output: bool,
+
+    /// If set the rewriter sanitizes the document according to the allowlist policy.
+    ///
+    /// The sanitizer is a part of the rewriter, so it filters the document while it is being
+    /// parsed and doesn't need any content handlers. It runs after the content handlers, so
+    /// changes that the handlers make to the parsed tags, like added attributes, are subject
+    /// to the policy as well.
+    ///
+    /// **Content inserted by the handlers bypasses the policy.** Markup added with `before`,
+    /// `after`, `prepend`, `append`, `set_inner_content` or `replace` with
+    /// [`ContentType::Html`] is written to the output as is, so it should be trusted.
+    ///
+    /// ### Default
+    ///
+    /// `None` when constructed with `Settings::new()`.
+    ///
+    /// [`ContentType::Html`]: html_content/enum.ContentType.html#variant.Html
+    pub sanitizer: Option<SanitizerPolicy>,
+
+    /// If enabled the rewriter collects [`RewriterStats`] that can be retrieved with
+    /// [`HtmlRewriter::stats`]. Only available with the `stats` cargo feature.
+    ///
+    /// Collecting the stats adds a small overhead to the rewriting, and measuring the time
+    /// spent in the content handlers reads the clock on every handler invocation.
+    ///
+    /// ### Default
+    ///
+    /// `false` when constructed with `Settings::new()`.
+    ///
+    /// [`RewriterStats`]: struct.RewriterStats.html
+    /// [`HtmlRewriter::stats`]: struct.HtmlRewriter.html#method.stats
+    #[cfg(feature = "stats")]
+    pub enable_stats: bool,
 }
 
 impl Default for Settings<'_, '_, LocalHandlerTypes> {
@@ -965,14 +1266,53 @@ impl<H: HandlerTypes> Settings<'_, '_, H> {
             element_content_handlers: vec![],
             document_content_handlers: vec![],
             encoding: AsciiCompatibleEncoding(encoding_rs::UTF_8),
+            input_encoding: None,
             memory_settings: MemorySettings::default(),
+            memory_budget: None,
+            buffer_pool: None,
+            parsing_buffer_histogram: None,
+            text_decoder_buffer_size: 1024,
             strict: true,
             enable_esi_tags: false,
             adjust_charset_on_meta_tag: false,
+            disable_output: false,
+            sanitizer: None,
+            #[cfg(feature = "stats")]
+            enable_stats: false,
         }
     }
 }
 
+impl<H: HandlerTypes> Settings<'_, '_, H> {
+    #[inline]
+    pub(crate) fn has_selectors(&self) -> bool {
+        !self.element_content_handlers.is_empty() || self.adjust_charset_on_meta_tag
+    }
+
+    #[inline]
+    pub(crate) fn has_end_handlers(&self) -> bool {
+        self.document_content_handlers
+            .iter()
+            .any(|handlers| handlers.end.is_some())
+    }
+
+    #[inline]
+    pub(crate) fn preallocated_parsing_buffer_size(&self) -> usize {
+        let MemorySettings {
+            preallocated_parsing_buffer_size,
+            max_allowed_memory_usage,
+            ..
+        } = self.memory_settings;
+
+        self.parsing_buffer_histogram
+            .as_ref()
+            .and_then(BufferSizeHistogram::percentile_size)
+            .map_or(preallocated_parsing_buffer_size, |size| {
+                size.min(max_allowed_memory_usage)
+            })
+    }
+}
+
 impl<'h, 's, H: HandlerTypes> From<RewriteStrSettings<'h, 's, H>> for Settings<'h, 's, H> {
     #[inline]
     fn from(settings: RewriteStrSettings<'h, 's, H>) -> Self {
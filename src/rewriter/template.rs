@@ -0,0 +1,354 @@
+use super::handlers_dispatcher::SelectorHandlersLocator;
+use super::{
+    AsciiCompatibleEncoding, CharsetAdjustment, ElementContentHandlers, HandlerTypes, Settings,
+};
+use crate::base::SharedEncoding;
+use crate::selectors_vm::{Ast, Compiler, Program, Selector};
+use std::sync::Arc;
+
+/// Selectors of the rewriter [`Settings`] compiled ahead of time.
+///
+/// Parsing and compilation of CSS selectors is a considerable part of the [`HtmlRewriter`]
+/// construction cost. If lots of rewriters are created with the same selectors (e.g. one
+/// rewriter per HTTP response), the selectors can be compiled once into a template that is
+/// then shared by all of the rewriters with [`HtmlRewriter::from_template`]. Cloning a
+/// template is cheap, and it can be shared between threads.
+///
+/// The template captures the compiled selectors along with the layout of the handlers attached
+/// to them. It can only be used with settings that have the same selectors, in the same order,
+/// with the same kinds of handlers (element, comments and text) attached to them. The handlers
+/// themselves are not captured by the template and can be different for every rewriter.
+///
+/// # Example
+/// ```
+/// use lol_html::{element, HtmlRewriter, RewriterTemplate, Settings};
+///
+/// let settings = || Settings {
+///     element_content_handlers: vec![element!("a[href]", |el| {
+///         el.set_attribute("rel", "noopener")?;
+///         Ok(())
+///     })],
+///     ..Settings::new()
+/// };
+///
+/// let template = RewriterTemplate::new(&settings());
+///
+/// for _ in 0..3 {
+///     let mut output = vec![];
+///     let mut rewriter = HtmlRewriter::from_template(&template, settings(), |c: &[u8]| {
+///         output.extend_from_slice(c)
+///     });
+///
+///     rewriter.write(br#"<a href="/">"#).unwrap();
+///     rewriter.end().unwrap();
+///
+///     assert_eq!(output, br#"<a href="/" rel="noopener">"#);
+/// }
+/// ```
+///
+/// [`HtmlRewriter`]: struct.HtmlRewriter.html
+/// [`HtmlRewriter::from_template`]: struct.HtmlRewriter.html#method.from_template
+#[derive(Clone)]
+pub struct RewriterTemplate {
+    program: Option<Arc<Program<usize>>>,
+    handlers_layout: Arc<[SelectorHandlersLocator]>,
+    // NOTE: the parsed selectors of the element content handlers, so that the settings can be
+    // checked against the template without recompiling them.
+    selectors: Arc<[Selector]>,
+    encoding: AsciiCompatibleEncoding,
+    enable_esi_tags: bool,
+    adjust_charset_on_meta_tag: bool,
+}
+
+impl RewriterTemplate {
+    /// Compiles selectors of the `settings` into a template.
+    ///
+    /// Only selectors and the kinds of handlers attached to them are taken from the
+    /// `settings`, so the same settings can be used afterwards to build a rewriter.
+    #[must_use]
+    pub fn new<H: HandlerTypes>(settings: &Settings<'_, '_, H>) -> Self {
+        let mut selectors_ast = Ast::default();
+        let mut layout = HandlersLayout::default();
+
+        if settings.adjust_charset_on_meta_tag {
+            let encoding = SharedEncoding::new(settings.encoding);
+            let (selector, handlers) =
+                CharsetAdjustment::new(encoding, settings.encoding).handlers::<H>();
+
+            selectors_ast.add_selector(&selector, layout.add(&handlers));
+        }
+
+        for (selector, handlers) in &settings.element_content_handlers {
+            let idx = layout.add(handlers);
+
+            selectors_ast.add_selector(selector, idx);
+        }
+
+        let program = settings
+            .has_selectors()
+            .then(|| Arc::new(Compiler::new(settings.encoding.into()).compile(selectors_ast)));
+
+        let selectors = settings
+            .element_content_handlers
+            .iter()
+            .map(|(selector, _)| Selector::clone(selector))
+            .collect();
+
+        Self {
+            program,
+            handlers_layout: layout.locators.into(),
+            selectors,
+            encoding: settings.encoding,
+            enable_esi_tags: settings.enable_esi_tags,
+            adjust_charset_on_meta_tag: settings.adjust_charset_on_meta_tag,
+        }
+    }
+
+    #[inline]
+    pub(crate) fn program(&self) -> Option<Arc<Program<usize>>> {
+        self.program.clone()
+    }
+
+    #[inline]
+    pub(crate) fn handlers_layout(&self) -> &[SelectorHandlersLocator] {
+        &self.handlers_layout
+    }
+
+    #[track_caller]
+    pub(crate) fn assert_compatible_with<H: HandlerTypes>(&self, settings: &Settings<'_, '_, H>) {
+        assert!(
+            self.encoding == settings.encoding
+                && self.enable_esi_tags == settings.enable_esi_tags
+                && self.adjust_charset_on_meta_tag == settings.adjust_charset_on_meta_tag,
+            "Settings should have the same encoding and selector options as the template."
+        );
+
+        let selector_count = settings.element_content_handlers.len()
+            + usize::from(settings.adjust_charset_on_meta_tag);
+
+        assert!(
+            self.handlers_layout.len() == selector_count,
+            "Settings should have the same number of selectors as the template."
+        );
+
+        let same_selectors = settings
+            .element_content_handlers
+            .iter()
+            .zip(self.selectors.iter())
+            .all(|((selector, _), template_selector)| **selector == *template_selector);
+
+        assert!(
+            same_selectors,
+            "Settings should have the same selectors as the template."
+        );
+    }
+}
+
+/// Mirrors the handler index assignment of `ContentHandlersDispatcher` without
+/// actually storing any handlers.
+#[derive(Default)]
+struct HandlersLayout {
+    locators: Vec<SelectorHandlersLocator>,
+    element_handler_count: usize,
+    comment_handler_count: usize,
+    text_handler_count: usize,
+}
+
+impl HandlersLayout {
+    fn add<H: HandlerTypes>(&mut self, handlers: &ElementContentHandlers<'_, H>) -> usize {
+        macro_rules! next_idx {
+            ($handler:ident, $count:ident) => {
+                handlers.$handler.as_ref().map(|_| {
+                    self.$count += 1;
+                    self.$count - 1
+                })
+            };
+        }
+
+        let locator = SelectorHandlersLocator {
+            element_handler_idx: next_idx!(element, element_handler_count),
+            comment_handler_idx: next_idx!(comments, comment_handler_count),
+            text_handler_idx: next_idx!(text, text_handler_count),
+        };
+
+        self.locators.push(locator);
+
+        self.locators.len() - 1
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::HtmlRewriter;
+
+    fn rewrite(template: &RewriterTemplate, settings: Settings<'_, '_>, html: &str) -> String {
+        let mut output = vec![];
+        let mut rewriter = HtmlRewriter::from_template(template, settings, |c: &[u8]| {
+            output.extend_from_slice(c);
+        });
+
+        rewriter.write(html.as_bytes()).unwrap();
+        rewriter.end().unwrap();
+
+        String::from_utf8(output).unwrap()
+    }
+
+    #[test]
+    fn reuse_template() {
+        let settings = || Settings {
+            element_content_handlers: vec![
+                element!("div", |el| {
+                    el.set_attribute("foo", "bar")?;
+                    Ok(())
+                }),
+                text!("span", |t| {
+                    t.remove();
+                    Ok(())
+                }),
+                comments!("div", |c| {
+                    c.remove();
+                    Ok(())
+                }),
+            ],
+            ..Settings::new()
+        };
+
+        let template = RewriterTemplate::new(&settings());
+
+        for _ in 0..3 {
+            assert_eq!(
+                rewrite(
+                    &template,
+                    settings(),
+                    "<div><span>abc</span><!-- foo --></div>"
+                ),
+                r#"<div foo="bar"><span></span></div>"#
+            );
+        }
+    }
+
+    #[test]
+    fn template_without_selectors() {
+        let template = RewriterTemplate::new(&Settings::new());
+
+        assert_eq!(
+            rewrite(&template, Settings::new(), "<div>abc</div>"),
+            "<div>abc</div>"
+        );
+    }
+
+    #[test]
+    #[should_panic(expected = "Settings should have the same number of selectors as the template.")]
+    fn mismatched_selector_count() {
+        let template = RewriterTemplate::new(&Settings::new());
+
+        rewrite(
+            &template,
+            Settings {
+                element_content_handlers: vec![element!("div", |_| Ok(()))],
+                ..Settings::new()
+            },
+            "",
+        );
+    }
+
+    #[test]
+    #[should_panic(expected = "Settings should have the same selectors as the template.")]
+    fn mismatched_selectors() {
+        let template = RewriterTemplate::new(&Settings {
+            element_content_handlers: vec![element!("div", |_| Ok(()))],
+            ..Settings::new()
+        });
+
+        rewrite(
+            &template,
+            Settings {
+                element_content_handlers: vec![element!("span", |_| Ok(()))],
+                ..Settings::new()
+            },
+            "",
+        );
+    }
+
+    #[test]
+    fn selectors_compared_after_parsing() {
+        let template = RewriterTemplate::new(&Settings {
+            element_content_handlers: vec![element!("div>p", |_| Ok(()))],
+            ..Settings::new()
+        });
+
+        let output = rewrite(
+            &template,
+            Settings {
+                element_content_handlers: vec![element!("div  >  p", |el| {
+                    el.remove();
+                    Ok(())
+                })],
+                ..Settings::new()
+            },
+            "<div><p>1</p>2</div>",
+        );
+
+        assert_eq!(output, "<div>2</div>");
+    }
+
+    #[test]
+    #[should_panic(expected = "Settings should have the same handlers as the template.")]
+    fn mismatched_handler_kinds() {
+        let template = RewriterTemplate::new(&Settings {
+            element_content_handlers: vec![element!("div", |_| Ok(()))],
+            ..Settings::new()
+        });
+
+        rewrite(
+            &template,
+            Settings {
+                element_content_handlers: vec![text!("div", |_| Ok(()))],
+                ..Settings::new()
+            },
+            "",
+        );
+    }
+
+    #[test]
+    fn shared_between_threads() {
+        let template = RewriterTemplate::new(&crate::send::Settings {
+            element_content_handlers: vec![element!("p", |el| {
+                el.remove();
+                Ok(())
+            })],
+            ..crate::send::Settings::new_send()
+        });
+
+        let threads = (0..4)
+            .map(|_| {
+                let template = template.clone();
+
+                std::thread::spawn(move || {
+                    let mut output = vec![];
+                    let mut rewriter = crate::send::HtmlRewriter::from_template(
+                        &template,
+                        crate::send::Settings {
+                            element_content_handlers: vec![element!("p", |el| {
+                                el.remove();
+                                Ok(())
+                            })],
+                            ..crate::send::Settings::new_send()
+                        },
+                        |c: &[u8]| output.extend_from_slice(c),
+                    );
+
+                    rewriter.write(b"<div><p>1</p>2</div>").unwrap();
+                    rewriter.end().unwrap();
+
+                    output
+                })
+            })
+            .collect::<Vec<_>>();
+
+        for thread in threads {
+            assert_eq!(thread.join().unwrap(), b"<div>2</div>");
+        }
+    }
+}
@@ -211,6 +211,8 @@ where
     pub predicate: Predicate,
     pub children: Vec<AstNode<P>>,
     pub descendants: Vec<AstNode<P>>,
+    pub next_siblings: Vec<AstNode<P>>,
+    pub later_siblings: Vec<AstNode<P>>,
     pub payload: HashSet<P>,
 }
 
@@ -223,6 +225,8 @@ where
             predicate,
             children: Vec::default(),
             descendants: Vec::default(),
+            next_siblings: Vec::default(),
+            later_siblings: Vec::default(),
             payload: HashSet::default(),
         }
     }
@@ -288,6 +292,12 @@ where
                     Component::Combinator(Combinator::Descendant) => {
                         host_and_switch_branch_vec!(descendants)
                     }
+                    Component::Combinator(Combinator::NextSibling) => {
+                        host_and_switch_branch_vec!(next_siblings)
+                    }
+                    Component::Combinator(Combinator::LaterSibling) => {
+                        host_and_switch_branch_vec!(later_siblings)
+                    }
                     Component::Negation(ss) => {
                         ss.slice()
                             .iter()
@@ -367,6 +377,8 @@ mod tests {
                         },
                         children: vec![],
                         descendants: vec![],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
                         payload: set![0],
                     }],
                     cumulative_node_count: 1,
@@ -522,6 +534,8 @@ mod tests {
                         },
                         children: vec![],
                         descendants: vec![],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
                         payload: set![0],
                     }],
                     cumulative_node_count: 1,
@@ -558,6 +572,8 @@ mod tests {
                     },
                     children: vec![],
                     descendants: vec![],
+                    next_siblings: vec![],
+                    later_siblings: vec![],
                     payload: set![0],
                 }],
                 cumulative_node_count: 1,
@@ -580,6 +596,8 @@ mod tests {
                     },
                     children: vec![],
                     descendants: vec![],
+                    next_siblings: vec![],
+                    later_siblings: vec![],
                     payload: set![0, 1],
                 }],
                 cumulative_node_count: 1,
@@ -611,6 +629,8 @@ mod tests {
                             },
                             children: vec![],
                             descendants: vec![],
+                            next_siblings: vec![],
+                            later_siblings: vec![],
                             payload: set![0],
                         },
                         AstNode {
@@ -623,6 +643,8 @@ mod tests {
                             },
                             children: vec![],
                             descendants: vec![],
+                            next_siblings: vec![],
+                            later_siblings: vec![],
                             payload: set![0],
                         },
                         AstNode {
@@ -635,6 +657,8 @@ mod tests {
                             },
                             children: vec![],
                             descendants: vec![],
+                            next_siblings: vec![],
+                            later_siblings: vec![],
                             payload: set![1],
                         },
                         AstNode {
@@ -647,10 +671,14 @@ mod tests {
                             },
                             children: vec![],
                             descendants: vec![],
+                            next_siblings: vec![],
+                            later_siblings: vec![],
                             payload: set![1],
                         },
                     ],
                     descendants: vec![],
+                    next_siblings: vec![],
+                    later_siblings: vec![],
                     payload: set![],
                 }],
                 cumulative_node_count: 5,
@@ -709,8 +737,12 @@ mod tests {
                                             },
                                             children: vec![],
                                             descendants: vec![],
+                                            next_siblings: vec![],
+                                            later_siblings: vec![],
                                             payload: set![0],
                                         }],
+                                        next_siblings: vec![],
+                                        later_siblings: vec![],
                                         payload: set![],
                                     },
                                     AstNode {
@@ -723,9 +755,13 @@ mod tests {
                                         },
                                         children: vec![],
                                         descendants: vec![],
+                                        next_siblings: vec![],
+                                        later_siblings: vec![],
                                         payload: set![1],
                                     },
                                 ],
+                                next_siblings: vec![],
+                                later_siblings: vec![],
                                 payload: set![],
                             },
                             AstNode {
@@ -738,6 +774,8 @@ mod tests {
                                 },
                                 children: vec![],
                                 descendants: vec![],
+                                next_siblings: vec![],
+                                later_siblings: vec![],
                                 payload: set![2],
                             },
                         ],
@@ -752,6 +790,8 @@ mod tests {
                                 },
                                 children: vec![],
                                 descendants: vec![],
+                                next_siblings: vec![],
+                                later_siblings: vec![],
                                 payload: set![3],
                             },
                             AstNode {
@@ -777,11 +817,17 @@ mod tests {
                                     },
                                     children: vec![],
                                     descendants: vec![],
+                                    next_siblings: vec![],
+                                    later_siblings: vec![],
                                     payload: set![4],
                                 }],
+                                next_siblings: vec![],
+                                later_siblings: vec![],
                                 payload: set![],
                             },
                         ],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
                         payload: set![],
                     },
                     AstNode {
@@ -794,6 +840,8 @@ mod tests {
                         },
                         children: vec![],
                         descendants: vec![],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
                         payload: set![5],
                     },
                 ],
@@ -802,6 +850,69 @@ mod tests {
         );
     }
 
+    #[test]
+    fn sibling_combinators() {
+        assert_ast(
+            &["h2 + p", "h2 ~ p > a"],
+            Ast {
+                root: vec![AstNode {
+                    predicate: Predicate {
+                        on_tag_name_exprs: vec![Expr {
+                            simple_expr: OnTagNameExpr::LocalName("h2".into()),
+                            negation: false,
+                        }],
+                        ..Default::default()
+                    },
+                    children: vec![],
+                    descendants: vec![],
+                    next_siblings: vec![AstNode {
+                        predicate: Predicate {
+                            on_tag_name_exprs: vec![Expr {
+                                simple_expr: OnTagNameExpr::LocalName("p".into()),
+                                negation: false,
+                            }],
+                            ..Default::default()
+                        },
+                        children: vec![],
+                        descendants: vec![],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
+                        payload: set![0],
+                    }],
+                    later_siblings: vec![AstNode {
+                        predicate: Predicate {
+                            on_tag_name_exprs: vec![Expr {
+                                simple_expr: OnTagNameExpr::LocalName("p".into()),
+                                negation: false,
+                            }],
+                            ..Default::default()
+                        },
+                        children: vec![AstNode {
+                            predicate: Predicate {
+                                on_tag_name_exprs: vec![Expr {
+                                    simple_expr: OnTagNameExpr::LocalName("a".into()),
+                                    negation: false,
+                                }],
+                                ..Default::default()
+                            },
+                            children: vec![],
+                            descendants: vec![],
+                            next_siblings: vec![],
+                            later_siblings: vec![],
+                            payload: set![1],
+                        }],
+                        descendants: vec![],
+                        next_siblings: vec![],
+                        later_siblings: vec![],
+                        payload: set![],
+                    }],
+                    payload: set![],
+                }],
+                cumulative_node_count: 4,
+            },
+        );
+    }
+
     #[test]
     fn parse_errors() {
         assert_err("div@", SelectorError::UnexpectedToken);
@@ -816,8 +927,6 @@ mod tests {
         assert_err("svg|img", SelectorError::NamespacedSelector);
         assert_err(".foo()", SelectorError::InvalidClassName);
         assert_err(":not()", SelectorError::EmptySelector);
-        assert_err("div + span", SelectorError::UnsupportedCombinator('+'));
-        assert_err("div ~ span", SelectorError::UnsupportedCombinator('~'));
         assert_err(":nth-child(n of a)", SelectorError::UnexpectedToken);
     }
 
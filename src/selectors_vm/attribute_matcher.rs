@@ -9,6 +9,42 @@ use std::cell::OnceCell;
 const ID_ATTR: &[u8] = b"id";
 const CLASS_ATTR: &[u8] = b"class";
 
+/// Elements with this many attributes or fewer are searched linearly, as building
+/// an index for them doesn't pay off.
+const MAX_LINEAR_SEARCH_ATTR_COUNT: usize = 8;
+
+/// FNV-1a hash of the ASCII-lowercased attribute name.
+#[inline]
+const fn hash_name(name: &[u8]) -> u32 {
+    let mut hash = 0x811c_9dc5_u32;
+    let mut i = 0;
+
+    while i < name.len() {
+        hash ^= name[i].to_ascii_lowercase() as u32;
+        hash = hash.wrapping_mul(0x0100_0193);
+        i += 1;
+    }
+
+    hash
+}
+
+/// A lowercased attribute name from a selector, hashed at compilation time.
+pub(crate) struct AttrName {
+    name: Box<[u8]>,
+    hash: u32,
+}
+
+impl AttrName {
+    #[inline]
+    #[must_use]
+    pub fn new(lowercased_name: Box<[u8]>) -> Self {
+        AttrName {
+            hash: hash_name(&lowercased_name),
+            name: lowercased_name,
+        }
+    }
+}
+
 #[inline]
 const fn is_attr_whitespace(b: u8) -> bool {
     b == b' ' || b == b'\n' || b == b'\r' || b == b'\t' || b == b'\x0c'
@@ -36,9 +72,21 @@ fn to_unconditional(
 
 type MemoizedAttrValue<'i> = OnceCell<Option<&'i [u8]>>;
 
+/// Hash table of the element's attributes that is built on the first lookup, so that each
+/// attribute expression doesn't need to scan all of the attributes.
+struct AttributeIndex {
+    /// Open addressing table with linear probing. Slots store indices in the attribute
+    /// buffer offset by one, so that zero marks an empty slot. The table is never more
+    /// than half full.
+    slots: Box<[usize]>,
+    /// Name hashes of the attributes, in the attribute buffer order.
+    hashes: Box<[u32]>,
+}
+
 pub(crate) struct AttributeMatcher<'i> {
     input: Bytes<'i>,
     attributes: &'i AttributeBuffer,
+    index: OnceCell<AttributeIndex>,
     id: MemoizedAttrValue<'i>,
     class: MemoizedAttrValue<'i>,
     is_html_element: bool,
@@ -51,6 +99,7 @@ impl<'i> AttributeMatcher<'i> {
         AttributeMatcher {
             input,
             attributes,
+            index: OnceCell::new(),
             id: OnceCell::new(),
             class: OnceCell::new(),
             is_html_element: ns == Namespace::Html,
@@ -58,62 +107,125 @@ impl<'i> AttributeMatcher<'i> {
     }
 
     #[inline]
-    fn find(&self, lowercased_name: &[u8]) -> Option<AttributeOutline> {
-        self.attributes
+    fn name_matches(&self, attr: &AttributeOutline, lowercased_name: &[u8]) -> bool {
+        let attr_name = self.input.slice(attr.name);
+
+        attr_name.len() == lowercased_name.len()
+            && attr_name
+                .iter()
+                .zip(lowercased_name)
+                .all(|(b, lowercased_b)| b.to_ascii_lowercase() == *lowercased_b)
+    }
+
+    fn build_index(&self) -> AttributeIndex {
+        let hashes = self
+            .attributes
             .iter()
-            .find(|&a| {
-                if lowercased_name.len() != a.name.end - a.name.start {
-                    return false;
+            .map(|a| hash_name(&self.input.slice(a.name)))
+            .collect::<Box<[u32]>>();
+
+        let mut slots = vec![0; (hashes.len() * 2).next_power_of_two()].into_boxed_slice();
+        let mask = slots.len() - 1;
+
+        'attrs: for (idx, &hash) in hashes.iter().enumerate() {
+            let mut slot = hash as usize & mask;
+
+            while slots[slot] != 0 {
+                let other_idx = slots[slot] - 1;
+
+                // NOTE: only the first of the attributes with the same name can be found,
+                // like with the linear search.
+                if hashes[other_idx] == hash
+                    && self
+                        .input
+                        .slice(self.attributes[other_idx].name)
+                        .eq_ignore_ascii_case(&self.input.slice(self.attributes[idx].name))
+                {
+                    continue 'attrs;
                 }
 
-                let attr_name = self.input.slice(a.name);
+                slot = (slot + 1) & mask;
+            }
 
-                for i in 0..attr_name.len() {
-                    if attr_name[i].to_ascii_lowercase() != lowercased_name[i] {
-                        return false;
-                    }
-                }
+            slots[slot] = idx + 1;
+        }
+
+        AttributeIndex { slots, hashes }
+    }
+
+    #[inline]
+    fn find(&self, lowercased_name: &[u8], hash: u32) -> Option<AttributeOutline> {
+        if self.attributes.len() <= MAX_LINEAR_SEARCH_ATTR_COUNT {
+            return self
+                .attributes
+                .iter()
+                .find(|a| self.name_matches(a, lowercased_name))
+                .copied();
+        }
 
-                true
-            })
-            .copied()
+        let index = self.index.get_or_init(|| self.build_index());
+        let mask = index.slots.len() - 1;
+        let mut slot = hash as usize & mask;
+
+        loop {
+            let idx = index.slots[slot].checked_sub(1)?;
+            let attr = &self.attributes[idx];
+
+            if index.hashes[idx] == hash && self.name_matches(attr, lowercased_name) {
+                return Some(*attr);
+            }
+
+            slot = (slot + 1) & mask;
+        }
     }
 
     #[inline]
-    fn get_value(&self, lowercased_name: &[u8]) -> Option<&'i [u8]> {
-        self.find(lowercased_name)
+    fn get_value(&self, lowercased_name: &[u8], hash: u32) -> Option<&'i [u8]> {
+        self.find(lowercased_name, hash)
             .map(|a| self.input.slice(a.value).as_slice())
     }
 
     #[inline]
     #[must_use]
-    pub fn has_attribute(&self, lowercased_name: &[u8]) -> bool {
-        self.find(lowercased_name).is_some()
+    pub fn has_attribute(&self, name: &AttrName) -> bool {
+        self.find(&name.name, name.hash).is_some()
+    }
+
+    #[inline]
+    #[must_use]
+    pub fn id(&self) -> Option<&'i [u8]> {
+        *self
+            .id
+            .get_or_init(|| self.get_value(ID_ATTR, hash_name(ID_ATTR)))
+    }
+
+    #[inline]
+    pub fn classes(&self) -> impl Iterator<Item = &'i [u8]> {
+        let class = *self
+            .class
+            .get_or_init(|| self.get_value(CLASS_ATTR, hash_name(CLASS_ATTR)));
+
+        class
+            .into_iter()
+            .flat_map(|class| class.split(|&b| is_attr_whitespace(b)))
     }
 
     #[inline]
     #[must_use]
     pub fn has_id(&self, id: &[u8]) -> bool {
-        match self.id.get_or_init(|| self.get_value(ID_ATTR)) {
-            Some(actual_id) => *actual_id == id,
-            None => false,
-        }
+        self.id() == Some(id)
     }
 
     #[inline]
     #[must_use]
     pub fn has_class(&self, class_name: &[u8]) -> bool {
-        match self.class.get_or_init(|| self.get_value(CLASS_ATTR)) {
-            Some(class) => class
-                .split(|&b| is_attr_whitespace(b))
-                .any(|actual_class_name| actual_class_name == class_name),
-            None => false,
-        }
+        self.classes()
+            .any(|actual_class_name| actual_class_name == class_name)
     }
 
     #[inline]
-    fn value_matches(&self, name: &[u8], matcher: impl Fn(&[u8]) -> bool) -> bool {
-        self.get_value(name).is_some_and(matcher)
+    fn value_matches(&self, name: &AttrName, matcher: impl Fn(&[u8]) -> bool) -> bool {
+        self.get_value(&name.name, name.hash).is_some_and(matcher)
     }
 
     #[inline]
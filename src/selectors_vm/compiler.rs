@@ -1,12 +1,13 @@
-use super::attribute_matcher::AttributeMatcher;
-use super::program::{AddressRange, ExecutionBranch, Instruction, Program};
+use super::attribute_matcher::{AttrName, AttributeMatcher};
+use super::program::{AddressRange, EntryPointIndex, ExecutionBranch, Instruction, Program};
 use super::{
     Ast, AstNode, AttributeComparisonExpr, Expr, OnAttributesExpr, OnTagNameExpr, Predicate,
     SelectorState,
 };
 use crate::base::{BytesCow, HasReplacementsError};
-use crate::html::LocalName;
+use crate::html::{LocalName, LocalNameHash};
 use encoding_rs::Encoding;
+use hashbrown::HashMap;
 use selectors::attr::{AttrSelectorOperator, ParsedCaseSensitivity};
 use std::fmt::Debug;
 use std::hash::Hash;
@@ -15,10 +16,11 @@ use std::iter;
 type BytesOwned = Box<[u8]>;
 
 /// An expression using only the tag name of an element.
-pub type CompiledLocalNameExpr = Box<dyn Fn(&SelectorState<'_>, &LocalName<'_>) -> bool + Send>;
+pub type CompiledLocalNameExpr =
+    Box<dyn Fn(&SelectorState<'_>, &LocalName<'_>) -> bool + Send + Sync>;
 /// An expression using the attributes of an element.
 pub type CompiledAttributeExpr =
-    Box<dyn Fn(&SelectorState<'_>, &AttributeMatcher<'_>) -> bool + Send>;
+    Box<dyn Fn(&SelectorState<'_>, &AttributeMatcher<'_>) -> bool + Send + Sync>;
 
 #[derive(Default)]
 struct ExprSet {
@@ -27,14 +29,16 @@ struct ExprSet {
 }
 
 pub(crate) struct AttrExprOperands {
-    pub name: BytesOwned,
+    pub name: AttrName,
     pub value: BytesOwned,
     pub case_sensitivity: ParsedCaseSensitivity,
 }
 
 impl Expr<OnTagNameExpr> {
     #[inline]
-    pub fn compile_expr<F: Fn(&SelectorState<'_>, &LocalName<'_>) -> bool + Send + 'static>(
+    pub fn compile_expr<
+        F: Fn(&SelectorState<'_>, &LocalName<'_>) -> bool + Send + Sync + 'static,
+    >(
         &self,
         f: F,
     ) -> CompiledLocalNameExpr {
@@ -96,7 +100,7 @@ impl Compilable for Expr<OnTagNameExpr> {
 impl Expr<OnAttributesExpr> {
     #[inline]
     pub fn compile_expr<
-        F: Fn(&SelectorState<'_>, &AttributeMatcher<'_>) -> bool + Send + 'static,
+        F: Fn(&SelectorState<'_>, &AttributeMatcher<'_>) -> bool + Send + Sync + 'static,
     >(
         &self,
         f: F,
@@ -147,8 +151,13 @@ impl Compilable for Expr<OnAttributesExpr> {
                 OnAttributesExpr::Class(class) => compile_literal(encoding, class)
                     .map(|class| self.compile_expr(move |_, m| m.has_class(&class))),
 
-                OnAttributesExpr::AttributeExists(name) => compile_literal(encoding, name)
-                    .map(|name| self.compile_expr(move |_, m| m.has_attribute(&name))),
+                OnAttributesExpr::AttributeExists(name) => {
+                    compile_literal(encoding, name).map(|name| {
+                        let name = AttrName::new(name);
+
+                        self.compile_expr(move |_, m| m.has_attribute(&name))
+                    })
+                }
 
                 &OnAttributesExpr::AttributeComparisonExpr(AttributeComparisonExpr {
                     ref name,
@@ -157,7 +166,7 @@ impl Compilable for Expr<OnAttributesExpr> {
                     operator,
                 }) => compile_operands(encoding, name, value).map(move |(name, value)| {
                     let operands = AttrExprOperands {
-                        name,
+                        name: AttrName::new(name),
                         value,
                         case_sensitivity,
                     };
@@ -189,6 +198,94 @@ impl Compilable for Expr<OnAttributesExpr> {
     }
 }
 
+/// A literal that an element is required to have to be matched by an entry point instruction.
+enum EntryPointKey {
+    LocalName(LocalNameHash),
+    Id(BytesOwned),
+    Class(BytesOwned),
+    None,
+}
+
+impl EntryPointKey {
+    // NOTE: local names are preferred, since they can be checked without
+    // requesting the element's attributes. Instructions with other tag name
+    // expressions are not keyed by the id or class, since these expressions
+    // can reject an element before its attributes are requested.
+    fn new(encoding: &'static Encoding, predicate: &Predicate) -> Self {
+        let local_name = predicate
+            .on_tag_name_exprs
+            .iter()
+            .filter(|e| !e.negation)
+            .find_map(|e| match &e.simple_expr {
+                OnTagNameExpr::LocalName(name) => {
+                    match LocalName::from_str_without_replacements(name, encoding) {
+                        Ok(LocalName::Hash(hash)) => Some(Self::LocalName(hash)),
+                        _ => None,
+                    }
+                }
+                _ => None,
+            });
+
+        if local_name.is_none()
+            && !predicate
+                .on_tag_name_exprs
+                .iter()
+                .all(|e| !e.negation && matches!(e.simple_expr, OnTagNameExpr::ExplicitAny))
+        {
+            return Self::None;
+        }
+
+        let mut attr_exprs = predicate.on_attr_exprs.iter().filter(|e| !e.negation);
+
+        local_name
+            .or_else(|| {
+                attr_exprs.clone().find_map(|e| match &e.simple_expr {
+                    OnAttributesExpr::Id(id) => compile_literal(encoding, id).ok().map(Self::Id),
+                    _ => None,
+                })
+            })
+            .or_else(|| {
+                attr_exprs.find_map(|e| match &e.simple_expr {
+                    OnAttributesExpr::Class(class) => {
+                        compile_literal(encoding, class).ok().map(Self::Class)
+                    }
+                    _ => None,
+                })
+            })
+            .unwrap_or(Self::None)
+    }
+}
+
+fn build_entry_point_index(
+    keys: Vec<EntryPointKey>,
+    entry_points: AddressRange,
+) -> EntryPointIndex {
+    fn into_boxed<K: Eq + Hash>(map: HashMap<K, Vec<usize>>) -> HashMap<K, Box<[usize]>> {
+        map.into_iter().map(|(k, v)| (k, v.into())).collect()
+    }
+
+    let mut generic = Vec::new();
+    let mut by_local_name = HashMap::<_, Vec<_>>::new();
+    let mut by_id = HashMap::<_, Vec<_>>::new();
+    let mut by_class = HashMap::<_, Vec<_>>::new();
+
+    for (key, addr) in keys.into_iter().zip(entry_points) {
+        match key {
+            EntryPointKey::LocalName(hash) => by_local_name.entry(hash).or_default().push(addr),
+            EntryPointKey::Id(id) => by_id.entry(id).or_default().push(addr),
+            EntryPointKey::Class(class) => by_class.entry(class).or_default().push(addr),
+            EntryPointKey::None => generic.push(addr),
+        }
+    }
+
+    EntryPointIndex {
+        generic: generic.into(),
+        by_local_name: into_boxed(by_local_name),
+        by_id: into_boxed(by_id),
+        by_class: into_boxed(by_class),
+    }
+}
+
 pub(crate) struct Compiler<P>
 where
     P: PartialEq + Eq + Copy + Debug + Hash,
@@ -282,9 +379,13 @@ where
 
         for (node, position) in nodes.into_iter().zip(addr_range.clone()) {
             let branch = ExecutionBranch {
-                matched_payload: node.payload,
+                matched_payload: node.payload.into_iter().collect(),
                 jumps: self.compile_descendants(node.children, enable_nth_of_type),
                 hereditary_jumps: self.compile_descendants(node.descendants, enable_nth_of_type),
+                next_sibling_jumps: self
+                    .compile_descendants(node.next_siblings, enable_nth_of_type),
+                later_sibling_jumps: self
+                    .compile_descendants(node.later_siblings, enable_nth_of_type),
             };
 
             self.instructions[position] =
@@ -305,17 +406,32 @@ where
             .take(ast.cumulative_node_count)
             .collect();
 
+        let entry_point_keys = ast
+            .root
+            .iter()
+            .map(|node| EntryPointKey::new(self.encoding, &node.predicate))
+            .collect();
+
         let entry_points = self.compile_nodes(ast.root, &mut enable_nth_of_type);
+        let entry_point_index = build_entry_point_index(entry_point_keys, entry_points.clone());
+
+        let instructions: Box<[_]> = self
+            .instructions
+            .into_vec()
+            .into_iter()
+            .map(|o| o.unwrap())
+            .collect();
+
+        let enable_sibling_jumps = instructions
+            .iter()
+            .any(|i| i.associated_branch.has_sibling_jumps());
 
         Program {
-            instructions: self
-                .instructions
-                .into_vec()
-                .into_iter()
-                .map(|o| o.unwrap())
-                .collect(),
+            instructions,
             entry_points,
+            entry_point_index,
             enable_nth_of_type,
+            enable_sibling_jumps,
         }
     }
 }
@@ -333,7 +449,7 @@ mod tests {
     macro_rules! assert_instr_res {
         ($res:expr, $should_match:expr, $selector:expr, $input:expr, $encoding:expr) => {{
             let expected_payload = if *$should_match {
-                Some(vec![0].into_iter().collect::<HashSet<_>>())
+                Some(vec![0].into_boxed_slice())
             } else {
                 None
             };
@@ -893,6 +1009,59 @@ mod tests {
         }
     }
 
+    #[test]
+    fn compiled_attr_expression_with_many_attributes() {
+        let many_attrs = "data-a data-b data-c data-d data-e data-f data-g data-h data-i";
+
+        for encoding in &ASCII_COMPATIBLE_ENCODINGS {
+            assert_attr_expr_matches_and_negation_reverses_match(
+                "[foo⽅]",
+                encoding,
+                &[
+                    (format!("<div {many_attrs} FOo⽅=123>").as_str(), true),
+                    (format!("<div {many_attrs} foo⽅1>").as_str(), false),
+                    (format!("<div {many_attrs}>").as_str(), false),
+                ],
+            );
+
+            assert_attr_expr_matches_and_negation_reverses_match(
+                r#"[foo="barα"]"#,
+                encoding,
+                &[
+                    (
+                        format!("<div {many_attrs} fOo='barα' foo=baz>").as_str(),
+                        true,
+                    ),
+                    (
+                        format!("<div {many_attrs} foo=baz fOo='barα'>").as_str(),
+                        false,
+                    ),
+                ],
+            );
+
+            assert_attr_expr_matches_and_negation_reverses_match(
+                "#foo",
+                encoding,
+                &[
+                    (
+                        format!("<div {many_attrs} class='c1 c2' ID=foo>").as_str(),
+                        true,
+                    ),
+                    (format!("<div {many_attrs} class='c1 c2'>").as_str(), false),
+                ],
+            );
+
+            assert_attr_expr_matches_and_negation_reverses_match(
+                "[data-i]",
+                encoding,
+                &[
+                    (format!("<div {many_attrs}>").as_str(), true),
+                    (format!("<div {many_attrs} DATA-I>").as_str(), true),
+                ],
+            );
+        }
+    }
+
     #[test]
     fn generic_expressions() {
         for encoding in &ASCII_COMPATIBLE_ENCODINGS {
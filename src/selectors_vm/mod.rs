@@ -5,6 +5,7 @@ mod attribute_matcher;
 mod compiler;
 mod error;
 mod parser;
+mod payload_set;
 mod program;
 mod stack;
 
@@ -12,14 +13,18 @@ use self::program::AddressRange;
 use self::stack::StackDirective;
 use crate::html::{LocalName, Namespace};
 use crate::memory::{MemoryLimitExceededError, SharedMemoryLimiter};
+use crate::stats::SharedStats;
 use crate::transform_stream::AuxStartTagInfo;
 use encoding_rs::Encoding;
+use std::mem;
+use std::sync::Arc;
 
 pub use self::ast::*;
 pub(crate) use self::attribute_matcher::AttributeMatcher;
 pub(crate) use self::compiler::Compiler;
 pub use self::error::SelectorError;
 pub use self::parser::Selector;
+pub(crate) use self::payload_set::PayloadSet;
 pub(crate) use self::program::{ExecutionBranch, Program, TryExecResult};
 pub(crate) use self::stack::{ChildCounter, ElementData, Stack, StackItem};
 
@@ -64,7 +69,9 @@ struct HereditaryJumpPtr {
 }
 
 struct Bailout<T> {
-    at_addr: usize,
+    /// The instruction that requested attributes, if any. Entry points keyed by
+    /// the id or class request attributes without an instruction.
+    at_addr: Option<usize>,
     recovery_point: T,
 }
 
@@ -74,8 +81,29 @@ pub(crate) struct SelectorState<'i> {
     pub typed: Option<&'i ChildCounter>,
 }
 
+/// Jumps of the branches matched for an element. They are moved to the stack once
+/// the element is executed, so the VM reuses the buffers for all of the elements.
+#[derive(Default)]
+struct MatchedJumps {
+    jumps: Vec<AddressRange>,
+    hereditary_jumps: Vec<AddressRange>,
+    next_sibling_jumps: Vec<AddressRange>,
+    later_sibling_jumps: Vec<AddressRange>,
+}
+
+impl MatchedJumps {
+    #[inline]
+    fn clear(&mut self) {
+        self.jumps.clear();
+        self.hereditary_jumps.clear();
+        self.next_sibling_jumps.clear();
+        self.later_sibling_jumps.clear();
+    }
+}
+
 struct ExecutionCtx<'i, E: ElementData> {
     stack_item: StackItem<'i, E>,
+    matched_jumps: MatchedJumps,
     with_content: bool,
     ns: Namespace,
     enable_esi_tags: bool,
@@ -83,9 +111,15 @@ struct ExecutionCtx<'i, E: ElementData> {
 
 impl<'i, E: ElementData> ExecutionCtx<'i, E> {
     #[inline]
-    pub fn new(local_name: LocalName<'i>, ns: Namespace, enable_esi_tags: bool) -> Self {
+    pub fn new(
+        local_name: LocalName<'i>,
+        ns: Namespace,
+        enable_esi_tags: bool,
+        matched_jumps: MatchedJumps,
+    ) -> Self {
         ExecutionCtx {
             stack_item: StackItem::new(local_name),
+            matched_jumps,
             with_content: true,
             ns,
             enable_esi_tags,
@@ -97,26 +131,35 @@ impl<'i, E: ElementData> ExecutionCtx<'i, E> {
         branch: &ExecutionBranch<E::MatchPayload>,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) {
-        for &payload in &branch.matched_payload {
+        for &payload in &*branch.matched_payload {
             let element_payload = self.stack_item.element_data.matched_payload_mut();
 
-            if !element_payload.contains(&payload) {
+            if element_payload.insert(payload.into()) {
                 match_handler(MatchInfo {
                     payload,
                     with_content: self.with_content,
                 });
-
-                element_payload.insert(payload);
             }
         }
 
+        let matched_jumps = &mut self.matched_jumps;
+
+        // NOTE: siblings are matched even if the element doesn't have any content.
+        if let Some(ref jumps) = branch.next_sibling_jumps {
+            matched_jumps.next_sibling_jumps.push(jumps.to_owned());
+        }
+
+        if let Some(ref jumps) = branch.later_sibling_jumps {
+            matched_jumps.later_sibling_jumps.push(jumps.to_owned());
+        }
+
         if self.with_content {
             if let Some(ref jumps) = branch.jumps {
-                self.stack_item.jumps.push(jumps.to_owned());
+                matched_jumps.jumps.push(jumps.to_owned());
             }
 
             if let Some(ref hereditary_jumps) = branch.hereditary_jumps {
-                self.stack_item
+                matched_jumps
                     .hereditary_jumps
                     .push(hereditary_jumps.to_owned());
             }
@@ -127,6 +170,7 @@ impl<'i, E: ElementData> ExecutionCtx<'i, E> {
     pub fn into_owned(self) -> ExecutionCtx<'static, E> {
         ExecutionCtx {
             stack_item: self.stack_item.into_owned(),
+            matched_jumps: self.matched_jumps,
             with_content: self.with_content,
             ns: self.ns,
             enable_esi_tags: self.enable_esi_tags,
@@ -141,9 +185,11 @@ macro_rules! aux_info_request {
 }
 
 pub(crate) struct SelectorMatchingVm<E: ElementData> {
-    program: Program<E::MatchPayload>,
+    program: Arc<Program<E::MatchPayload>>,
     stack: Stack<E>,
+    matched_jumps_buffer: MatchedJumps,
     enable_esi_tags: bool,
+    stats: SharedStats,
 }
 
 impl<E> SelectorMatchingVm<E>
@@ -157,17 +203,40 @@ where
         encoding: &'static Encoding,
         memory_limiter: SharedMemoryLimiter,
         enable_esi_tags: bool,
+        stats: SharedStats,
     ) -> Self {
         let program = Compiler::new(encoding).compile(ast);
+
+        Self::with_program(Arc::new(program), memory_limiter, enable_esi_tags, stats)
+    }
+
+    /// Creates a VM for a program that has been compiled ahead of time and
+    /// can be shared with other VMs.
+    #[inline]
+    #[must_use]
+    pub fn with_program(
+        program: Arc<Program<E::MatchPayload>>,
+        memory_limiter: SharedMemoryLimiter,
+        enable_esi_tags: bool,
+        stats: SharedStats,
+    ) -> Self {
         let enable_nth_of_type = program.enable_nth_of_type;
 
         Self {
             program,
             enable_esi_tags,
             stack: Stack::new(memory_limiter, enable_nth_of_type),
+            matched_jumps_buffer: MatchedJumps::default(),
+            stats,
         }
     }
 
+    /// Discards the open element stack, so the VM can be used for another document.
+    #[inline]
+    pub fn reset(&mut self) {
+        self.stack.clear();
+    }
+
     pub fn exec_for_start_tag(
         &mut self,
         local_name: LocalName<'_>,
@@ -178,7 +247,12 @@ where
 
         self.stack.add_child(&local_name);
 
-        let mut ctx = ExecutionCtx::new(local_name, ns, self.enable_esi_tags);
+        let mut ctx = ExecutionCtx::new(
+            local_name,
+            ns,
+            self.enable_esi_tags,
+            mem::take(&mut self.matched_jumps_buffer),
+        );
 
         match Stack::get_stack_directive(&ctx.stack_item, ns, ctx.enable_esi_tags) {
             PopImmediately => {
@@ -221,16 +295,17 @@ where
 
         ctx.with_content = !aux_info.self_closing;
 
-        self.exec_instr_set_with_attrs(
-            &self.program.entry_points,
+        self.exec_entry_points_with_attrs(&attr_matcher, &mut ctx, 0, match_handler);
+
+        self.exec_jumps_with_attrs(&attr_matcher, &mut ctx, JumpPtr::default(), match_handler);
+
+        self.exec_sibling_jumps_with_attrs(
             &attr_matcher,
             &mut ctx,
-            0,
+            JumpPtr::default(),
             match_handler,
         );
 
-        self.exec_jumps_with_attrs(&attr_matcher, &mut ctx, JumpPtr::default(), match_handler);
-
         self.exec_hereditary_jumps_with_attrs(
             &attr_matcher,
             &mut ctx,
@@ -238,29 +313,67 @@ where
             match_handler,
         );
 
-        if ctx.with_content {
-            self.stack.push_item(ctx.stack_item)?;
+        self.complete_execution(ctx)
+    }
+
+    /// Records the sibling jumps of the executed element and pushes it to the stack
+    /// if it has content.
+    #[inline]
+    fn complete_execution(
+        &mut self,
+        ctx: ExecutionCtx<'_, E>,
+    ) -> Result<(), MemoryLimitExceededError> {
+        let ExecutionCtx {
+            stack_item,
+            mut matched_jumps,
+            with_content,
+            ..
+        } = ctx;
+
+        if self.program.enable_sibling_jumps {
+            self.stack.add_sibling_jumps(
+                matched_jumps.next_sibling_jumps.drain(..),
+                matched_jumps.later_sibling_jumps.drain(..),
+            );
         }
 
-        Ok(())
+        let res = if with_content {
+            self.stack.push_item(
+                stack_item.into_owned(),
+                &matched_jumps.jumps,
+                &matched_jumps.hereditary_jumps,
+            )
+        } else {
+            Ok(())
+        };
+
+        matched_jumps.clear();
+        self.matched_jumps_buffer = matched_jumps;
+
+        res
     }
 
     fn bailout<T: 'static + Send>(
+        &self,
         ctx: ExecutionCtx<'_, E>,
         bailout: Bailout<T>,
         recovery_point_handler: RecoveryPointHandler<T, E, E::MatchPayload>,
     ) -> Result<(), VmError<E, E::MatchPayload>> {
         let mut ctx = ctx.into_owned();
 
+        self.stats.add_selector_vm_bailout();
+
         aux_info_request!(move |this, aux_info, match_handler| {
             let attr_matcher = AttributeMatcher::new(*aux_info.input, aux_info.attr_buffer, ctx.ns);
 
-            this.complete_instr_execution_with_attrs(
-                bailout.at_addr,
-                &attr_matcher,
-                &mut ctx,
-                match_handler,
-            );
+            if let Some(at_addr) = bailout.at_addr {
+                this.complete_instr_execution_with_attrs(
+                    at_addr,
+                    &attr_matcher,
+                    &mut ctx,
+                    match_handler,
+                );
+            }
 
             recovery_point_handler(
                 this,
@@ -270,11 +383,7 @@ where
                 match_handler,
             );
 
-            if ctx.with_content {
-                this.stack.push_item(ctx.stack_item)?;
-            }
-
-            Ok(())
+            this.complete_execution(ctx)
         })
     }
 
@@ -285,15 +394,30 @@ where
         recovery_point: usize,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) {
-        self.exec_instr_set_with_attrs(
-            &self.program.entry_points,
+        self.exec_entry_points_with_attrs(attr_matcher, ctx, recovery_point, match_handler);
+
+        self.exec_jumps_with_attrs(attr_matcher, ctx, JumpPtr::default(), match_handler);
+
+        self.exec_sibling_jumps_with_attrs(attr_matcher, ctx, JumpPtr::default(), match_handler);
+
+        self.exec_hereditary_jumps_with_attrs(
             attr_matcher,
             ctx,
-            recovery_point,
+            HereditaryJumpPtr::default(),
             match_handler,
         );
+    }
 
-        self.exec_jumps_with_attrs(attr_matcher, ctx, JumpPtr::default(), match_handler);
+    fn recover_after_bailout_in_jumps(
+        &mut self,
+        ctx: &mut ExecutionCtx<'static, E>,
+        attr_matcher: &AttributeMatcher<'_>,
+        recovery_point: JumpPtr,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) {
+        self.exec_jumps_with_attrs(attr_matcher, ctx, recovery_point, match_handler);
+
+        self.exec_sibling_jumps_with_attrs(attr_matcher, ctx, JumpPtr::default(), match_handler);
 
         self.exec_hereditary_jumps_with_attrs(
             attr_matcher,
@@ -303,14 +427,14 @@ where
         );
     }
 
-    fn recover_after_bailout_in_jumps(
+    fn recover_after_bailout_in_sibling_jumps(
         &mut self,
         ctx: &mut ExecutionCtx<'static, E>,
         attr_matcher: &AttributeMatcher<'_>,
         recovery_point: JumpPtr,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) {
-        self.exec_jumps_with_attrs(attr_matcher, ctx, recovery_point, match_handler);
+        self.exec_sibling_jumps_with_attrs(attr_matcher, ctx, recovery_point, match_handler);
 
         self.exec_hereditary_jumps_with_attrs(
             attr_matcher,
@@ -336,29 +460,24 @@ where
         mut ctx: ExecutionCtx<'_, E>,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) -> Result<(), VmError<E, E::MatchPayload>> {
-        if let Err(b) = self.try_exec_instr_set_without_attrs(
-            self.program.entry_points.clone(),
-            &mut ctx,
-            match_handler,
-        ) {
-            return Self::bailout(ctx, b, Self::recover_after_bailout_in_entry_points);
+        if let Err(b) = self.try_exec_entry_points_without_attrs(&mut ctx, match_handler) {
+            return self.bailout(ctx, b, Self::recover_after_bailout_in_entry_points);
         }
 
         if let Err(b) = self.try_exec_jumps_without_attrs(&mut ctx, match_handler) {
-            return Self::bailout(ctx, b, Self::recover_after_bailout_in_jumps);
+            return self.bailout(ctx, b, Self::recover_after_bailout_in_jumps);
         }
 
-        if let Err(b) = self.try_exec_hereditary_jumps_without_attrs(&mut ctx, match_handler) {
-            return Self::bailout(ctx, b, Self::recover_after_bailout_in_hereditary_jumps);
+        if let Err(b) = self.try_exec_sibling_jumps_without_attrs(&mut ctx, match_handler) {
+            return self.bailout(ctx, b, Self::recover_after_bailout_in_sibling_jumps);
         }
 
-        if ctx.with_content {
-            self.stack
-                .push_item(ctx.stack_item.into_owned())
-                .map_err(VmError::MemoryLimitExceeded)
-        } else {
-            Ok(())
+        if let Err(b) = self.try_exec_hereditary_jumps_without_attrs(&mut ctx, match_handler) {
+            return self.bailout(ctx, b, Self::recover_after_bailout_in_hereditary_jumps);
         }
+
+        self.complete_execution(ctx)
+            .map_err(VmError::MemoryLimitExceeded)
     }
 
     #[inline]
@@ -377,25 +496,26 @@ where
         }
     }
 
+    /// Executes the instructions at `addrs` until one of them requires attributes. The recovery
+    /// point of the bailout is the number of instructions that don't need to be executed again.
     #[inline]
     fn try_exec_instr_set_without_attrs(
         &self,
-        addr_range: AddressRange,
+        addrs: impl Iterator<Item = usize>,
         ctx: &mut ExecutionCtx<'_, E>,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) -> Result<(), Bailout<usize>> {
-        let start = addr_range.start;
         let state = self.stack.build_state(&ctx.stack_item.local_name);
 
-        for addr in addr_range {
+        for (i, addr) in addrs.enumerate() {
             match self.program.instructions[addr]
                 .try_exec_without_attrs(&state, &ctx.stack_item.local_name)
             {
                 TryExecResult::Branch(branch) => ctx.add_execution_branch(branch, match_handler),
                 TryExecResult::AttributesRequired => {
                     return Err(Bailout {
-                        at_addr: addr,
-                        recovery_point: addr - start + 1,
+                        at_addr: Some(addr),
+                        recovery_point: i + 1,
                     });
                 }
                 TryExecResult::Fail => (),
@@ -413,9 +533,26 @@ where
         ctx: &mut ExecutionCtx<'_, E>,
         offset: usize,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) {
+        self.exec_instrs_with_attrs(
+            addr_range.start + offset..addr_range.end,
+            attr_matcher,
+            ctx,
+            match_handler,
+        );
+    }
+
+    #[inline]
+    fn exec_instrs_with_attrs(
+        &self,
+        addrs: impl Iterator<Item = usize>,
+        attr_matcher: &AttributeMatcher<'_>,
+        ctx: &mut ExecutionCtx<'_, E>,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) {
         let state = self.stack.build_state(&ctx.stack_item.local_name);
-        for addr in addr_range.start + offset..addr_range.end {
+
+        for addr in addrs {
             let instr = &self.program.instructions[addr];
 
             if let Some(branch) = instr.exec(&state, &ctx.stack_item.local_name, attr_matcher) {
@@ -424,13 +561,79 @@ where
         }
     }
 
+    fn try_exec_entry_points_without_attrs(
+        &self,
+        ctx: &mut ExecutionCtx<'_, E>,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) -> Result<(), Bailout<usize>> {
+        let index = &self.program.entry_point_index;
+        let candidates = index.local_name_candidates(&ctx.stack_item.local_name);
+
+        self.try_exec_instr_set_without_attrs(
+            candidates.into_iter().flatten().copied(),
+            ctx,
+            match_handler,
+        )?;
+
+        // NOTE: instructions keyed by the id or class can only be found once
+        // attributes are available.
+        if index.has_attribute_keys() {
+            Err(Bailout {
+                at_addr: None,
+                recovery_point: candidates.iter().map(|c| c.len()).sum(),
+            })
+        } else {
+            Ok(())
+        }
+    }
+
+    fn exec_entry_points_with_attrs(
+        &self,
+        attr_matcher: &AttributeMatcher<'_>,
+        ctx: &mut ExecutionCtx<'_, E>,
+        offset: usize,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) {
+        let index = &self.program.entry_point_index;
+        let candidates = index.local_name_candidates(&ctx.stack_item.local_name);
+
+        self.exec_instrs_with_attrs(
+            candidates.into_iter().flatten().copied().skip(offset),
+            attr_matcher,
+            ctx,
+            match_handler,
+        );
+
+        if let Some(addrs) = attr_matcher.id().and_then(|id| index.by_id.get(id)) {
+            self.exec_instrs_with_attrs(addrs.iter().copied(), attr_matcher, ctx, match_handler);
+        }
+
+        if !index.by_class.is_empty() {
+            for (i, class) in attr_matcher.classes().enumerate() {
+                // NOTE: skip repeated class names, so instructions are not executed twice.
+                if attr_matcher.classes().take(i).any(|c| c == class) {
+                    continue;
+                }
+
+                if let Some(addrs) = index.by_class.get(class) {
+                    self.exec_instrs_with_attrs(
+                        addrs.iter().copied(),
+                        attr_matcher,
+                        ctx,
+                        match_handler,
+                    );
+                }
+            }
+        }
+    }
+
     fn try_exec_jumps_without_attrs(
         &self,
         ctx: &mut ExecutionCtx<'_, E>,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) -> Result<(), Bailout<JumpPtr>> {
         if let Some(parent) = self.stack.items().last() {
-            for (i, jumps) in parent.jumps.iter().enumerate() {
+            for (i, jumps) in self.stack.jumps(parent).iter().enumerate() {
                 self.try_exec_instr_set_without_attrs(jumps.clone(), ctx, match_handler)
                     .map_err(|b| Bailout {
                         at_addr: b.at_addr,
@@ -454,7 +657,9 @@ where
     ) {
         // NOTE: find pointed jumps instruction set and execute it with the offset.
         if let Some(parent) = self.stack.items().last() {
-            if let Some(ptr_jumps) = parent.jumps.get(ptr.instr_set_idx) {
+            let parent_jumps = self.stack.jumps(parent);
+
+            if let Some(ptr_jumps) = parent_jumps.get(ptr.instr_set_idx) {
                 self.exec_instr_set_with_attrs(
                     ptr_jumps,
                     attr_matcher,
@@ -464,20 +669,73 @@ where
                 );
 
                 // NOTE: execute remaining jumps instruction sets as usual.
-                for jumps in parent.jumps.iter().skip(ptr.instr_set_idx + 1) {
+                for jumps in parent_jumps.iter().skip(ptr.instr_set_idx + 1) {
                     self.exec_instr_set_with_attrs(jumps, attr_matcher, ctx, 0, match_handler);
                 }
             }
         }
     }
 
+    fn try_exec_sibling_jumps_without_attrs(
+        &self,
+        ctx: &mut ExecutionCtx<'_, E>,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) -> Result<(), Bailout<JumpPtr>> {
+        if !self.program.enable_sibling_jumps {
+            return Ok(());
+        }
+
+        for (i, jumps) in self.stack.sibling_jumps().iter().enumerate() {
+            self.try_exec_instr_set_without_attrs(jumps.clone(), ctx, match_handler)
+                .map_err(|b| Bailout {
+                    at_addr: b.at_addr,
+                    recovery_point: JumpPtr {
+                        instr_set_idx: i,
+                        offset: b.recovery_point,
+                    },
+                })?;
+        }
+
+        Ok(())
+    }
+
+    fn exec_sibling_jumps_with_attrs(
+        &self,
+        attr_matcher: &AttributeMatcher<'_>,
+        ctx: &mut ExecutionCtx<'_, E>,
+        ptr: JumpPtr,
+        match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
+    ) {
+        if !self.program.enable_sibling_jumps {
+            return;
+        }
+
+        // NOTE: execute the pointed instruction set with the offset and the remaining
+        // ones as usual.
+        for (i, jumps) in self
+            .stack
+            .sibling_jumps()
+            .iter()
+            .enumerate()
+            .skip(ptr.instr_set_idx)
+        {
+            let offset = if i == ptr.instr_set_idx {
+                ptr.offset
+            } else {
+                0
+            };
+
+            self.exec_instr_set_with_attrs(jumps, attr_matcher, ctx, offset, match_handler);
+        }
+    }
+
     fn try_exec_hereditary_jumps_without_attrs(
         &self,
         ctx: &mut ExecutionCtx<'_, E>,
         match_handler: &mut dyn FnMut(MatchInfo<E::MatchPayload>),
     ) -> Result<(), Bailout<HereditaryJumpPtr>> {
         for (i, ancestor) in self.stack.items().iter().rev().enumerate() {
-            for (j, jumps) in ancestor.hereditary_jumps.iter().enumerate() {
+            for (j, jumps) in self.stack.hereditary_jumps(ancestor).iter().enumerate() {
                 self.try_exec_instr_set_without_attrs(jumps.clone(), ctx, match_handler)
                     .map_err(move |b| Bailout {
                         at_addr: b.at_addr,
@@ -515,7 +773,9 @@ where
         // NOTE: first find pointed ancestor, then jump instruction
         // set and execute it with the offset.
         if let Some(ptr_ancestor) = items.get(ptr_ancestor_idx) {
-            if let Some(ptr_jumps) = ptr_ancestor.hereditary_jumps.get(ptr.instr_set_idx) {
+            let ptr_ancestor_jumps = self.stack.hereditary_jumps(ptr_ancestor);
+
+            if let Some(ptr_jumps) = ptr_ancestor_jumps.get(ptr.instr_set_idx) {
                 self.exec_instr_set_with_attrs(
                     ptr_jumps,
                     attr_matcher,
@@ -525,11 +785,7 @@ where
                 );
 
                 // NOTE: execute the rest of jump instruction sets in the pointed ancestor as usual.
-                for jumps in ptr_ancestor
-                    .hereditary_jumps
-                    .iter()
-                    .skip(ptr.instr_set_idx + 1)
-                {
+                for jumps in ptr_ancestor_jumps.iter().skip(ptr.instr_set_idx + 1) {
                     self.exec_instr_set_with_attrs(jumps, attr_matcher, ctx, 0, match_handler);
                 }
             }
@@ -537,7 +793,7 @@ where
             // NOTE: execute hereditary jumps in remaining ancestors as usual.
             if ptr_ancestor.has_ancestor_with_hereditary_jumps {
                 for ancestor in items.iter().rev().skip(ptr.stack_offset + 1) {
-                    for jumps in &ancestor.hereditary_jumps {
+                    for jumps in self.stack.hereditary_jumps(ancestor) {
                         self.exec_instr_set_with_attrs(jumps, attr_matcher, ctx, 0, match_handler);
                     }
 
@@ -573,12 +829,12 @@ mod tests {
     }
 
     #[derive(Default)]
-    struct TestElementData(HashSet<usize>);
+    struct TestElementData(PayloadSet);
 
     impl ElementData for TestElementData {
         type MatchPayload = usize;
 
-        fn matched_payload_mut(&mut self) -> &mut HashSet<usize> {
+        fn matched_payload_mut(&mut self) -> &mut PayloadSet {
             &mut self.0
         }
     }
@@ -598,7 +854,7 @@ mod tests {
             Ok(TokenCaptureFlags::NEXT_START_TAG)
         }
 
-        fn handle_end_tag(&mut self, _: LocalName<'_>) -> TokenCaptureFlags {
+        fn handle_end_tag(&mut self, _: LocalName<'_>, _: Namespace) -> TokenCaptureFlags {
             TokenCaptureFlags::all()
         }
 
@@ -638,9 +894,15 @@ mod tests {
             transform_controller: TestTransformController(test_fn),
             output_sink: |_: &[u8]| {},
             preallocated_parsing_buffer_size: 0,
+            text_decoder_buffer_size: 1024,
             encoding: SharedEncoding::new(AsciiCompatibleEncoding::new(encoding).unwrap()),
+            input_encoding: None,
+            buffer_pool: None,
+            parsing_buffer_histogram: None,
+            disable_output: false,
             memory_limiter: SharedMemoryLimiter::new(2048),
             strict: true,
+            stats: SharedStats::default(),
         });
 
         transform_stream.write(&html).unwrap();
@@ -676,8 +938,13 @@ mod tests {
 
             let memory_limiter = SharedMemoryLimiter::new(2048);
             let enable_esi_tags = false;
-            let vm: SelectorMatchingVm<TestElementData> =
-                SelectorMatchingVm::new(ast, UTF_8, memory_limiter, enable_esi_tags);
+            let vm: SelectorMatchingVm<TestElementData> = SelectorMatchingVm::new(
+                ast,
+                UTF_8,
+                memory_limiter,
+                enable_esi_tags,
+                SharedStats::default(),
+            );
 
             vm
         }};
@@ -742,7 +1009,7 @@ mod tests {
                     let mut unmatched_payload = HashMap::default();
 
                     $vm.exec_for_end_tag(local_name!(t), |elem_data: TestElementData| {
-                        for payload in elem_data.0 {
+                        for payload in elem_data.0.iter() {
                             unmatched_payload
                                 .entry(payload)
                                 .and_modify(|c| *c += 1)
@@ -995,6 +1262,55 @@ mod tests {
         );
     }
 
+    #[test]
+    fn entry_points_by_id_and_class() {
+        let mut vm = create_vm!(&["#foo", ".bar", "div.bar", "*", "span#foo.baz"]);
+
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<div class='bar bar'>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![1, 2, 3],
+            }
+        );
+
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<span id=foo class=baz>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![0, 3, 4],
+            }
+        );
+
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p id=foo class='qux bar'>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![0, 1, 3],
+            }
+        );
+
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p id=qux>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![3],
+            }
+        );
+    }
+
     #[test]
     fn nth_child() {
         let mut vm = create_vm!(&["div:first-child", "div:nth-child(2n+1)"]);
@@ -1629,6 +1945,203 @@ mod tests {
         exec_for_end_tag_and_assert!(vm, "</body>", map![(0, 3), (1, 1), (2, 2)]);
     }
 
+    #[test]
+    fn sibling_jumps() {
+        let mut vm = create_vm!(&["h2 + p", "h2 ~ p", "img + img"]);
+
+        // Stack after:
+        // - <div>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<div>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        // - <h2>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<h2>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        // - <h2>
+        // - <p>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        exec_for_end_tag_and_assert!(vm, "</h2>", map![]);
+
+        // Stack after:
+        // - <div>
+        // - <p> (0, 1)
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![0, 1],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        exec_for_end_tag_and_assert!(vm, "</p>", map![(0, 1), (1, 1)]);
+
+        // Stack after:
+        // - <div>
+        // - <p> (1)
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![1],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        exec_for_end_tag_and_assert!(vm, "</p>", map![(1, 1)]);
+
+        // Stack after:
+        // - <div>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<img>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: false,
+                matched_payload: set![],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<img>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: false,
+                matched_payload: set![2],
+            }
+        );
+
+        // Stack after:
+        // - <div>
+        // - <p> (1)
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![1],
+            }
+        );
+
+        // Stack after:
+        // Stack after is empty
+        exec_for_end_tag_and_assert!(vm, "</div>", map![(1, 1)]);
+
+        // NOTE: siblings of the <div> haven't been matched.
+        // Stack after:
+        // - <p>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![],
+            }
+        );
+    }
+
+    #[test]
+    fn bailout_in_sibling_jumps() {
+        let mut vm = create_vm!(&["div + p[foo]", "div ~ .c1", "div + p"]);
+
+        // Stack after:
+        // - <div>
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<div>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: false,
+                should_match_with_content: true,
+                matched_payload: set![],
+            }
+        );
+
+        // Stack after:
+        // Stack after is empty
+        exec_for_end_tag_and_assert!(vm, "</div>", map![]);
+
+        // Stack after:
+        // - <p foo class=c1> (0, 1, 2)
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p foo class=c1>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![0, 1, 2],
+            }
+        );
+
+        // Stack after:
+        // Stack after is empty
+        exec_for_end_tag_and_assert!(vm, "</p>", map![(0, 1), (1, 1), (2, 1)]);
+
+        // Stack after:
+        // - <p foo class=c1> (1)
+        exec_for_start_tag_and_assert!(
+            vm,
+            "<p foo class=c1>",
+            Namespace::Html,
+            Expectation {
+                should_bailout: true,
+                should_match_with_content: true,
+                matched_payload: set![1],
+            }
+        );
+    }
+
     #[test]
     fn compound_selector() {
         let mut vm = create_vm!(&["body > span#foo .c1 .c2"]);
@@ -125,12 +125,13 @@ impl SelectorsParser {
         match component {
             Component::Combinator(combinator) => match combinator {
                 // Supported
-                Combinator::Child | Combinator::Descendant => Ok(()),
+                Combinator::Child
+                | Combinator::Descendant
+                | Combinator::NextSibling
+                | Combinator::LaterSibling => Ok(()),
 
                 // Unsupported
                 Combinator::Part => Err(SelectorError::UnsupportedPseudoClassOrElement),
-                Combinator::NextSibling => Err(SelectorError::UnsupportedCombinator('+')),
-                Combinator::LaterSibling => Err(SelectorError::UnsupportedCombinator('~')),
                 Combinator::PseudoElement | Combinator::SlotAssignment => {
                     Err(SelectorError::UnsupportedPseudoClassOrElement)
                 }
@@ -273,12 +274,14 @@ impl<'i> Parser<'i> for SelectorsParser {
 /// <code>E\[foo&#124;="en"\]</code> | an `E` element whose foo attribute value is a hyphen-separated list of values beginning with `"en"`                         |
 /// `E F`                          | an `F` element descendant of an `E` element                                                                                 |
 /// `E > F`                        | an `F` element child of an `E` element                                                                                      |
+/// `E + F`                        | an `F` element immediately preceded by an `E` element sibling                                                               |
+/// `E ~ F`                        | an `F` element preceded by an `E` element sibling                                                                           |
 ///
 /// [`str`]: https://doc.rust-lang.org/std/primitive.str.html
 /// [`parse`]: https://doc.rust-lang.org/std/primitive.str.html#method.parse
 /// [element content handlers]: struct.Settings.html#structfield.element_content_handlers
 /// [`FromStr`]: https://doc.rust-lang.org/std/str/trait.FromStr.html
-#[derive(Clone, Debug)]
+#[derive(Clone, Debug, PartialEq, Eq)]
 pub struct Selector(pub(crate) SelectorList<SelectorImplDescriptor>);
 
 impl FromStr for Selector {
@@ -0,0 +1,101 @@
+const WORD_BITS: usize = u64::BITS as usize;
+
+/// A set of dense payload indices matched for an element.
+///
+/// Payloads are indices of selectors, so they are small and there are only a few of them per
+/// element. The first 64 of them are stored inline, which covers most of the real-world
+/// setups without any allocations, and the rest spill into a heap-allocated bitset.
+#[derive(Default, Debug, Clone, PartialEq, Eq)]
+pub(crate) struct PayloadSet {
+    inline: u64,
+    spilled: Box<[u64]>,
+}
+
+impl PayloadSet {
+    /// Adds the index to the set. Returns `true` if the index wasn't in the set before.
+    #[inline]
+    pub fn insert(&mut self, idx: usize) -> bool {
+        let word = if idx < WORD_BITS {
+            &mut self.inline
+        } else {
+            let word_idx = idx / WORD_BITS - 1;
+
+            if word_idx >= self.spilled.len() {
+                self.grow(word_idx + 1);
+            }
+
+            &mut self.spilled[word_idx]
+        };
+
+        let bit = 1 << (idx % WORD_BITS);
+        let is_new = *word & bit == 0;
+
+        *word |= bit;
+
+        is_new
+    }
+
+    #[cold]
+    fn grow(&mut self, word_count: usize) {
+        let mut spilled = std::mem::take(&mut self.spilled).into_vec();
+
+        spilled.resize(word_count, 0);
+        self.spilled = spilled.into_boxed_slice();
+    }
+
+    /// Returns the indices in the set in ascending order.
+    #[inline]
+    pub fn iter(&self) -> impl Iterator<Item = usize> + '_ {
+        std::iter::once(self.inline)
+            .chain(self.spilled.iter().copied())
+            .enumerate()
+            .flat_map(|(word_idx, mut word)| {
+                std::iter::from_fn(move || {
+                    if word == 0 {
+                        return None;
+                    }
+
+                    let bit_idx = word.trailing_zeros() as usize;
+
+                    // NOTE: clear the lowest set bit.
+                    word &= word - 1;
+
+                    Some(word_idx * WORD_BITS + bit_idx)
+                })
+            })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn inline_and_spilled_indices() {
+        let mut set = PayloadSet::default();
+
+        assert_eq!(set.iter().next(), None);
+
+        for idx in [3, 0, 63, 200, 64] {
+            assert!(set.insert(idx));
+        }
+
+        assert!(!set.insert(3));
+        assert!(!set.insert(200));
+
+        assert_eq!(set.iter().collect::<Vec<_>>(), [0, 3, 63, 64, 200]);
+        assert_eq!(set.spilled.len(), 3);
+    }
+
+    #[test]
+    fn inline_indices_dont_allocate() {
+        let mut set = PayloadSet::default();
+
+        for idx in 0..64 {
+            set.insert(idx);
+        }
+
+        assert!(set.spilled.is_empty());
+        assert_eq!(set.iter().count(), 64);
+    }
+}
@@ -1,8 +1,8 @@
 use super::attribute_matcher::AttributeMatcher;
 use super::compiler::{CompiledAttributeExpr, CompiledLocalNameExpr};
 use super::SelectorState;
-use crate::html::LocalName;
-use hashbrown::HashSet;
+use crate::html::{LocalName, LocalNameHash};
+use hashbrown::HashMap;
 use std::hash::Hash;
 use std::ops::Range;
 
@@ -13,9 +13,23 @@ pub(crate) struct ExecutionBranch<P>
 where
     P: Hash + Eq,
 {
-    pub matched_payload: HashSet<P>,
+    pub matched_payload: Box<[P]>,
     pub jumps: Option<AddressRange>,
     pub hereditary_jumps: Option<AddressRange>,
+    /// Instructions to execute for the next element sibling of the matched element.
+    pub next_sibling_jumps: Option<AddressRange>,
+    /// Instructions to execute for all of the following element siblings of the matched element.
+    pub later_sibling_jumps: Option<AddressRange>,
+}
+
+impl<P> ExecutionBranch<P>
+where
+    P: Hash + Eq,
+{
+    #[inline]
+    pub fn has_sibling_jumps(&self) -> bool {
+        self.next_sibling_jumps.is_some() || self.later_sibling_jumps.is_some()
+    }
 }
 
 /// The result of trying to execute an instruction without having parsed all attributes
@@ -89,13 +103,50 @@ where
     }
 }
 
+/// Addresses of the entry point instructions grouped by the tag name, id or class that an
+/// element is required to have to be matched by them. This allows to skip instructions
+/// that can't match an element without executing them.
+#[derive(Default)]
+pub(crate) struct EntryPointIndex {
+    /// Instructions that can't be grouped by any of the keys.
+    pub generic: Box<[usize]>,
+    pub by_local_name: HashMap<LocalNameHash, Box<[usize]>>,
+    pub by_id: HashMap<Box<[u8]>, Box<[usize]>>,
+    pub by_class: HashMap<Box<[u8]>, Box<[usize]>>,
+}
+
+impl EntryPointIndex {
+    /// Returns the instructions that can match an element with the `local_name` and don't
+    /// need its attributes to be looked up in the index.
+    #[inline]
+    pub fn local_name_candidates(&self, local_name: &LocalName<'_>) -> [&[usize]; 2] {
+        let by_local_name = match local_name {
+            LocalName::Hash(hash) => self.by_local_name.get(hash).map_or(&[][..], |a| a),
+            LocalName::Bytes(_) => &[],
+        };
+
+        [&self.generic, by_local_name]
+    }
+
+    /// Returns `true` if there are instructions that can only be found with the
+    /// element's id or classes.
+    #[inline]
+    pub fn has_attribute_keys(&self) -> bool {
+        !self.by_id.is_empty() || !self.by_class.is_empty()
+    }
+}
+
 pub(crate) struct Program<P>
 where
     P: Hash + Eq,
 {
     pub instructions: Box<[Instruction<P>]>,
     pub entry_points: AddressRange,
+    pub entry_point_index: EntryPointIndex,
     /// Enables tracking child types for nth-of-type selectors.
     /// This is disabled if no nth-of-type selectors are used in the program.
     pub enable_nth_of_type: bool,
+    /// Enables tracking of the preceding siblings for `+` and `~` combinators.
+    /// This is disabled if no sibling combinators are used in the program.
+    pub enable_sibling_jumps: bool,
 }
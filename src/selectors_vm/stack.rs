@@ -1,12 +1,13 @@
 use super::ast::NthChild;
 use super::program::AddressRange;
-use super::SelectorState;
+use super::{PayloadSet, SelectorState};
 use crate::html::{LocalName, Namespace, Tag};
 use crate::memory::{LimitedVec, MemoryLimitExceededError, SharedMemoryLimiter};
 // use hashbrown for raw entry, switch back to std once it stablizes there
-use hashbrown::{hash_map::RawEntryMut, HashMap, HashSet};
+use hashbrown::{hash_map::RawEntryMut, HashMap};
 use std::fmt::Debug;
 use std::hash::{BuildHasher, Hash};
+use std::ops::Range;
 
 #[inline]
 fn is_void_element(local_name: &LocalName<'_>, enable_esi_tags: bool) -> bool {
@@ -38,9 +39,11 @@ fn is_void_element(local_name: &LocalName<'_>, enable_esi_tags: bool) -> bool {
 }
 
 pub(crate) trait ElementData: Default + 'static {
-    type MatchPayload: PartialEq + Eq + Copy + Debug + Hash + 'static;
+    /// A dense index (e.g. the index of the selector), so matched payloads can be stored
+    /// in a bitset.
+    type MatchPayload: PartialEq + Eq + Copy + Debug + Hash + Into<usize> + 'static;
 
-    fn matched_payload_mut(&mut self) -> &mut HashSet<Self::MatchPayload>;
+    fn matched_payload_mut(&mut self) -> &mut PayloadSet;
 }
 
 pub(crate) enum StackDirective {
@@ -147,6 +150,11 @@ impl TypedChildCounterMap {
         });
     }
 
+    #[inline]
+    pub fn clear(&mut self) {
+        self.0.clear();
+    }
+
     #[inline]
     pub fn get<'a, 'i>(&'a self, name: &LocalName<'i>, index: usize) -> Option<&'i ChildCounter>
     where
@@ -166,14 +174,62 @@ impl TypedChildCounterMap {
     }
 }
 
+/// Instructions to execute for the following element children of a stack item, added by
+/// its children matched with a branch that has `+` or `~` combinators.
+#[derive(Default)]
+pub(crate) struct SiblingJumps {
+    /// Jumps of the last element child, applied only to the next one.
+    next: Vec<AddressRange>,
+    /// Jumps of all of the previous element children.
+    later: Vec<AddressRange>,
+}
+
+impl SiblingJumps {
+    #[inline]
+    pub fn iter(&self) -> impl Iterator<Item = &AddressRange> {
+        self.next.iter().chain(self.later.iter())
+    }
+
+    #[inline]
+    fn clear(&mut self) {
+        self.next.clear();
+        self.later.clear();
+    }
+}
+
+/// The location of the jumps of a stack item in the jumps arena of the stack.
+///
+/// Items are pushed and popped in the stack order, so jumps of all of the items are stored in
+/// one arena, each item's jumps followed by its hereditary jumps. This keeps the items small,
+/// and doesn't require allocations for every element that is matched by a branch with jumps.
+///
+/// NOTE: offsets are 32-bit, the memory limiter kicks in long before the arena gets that large.
+#[derive(Default, Clone, Copy)]
+struct JumpsLocation {
+    start: u32,
+    hereditary_start: u32,
+    end: u32,
+}
+
+impl JumpsLocation {
+    #[inline]
+    const fn jumps(self) -> Range<usize> {
+        self.start as usize..self.hereditary_start as usize
+    }
+
+    #[inline]
+    const fn hereditary_jumps(self) -> Range<usize> {
+        self.hereditary_start as usize..self.end as usize
+    }
+}
+
 pub(crate) struct StackItem<'i, E: ElementData> {
     pub local_name: LocalName<'i>,
     pub element_data: E,
-    pub jumps: Vec<AddressRange>,
-    pub hereditary_jumps: Vec<AddressRange>,
     pub child_counter: ChildCounter,
+    pub sibling_jumps: SiblingJumps,
     pub has_ancestor_with_hereditary_jumps: bool,
-    pub stack_directive: StackDirective,
+    jumps_location: JumpsLocation,
 }
 
 impl<'i, E: ElementData> StackItem<'i, E> {
@@ -183,11 +239,10 @@ impl<'i, E: ElementData> StackItem<'i, E> {
         StackItem {
             local_name,
             element_data: E::default(),
-            jumps: Vec::default(),
-            hereditary_jumps: Vec::default(),
             child_counter: Default::default(),
+            sibling_jumps: SiblingJumps::default(),
             has_ancestor_with_hereditary_jumps: false,
-            stack_directive: StackDirective::Push,
+            jumps_location: JumpsLocation::default(),
         }
     }
 
@@ -196,13 +251,17 @@ impl<'i, E: ElementData> StackItem<'i, E> {
         StackItem {
             local_name: self.local_name.into_owned(),
             element_data: self.element_data,
-            jumps: self.jumps,
-            hereditary_jumps: self.hereditary_jumps,
             child_counter: self.child_counter,
+            sibling_jumps: self.sibling_jumps,
             has_ancestor_with_hereditary_jumps: self.has_ancestor_with_hereditary_jumps,
-            stack_directive: self.stack_directive,
+            jumps_location: self.jumps_location,
         }
     }
+
+    #[inline]
+    const fn has_hereditary_jumps(&self) -> bool {
+        self.jumps_location.end > self.jumps_location.hereditary_start
+    }
 }
 
 pub(crate) struct Stack<E: ElementData> {
@@ -210,7 +269,11 @@ pub(crate) struct Stack<E: ElementData> {
     root_child_counter: ChildCounter,
     /// A typed counter for all elements on all frames. This is optional to indicate if types are actually being counted.
     typed_child_counters: Option<TypedChildCounterMap>,
+    /// Sibling jumps for root elements
+    root_sibling_jumps: SiblingJumps,
     items: LimitedVec<StackItem<'static, E>>,
+    /// Jumps and hereditary jumps of all of the items, see `JumpsLocation`.
+    jumps_arena: LimitedVec<AddressRange>,
 }
 
 impl<E: ElementData> Stack<E> {
@@ -223,7 +286,9 @@ impl<E: ElementData> Stack<E> {
             } else {
                 None
             },
-            items: LimitedVec::new(memory_limiter),
+            root_sibling_jumps: SiblingJumps::default(),
+            items: LimitedVec::new(memory_limiter.clone()),
+            jumps_arena: LimitedVec::new(memory_limiter),
         }
     }
 
@@ -240,6 +305,40 @@ impl<E: ElementData> Stack<E> {
         }
     }
 
+    /// Returns the sibling jumps that apply to the element that is about to be pushed.
+    #[inline]
+    #[must_use]
+    pub fn sibling_jumps(&self) -> &SiblingJumps {
+        self.items
+            .last()
+            .map_or(&self.root_sibling_jumps, |last| &last.sibling_jumps)
+    }
+
+    /// Records the sibling jumps of an element for its following siblings. Called for
+    /// each element, before it is pushed to the stack, so the jumps for the next sibling
+    /// are replaced even if the element hasn't been matched.
+    pub fn add_sibling_jumps(
+        &mut self,
+        next: impl Iterator<Item = AddressRange>,
+        later: impl Iterator<Item = AddressRange>,
+    ) {
+        let sibling_jumps = match self.items.last_mut() {
+            Some(last) => &mut last.sibling_jumps,
+            None => &mut self.root_sibling_jumps,
+        };
+
+        sibling_jumps.next.clear();
+        sibling_jumps.next.extend(next);
+
+        for jumps in later {
+            // NOTE: the same elements tend to match the same branches, so without
+            // deduplication the list would grow with the number of siblings.
+            if !sibling_jumps.later.contains(&jumps) {
+                sibling_jumps.later.push(jumps);
+            }
+        }
+    }
+
     #[must_use]
     pub fn build_state<'a, 'i>(&'a self, name: &LocalName<'i>) -> SelectorState<'i>
     where
@@ -289,6 +388,10 @@ impl<E: ElementData> Stack<E> {
             if let Some(c) = self.typed_child_counters.as_mut() {
                 c.pop_to(index);
             }
+
+            let jumps_start = self.items[index].jumps_location.start as usize;
+
+            self.jumps_arena.drain(jumps_start..);
             self.items
                 .drain(index..)
                 .map(|i| i.element_data)
@@ -296,6 +399,19 @@ impl<E: ElementData> Stack<E> {
         }
     }
 
+    /// Pops all of the items and resets child counters, keeping the allocated memory.
+    pub fn clear(&mut self) {
+        self.root_child_counter = Default::default();
+        self.root_sibling_jumps.clear();
+
+        if let Some(c) = self.typed_child_counters.as_mut() {
+            c.clear();
+        }
+
+        self.items.drain(..);
+        self.jumps_arena.drain(..);
+    }
+
     #[inline]
     #[must_use]
     pub fn items(&self) -> &[StackItem<'_, E>] {
@@ -307,19 +423,55 @@ impl<E: ElementData> Stack<E> {
         self.items.last_mut().map(|i| &mut i.element_data)
     }
 
+    /// Returns the jumps of the item, executed for its element children.
+    #[inline]
+    #[must_use]
+    pub fn jumps(&self, item: &StackItem<'_, E>) -> &[AddressRange] {
+        &(*self.jumps_arena)[item.jumps_location.jumps()]
+    }
+
+    /// Returns the hereditary jumps of the item, executed for all of its descendants.
+    #[inline]
+    #[must_use]
+    pub fn hereditary_jumps(&self, item: &StackItem<'_, E>) -> &[AddressRange] {
+        &(*self.jumps_arena)[item.jumps_location.hereditary_jumps()]
+    }
+
     #[inline]
     pub fn push_item(
         &mut self,
         mut item: StackItem<'static, E>,
+        jumps: &[AddressRange],
+        hereditary_jumps: &[AddressRange],
     ) -> Result<(), MemoryLimitExceededError> {
         if let Some(last) = self.items.last() {
-            if last.has_ancestor_with_hereditary_jumps || !last.hereditary_jumps.is_empty() {
+            if last.has_ancestor_with_hereditary_jumps || last.has_hereditary_jumps() {
                 item.has_ancestor_with_hereditary_jumps = true;
             }
         }
 
-        self.items.push(item)?;
-        Ok(())
+        let start = self.jumps_arena.len();
+
+        let res = self
+            .jumps_arena
+            .extend_from_slice(jumps)
+            .and_then(|()| self.jumps_arena.extend_from_slice(hereditary_jumps))
+            .and_then(|()| {
+                item.jumps_location = JumpsLocation {
+                    start: start as u32,
+                    hereditary_start: (start + jumps.len()) as u32,
+                    end: self.jumps_arena.len() as u32,
+                };
+
+                self.items.push(item)
+            });
+
+        // NOTE: the arena shouldn't keep the jumps of an item that isn't on the stack.
+        if res.is_err() {
+            self.jumps_arena.drain(start..);
+        }
+
+        res
     }
 }
 
@@ -328,14 +480,15 @@ mod tests {
     use super::*;
     use crate::memory::SharedMemoryLimiter;
     use encoding_rs::UTF_8;
+    use std::iter;
 
     #[derive(Default)]
     struct TestElementData(usize);
 
     impl ElementData for TestElementData {
-        type MatchPayload = ();
+        type MatchPayload = usize;
 
-        fn matched_payload_mut(&mut self) -> &mut HashSet<()> {
+        fn matched_payload_mut(&mut self) -> &mut PayloadSet {
             unreachable!();
         }
     }
@@ -357,17 +510,12 @@ mod tests {
     fn hereditary_jumps_flag() {
         let mut stack = Stack::new(SharedMemoryLimiter::new(2048), false);
 
-        stack.push_item(item("item1", 0)).unwrap();
+        stack.push_item(item("item1", 0), &[], &[]).unwrap();
 
-        let mut item2 = item("item2", 1);
-        item2.hereditary_jumps.push(0..0);
-        stack.push_item(item2).unwrap();
+        stack.push_item(item("item2", 1), &[], &[0..0]).unwrap();
+        stack.push_item(item("item3", 2), &[], &[0..0]).unwrap();
 
-        let mut item3 = item("item3", 2);
-        item3.hereditary_jumps.push(0..0);
-        stack.push_item(item3).unwrap();
-
-        stack.push_item(item("item4", 3)).unwrap();
+        stack.push_item(item("item4", 3), &[], &[]).unwrap();
 
         assert_eq!(
             stack
@@ -379,17 +527,48 @@ mod tests {
         );
     }
 
+    #[test]
+    fn sibling_jumps() {
+        let mut stack = Stack::new(SharedMemoryLimiter::new(2048), false);
+
+        let sibling_jumps = |stack: &Stack<TestElementData>| {
+            stack.sibling_jumps().iter().cloned().collect::<Vec<_>>()
+        };
+
+        stack.add_sibling_jumps([0..1].into_iter(), [1..2].into_iter());
+        stack.add_sibling_jumps([2..3].into_iter(), [1..2].into_iter());
+
+        assert_eq!(sibling_jumps(&stack), [2..3, 1..2]);
+
+        stack.push_item(item("item1", 0), &[], &[]).unwrap();
+
+        assert!(sibling_jumps(&stack).is_empty());
+
+        stack.add_sibling_jumps([3..4].into_iter(), [4..5].into_iter());
+        stack.add_sibling_jumps(iter::empty(), [5..6].into_iter());
+
+        assert_eq!(sibling_jumps(&stack), [4..5, 5..6]);
+
+        stack.pop_up_to(local_name("item1"), |_| {});
+
+        assert_eq!(sibling_jumps(&stack), [2..3, 1..2]);
+
+        stack.clear();
+
+        assert!(sibling_jumps(&stack).is_empty());
+    }
+
     #[test]
     fn pop_up_to() {
         macro_rules! assert_pop_result {
             ($up_to:expr, $expected_unmatched:expr, $expected_items:expr) => {{
                 let mut stack = Stack::new(SharedMemoryLimiter::new(2048), false);
 
-                stack.push_item(item("html", 0)).unwrap();
-                stack.push_item(item("body", 1)).unwrap();
-                stack.push_item(item("div", 2)).unwrap();
-                stack.push_item(item("div", 3)).unwrap();
-                stack.push_item(item("span", 4)).unwrap();
+                stack.push_item(item("html", 0), &[], &[]).unwrap();
+                stack.push_item(item("body", 1), &[], &[]).unwrap();
+                stack.push_item(item("div", 2), &[], &[]).unwrap();
+                stack.push_item(item("div", 3), &[], &[]).unwrap();
+                stack.push_item(item("span", 4), &[], &[]).unwrap();
 
                 let mut unmatched = Vec::default();
 
@@ -435,4 +614,62 @@ mod tests {
         assert!(!handler_called);
         assert_eq!(stack.items().len(), 0);
     }
+
+    #[test]
+    fn jumps_arena() {
+        let mut stack = Stack::new(SharedMemoryLimiter::new(2048), false);
+
+        let jumps = |stack: &Stack<TestElementData>| {
+            stack
+                .items()
+                .iter()
+                .map(|i| (stack.jumps(i).to_vec(), stack.hereditary_jumps(i).to_vec()))
+                .collect::<Vec<_>>()
+        };
+
+        stack.push_item(item("div", 0), &[0..1, 1..2], &[]).unwrap();
+        stack.push_item(item("span", 1), &[], &[]).unwrap();
+        stack
+            .push_item(item("p", 2), &[2..3], &[3..4, 4..5])
+            .unwrap();
+
+        assert_eq!(
+            jumps(&stack),
+            [
+                (vec![0..1, 1..2], vec![]),
+                (vec![], vec![]),
+                (vec![2..3], vec![3..4, 4..5]),
+            ]
+        );
+
+        stack.pop_up_to(local_name("span"), |_| {});
+        stack.push_item(item("a", 3), &[], &[5..6]).unwrap();
+
+        assert_eq!(
+            jumps(&stack),
+            [(vec![0..1, 1..2], vec![]), (vec![], vec![5..6])]
+        );
+
+        assert_eq!(stack.jumps_arena.len(), 3);
+
+        stack.clear();
+
+        assert_eq!(stack.jumps_arena.len(), 0);
+    }
+
+    #[test]
+    fn jumps_rollback_on_memory_limit() {
+        let limiter = SharedMemoryLimiter::new(2 * std::mem::size_of::<AddressRange>());
+        let mut stack = Stack::new(limiter.clone(), false);
+
+        // NOTE: the jumps fit, but the hereditary jumps exceed the limit.
+        let err = stack
+            .push_item(item("div", 0), &[0..1], &[1..2, 2..3])
+            .unwrap_err();
+
+        assert_eq!(err, MemoryLimitExceededError);
+        assert_eq!(stack.jumps_arena.len(), 0);
+        assert_eq!(stack.items().len(), 0);
+        assert_eq!(limiter.current_usage(), 0);
+    }
 }
@@ -0,0 +1,303 @@
+use crate::parser::ParserDirective;
+use cfg_if::cfg_if;
+
+cfg_if! {
+    if #[cfg(feature = "stats")] {
+        use std::sync::atomic::{AtomicU64, Ordering};
+        use std::sync::Arc;
+
+        /// Counters of the work done by an [`HtmlRewriter`].
+        ///
+        /// The stats are collected only if the rewriter has been created with
+        /// [`Settings::enable_stats`] and can be retrieved with [`HtmlRewriter::stats`]. They
+        /// are meant to explain where the rewriting time goes for a particular set of selectors
+        /// and documents, e.g. how much of the input had to be fully tokenized.
+        ///
+        /// [`HtmlRewriter`]: struct.HtmlRewriter.html
+        /// [`HtmlRewriter::stats`]: struct.HtmlRewriter.html#method.stats
+        /// [`Settings::enable_stats`]: struct.Settings.html#structfield.enable_stats
+        #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+        pub struct RewriterStats {
+            /// Number of input bytes consumed by the parser in the tag scanning mode, in which
+            /// only the tag names are parsed.
+            pub tag_scanner_bytes: u64,
+            /// Number of input bytes consumed by the parser in the lexing mode, in which all of
+            /// the content is tokenized.
+            pub lexer_bytes: u64,
+            /// Number of times the parser has switched between the tag scanning and the lexing modes.
+            pub parser_directive_switches: u64,
+            /// Number of times the selector matching VM has suspended the matching of a start
+            /// tag until its attributes are parsed.
+            pub selector_vm_bailouts: u64,
+            /// Number of start tags for which the attributes or the self-closing flag have been
+            /// requested from the parser.
+            pub aux_info_requests: u64,
+            /// The largest amount of input, in bytes, held in the parsing buffer.
+            pub parsing_buffer_high_water_mark: u64,
+            /// Number of input bytes copied to the parsing buffer, because they couldn't be
+            /// parsed until more input is written.
+            pub buffered_bytes: u64,
+            /// Number of text bytes decoded by the streaming decoder rather than by the fast
+            /// path for UTF-8 and ASCII text.
+            pub decoder_slow_path_bytes: u64,
+            /// Time spent in the content handlers, in nanoseconds. Only the invocations of
+            /// the handlers are timed, the parsing and the serialization of the content are not.
+            ///
+            /// Always zero on `wasm32-unknown-unknown`, where there is no clock.
+            pub handler_nanos: u64,
+        }
+
+        #[derive(Default)]
+        struct Counters {
+            tag_scanner_bytes: AtomicU64,
+            lexer_bytes: AtomicU64,
+            parser_directive_switches: AtomicU64,
+            selector_vm_bailouts: AtomicU64,
+            aux_info_requests: AtomicU64,
+            parsing_buffer_high_water_mark: AtomicU64,
+            buffered_bytes: AtomicU64,
+            decoder_slow_path_bytes: AtomicU64,
+            handler_nanos: AtomicU64,
+        }
+
+        macro_rules! record {
+            ($self:ident.$counter:ident.$op:ident($value:expr)) => {
+                if let Some(counters) = &$self.counters {
+                    counters
+                        .$counter
+                        .$op(u64::try_from($value).unwrap_or(u64::MAX), Ordering::Relaxed);
+                }
+            };
+        }
+    } else {
+        macro_rules! record {
+            ($self:ident.$counter:ident.$op:ident($value:expr)) => {
+                let _ = $value;
+            };
+        }
+    }
+}
+
+// NOTE: the counters are shared by all of the clones, so each component of the rewriter
+// can hold one. Recording methods are no-ops if the stats are disabled or the crate
+// is built without the `stats` feature, so they can be called unconditionally.
+// Pub only for integration tests
+#[derive(Clone, Default)]
+pub struct SharedStats {
+    #[cfg(feature = "stats")]
+    counters: Option<Arc<Counters>>,
+}
+
+impl SharedStats {
+    #[cfg(feature = "stats")]
+    #[must_use]
+    pub fn new(enabled: bool) -> Self {
+        Self {
+            counters: enabled.then(Arc::default),
+        }
+    }
+
+    #[inline]
+    pub(crate) fn add_parsed_bytes(&self, directive: ParserDirective, byte_count: usize) {
+        match directive {
+            ParserDirective::WherePossibleScanForTagsOnly => {
+                record!(self.tag_scanner_bytes.fetch_add(byte_count));
+            }
+            ParserDirective::Lex => {
+                record!(self.lexer_bytes.fetch_add(byte_count));
+            }
+        }
+    }
+
+    #[inline]
+    pub(crate) fn add_parser_directive_switch(&self) {
+        record!(self.parser_directive_switches.fetch_add(1u64));
+    }
+
+    #[inline]
+    pub(crate) fn add_selector_vm_bailout(&self) {
+        record!(self.selector_vm_bailouts.fetch_add(1u64));
+    }
+
+    #[inline]
+    pub(crate) fn add_aux_info_request(&self) {
+        record!(self.aux_info_requests.fetch_add(1u64));
+    }
+
+    #[inline]
+    pub(crate) fn update_parsing_buffer_high_water_mark(&self, byte_count: usize) {
+        record!(self.parsing_buffer_high_water_mark.fetch_max(byte_count));
+    }
+
+    #[inline]
+    pub(crate) fn add_buffered_bytes(&self, byte_count: usize) {
+        record!(self.buffered_bytes.fetch_add(byte_count));
+    }
+
+    #[inline]
+    pub(crate) fn add_decoder_slow_path_bytes(&self, byte_count: usize) {
+        record!(self.decoder_slow_path_bytes.fetch_add(byte_count));
+    }
+
+    /// Runs `f`, accounting the time it takes as the time spent in the content handlers.
+    #[inline]
+    pub(crate) fn time_handlers<T>(&self, f: impl FnOnce() -> T) -> T {
+        #[cfg(all(
+            feature = "stats",
+            not(all(target_arch = "wasm32", target_os = "unknown"))
+        ))]
+        {
+            if self.counters.is_some() {
+                let start = std::time::Instant::now();
+                let res = f();
+
+                record!(self.handler_nanos.fetch_add(start.elapsed().as_nanos()));
+
+                return res;
+            }
+        }
+
+        f()
+    }
+
+    #[cfg(feature = "stats")]
+    #[must_use]
+    pub fn snapshot(&self) -> Option<RewriterStats> {
+        self.counters.as_ref().map(|c| RewriterStats {
+            tag_scanner_bytes: c.tag_scanner_bytes.load(Ordering::Relaxed),
+            lexer_bytes: c.lexer_bytes.load(Ordering::Relaxed),
+            parser_directive_switches: c.parser_directive_switches.load(Ordering::Relaxed),
+            selector_vm_bailouts: c.selector_vm_bailouts.load(Ordering::Relaxed),
+            aux_info_requests: c.aux_info_requests.load(Ordering::Relaxed),
+            parsing_buffer_high_water_mark: c
+                .parsing_buffer_high_water_mark
+                .load(Ordering::Relaxed),
+            buffered_bytes: c.buffered_bytes.load(Ordering::Relaxed),
+            decoder_slow_path_bytes: c.decoder_slow_path_bytes.load(Ordering::Relaxed),
+            handler_nanos: c.handler_nanos.load(Ordering::Relaxed),
+        })
+    }
+}
+
+#[cfg(all(test, feature = "stats"))]
+mod tests {
+    use crate::{element, text, HtmlRewriter, RewriterStats, SanitizerPolicy, Settings};
+
+    fn rewrite_with_stats(settings: Settings<'_, '_>, chunks: &[&str]) -> Option<RewriterStats> {
+        let mut rewriter = HtmlRewriter::new(settings, |_: &[u8]| {});
+
+        for chunk in chunks {
+            rewriter.write(chunk.as_bytes()).unwrap();
+        }
+
+        rewriter.end_and_reset().unwrap();
+        rewriter.stats()
+    }
+
+    #[test]
+    fn disabled_stats() {
+        assert_eq!(rewrite_with_stats(Settings::new(), &["<div>"]), None);
+    }
+
+    #[test]
+    fn parser_stats() {
+        let html = "<div><span>abc</span></div>";
+
+        let stats = rewrite_with_stats(
+            Settings {
+                element_content_handlers: vec![text!("span", |_| Ok(()))],
+                enable_stats: true,
+                ..Settings::new()
+            },
+            &[html],
+        )
+        .unwrap();
+
+        assert_eq!(
+            stats.tag_scanner_bytes + stats.lexer_bytes,
+            html.len() as u64
+        );
+        assert!(stats.tag_scanner_bytes > 0);
+        assert!(stats.lexer_bytes > 0);
+        assert!(stats.parser_directive_switches >= 2);
+        assert_eq!(stats.decoder_slow_path_bytes, 0);
+    }
+
+    #[test]
+    fn selector_vm_stats() {
+        let stats = rewrite_with_stats(
+            Settings {
+                element_content_handlers: vec![element!("div[foo]", |_| Ok(()))],
+                enable_stats: true,
+                ..Settings::new()
+            },
+            &["<div foo><div></div></div><span></span>"],
+        )
+        .unwrap();
+
+        assert_eq!(stats.selector_vm_bailouts, 2);
+        assert_eq!(stats.aux_info_requests, 2);
+    }
+
+    #[test]
+    fn buffering_stats() {
+        let stats = rewrite_with_stats(
+            Settings {
+                enable_stats: true,
+                ..Settings::new()
+            },
+            &["abc<div", "></div>"],
+        )
+        .unwrap();
+
+        // NOTE: the unfinished tag is buffered first, then the next chunk is appended to it.
+        assert_eq!(stats.buffered_bytes, "<div></div>".len() as u64);
+        assert_eq!(
+            stats.parsing_buffer_high_water_mark,
+            "<div></div>".len() as u64
+        );
+    }
+
+    #[test]
+    fn handler_time_excludes_sanitizer() {
+        let stats = rewrite_with_stats(
+            Settings {
+                sanitizer: Some(SanitizerPolicy::new()),
+                enable_stats: true,
+                ..Settings::new()
+            },
+            &["<div><script>alert(1)</script>abc</div>"],
+        )
+        .unwrap();
+
+        // NOTE: the sanitizer handles every token, but there are no handlers to time.
+        assert_eq!(stats.handler_nanos, 0);
+    }
+
+    #[test]
+    fn stats_survive_reset() {
+        let mut rewriter = HtmlRewriter::new(
+            Settings {
+                element_content_handlers: vec![element!("*", |_| Ok(()))],
+                enable_stats: true,
+                ..Settings::new()
+            },
+            |_: &[u8]| {},
+        );
+
+        rewriter.write(b"<div></div>").unwrap();
+        rewriter.end_and_reset().unwrap();
+
+        let first = rewriter.stats().unwrap();
+
+        rewriter.write(b"<div></div>").unwrap();
+        rewriter.end_and_reset().unwrap();
+
+        let second = rewriter.stats().unwrap();
+
+        assert_eq!(
+            second.tag_scanner_bytes + second.lexer_bytes,
+            2 * (first.tag_scanner_bytes + first.lexer_bytes)
+        );
+    }
+}
@@ -0,0 +1,312 @@
+//! Rewriting of asynchronous streams of chunks with backpressure.
+
+use crate::errors::RewritingError;
+use crate::{HandlerTypes, HtmlRewriter, LocalHandlerTypes, OutputSink, Settings};
+use futures_core::{Stream, TryStream};
+use std::mem;
+use std::pin::Pin;
+use std::task::{Context, Poll};
+
+#[derive(Default)]
+struct OutputBuffer(Vec<u8>);
+
+impl OutputSink for OutputBuffer {
+    #[inline]
+    fn handle_chunk(&mut self, chunk: &[u8]) {
+        self.0.extend_from_slice(chunk);
+    }
+}
+
+/// A [`Stream`] of chunks rewritten from the input stream of chunks.
+///
+/// Unlike [`HtmlRewriter`], which passes the output to the [`OutputSink`] as soon as it's
+/// produced, the stream holds the output until it's polled. The input is written to the
+/// rewriter in slices of at most `max_buffered_output` bytes, and no more input is written once
+/// the held output reaches `max_buffered_output` bytes. So a slow consumer stops the parsing
+/// rather than making the output pile up in memory. The parser state is kept by the rewriter
+/// until the consumer catches up.
+///
+/// Since the output of a slice is added to the output that is already held, the stream can hold
+/// up to about twice `max_buffered_output` bytes, or more if the content handlers insert
+/// content.
+///
+/// Whatever output is available is also yielded when the input stream is pending, so
+/// the stream doesn't add latency while waiting for the input.
+///
+/// If the input stream fails, the output rewritten from the preceding input is yielded first,
+/// and then the error. If the rewriter fails, the error is yielded right away, since the output
+/// of the failed input is incomplete. The stream ends after the error.
+///
+/// # Example
+/// ```
+/// use futures::executor::block_on;
+/// use futures::stream::{self, TryStreamExt};
+/// use lol_html::stream::RewritingStream;
+/// use lol_html::{element, Settings};
+/// use std::error::Error;
+///
+/// let input = stream::iter([
+///     Ok::<_, Box<dyn Error + Send + Sync>>(&br#"<a hr"#[..]),
+///     Ok(&br#"ef="/">"#[..]),
+/// ]);
+///
+/// let output = RewritingStream::new(
+///     Settings {
+///         element_content_handlers: vec![element!("a[href]", |el| {
+///             el.set_attribute("rel", "noopener")?;
+///             Ok(())
+///         })],
+///         ..Settings::new()
+///     },
+///     input,
+///     4096,
+/// );
+///
+/// let output: Vec<Vec<u8>> = block_on(output.try_collect()).unwrap();
+///
+/// assert_eq!(output.concat(), br#"<a href="/" rel="noopener">"#);
+/// ```
+///
+/// [`Stream`]: https://docs.rs/futures-core/0.3/futures_core/stream/trait.Stream.html
+/// [`HtmlRewriter`]: ../struct.HtmlRewriter.html
+/// [`OutputSink`]: ../trait.OutputSink.html
+pub struct RewritingStream<'h, S: TryStream, H: HandlerTypes = LocalHandlerTypes> {
+    input: S,
+    // NOTE: `None` once the stream has ended.
+    rewriter: Option<HtmlRewriter<'h, OutputBuffer, H>>,
+    pending_input: Option<S::Ok>,
+    pending_input_pos: usize,
+    // NOTE: the input error that is yielded after the output preceding it.
+    pending_error: Option<S::Error>,
+    max_buffered_output: usize,
+}
+
+impl<'h, S, H> RewritingStream<'h, S, H>
+where
+    S: TryStream + Unpin,
+    S::Ok: AsRef<[u8]>,
+    S::Error: From<RewritingError>,
+    H: HandlerTypes,
+{
+    /// Creates a stream that rewrites the `input` with the provided `settings`.
+    ///
+    /// A `max_buffered_output` of `0` is treated as `1`.
+    pub fn new(settings: Settings<'h, '_, H>, input: S, max_buffered_output: usize) -> Self {
+        Self {
+            input,
+            rewriter: Some(HtmlRewriter::new(settings, OutputBuffer::default())),
+            pending_input: None,
+            pending_input_pos: 0,
+            pending_error: None,
+            max_buffered_output: max_buffered_output.max(1),
+        }
+    }
+
+    /// Writes the next slice of the pending input to the rewriter. Returns `false` if there is
+    /// no pending input.
+    fn write_pending_input(&mut self) -> Result<bool, RewritingError> {
+        let (Some(rewriter), Some(input)) = (&mut self.rewriter, &self.pending_input) else {
+            return Ok(false);
+        };
+
+        let input = input.as_ref();
+        let slice_end = input
+            .len()
+            .min(self.pending_input_pos + self.max_buffered_output);
+
+        rewriter.write(&input[self.pending_input_pos..slice_end])?;
+
+        if slice_end == input.len() {
+            self.pending_input = None;
+            self.pending_input_pos = 0;
+        } else {
+            self.pending_input_pos = slice_end;
+        }
+
+        Ok(true)
+    }
+
+    fn end(&mut self) -> Result<Vec<u8>, RewritingError> {
+        let Some(mut rewriter) = self.rewriter.take() else {
+            return Ok(Vec::new());
+        };
+
+        rewriter.end()?;
+
+        Ok(mem::take(&mut rewriter.output_sink_mut().0))
+    }
+}
+
+// NOTE: the fields are never pinned.
+impl<S: TryStream, H: HandlerTypes> Unpin for RewritingStream<'_, S, H> {}
+
+impl<S, H> Stream for RewritingStream<'_, S, H>
+where
+    S: TryStream + Unpin,
+    S::Ok: AsRef<[u8]>,
+    S::Error: From<RewritingError>,
+    H: HandlerTypes,
+{
+    type Item = Result<Vec<u8>, S::Error>;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let this = self.get_mut();
+
+        if let Some(e) = this.pending_error.take() {
+            return Poll::Ready(Some(Err(e)));
+        }
+
+        loop {
+            let Some(rewriter) = &mut this.rewriter else {
+                return Poll::Ready(None);
+            };
+
+            let output = &mut rewriter.output_sink_mut().0;
+
+            if output.len() >= this.max_buffered_output {
+                return Poll::Ready(Some(Ok(mem::take(output))));
+            }
+
+            match this.write_pending_input() {
+                Ok(true) => continue,
+                Ok(false) => (),
+                Err(e) => {
+                    this.rewriter = None;
+
+                    return Poll::Ready(Some(Err(e.into())));
+                }
+            }
+
+            match Pin::new(&mut this.input).try_poll_next(cx) {
+                Poll::Ready(Some(Ok(input))) => {
+                    this.pending_input = Some(input);
+                }
+                Poll::Ready(Some(Err(e))) => {
+                    let output = this
+                        .rewriter
+                        .take()
+                        .map(|mut rewriter| mem::take(&mut rewriter.output_sink_mut().0))
+                        .unwrap_or_default();
+
+                    if output.is_empty() {
+                        return Poll::Ready(Some(Err(e)));
+                    }
+
+                    this.pending_error = Some(e);
+
+                    return Poll::Ready(Some(Ok(output)));
+                }
+                Poll::Ready(None) => {
+                    return match this.end() {
+                        Ok(output) if output.is_empty() => Poll::Ready(None),
+                        Ok(output) => Poll::Ready(Some(Ok(output))),
+                        Err(e) => Poll::Ready(Some(Err(e.into()))),
+                    };
+                }
+                Poll::Pending => {
+                    let Some(rewriter) = &mut this.rewriter else {
+                        return Poll::Ready(None);
+                    };
+
+                    let output = mem::take(&mut rewriter.output_sink_mut().0);
+
+                    return if output.is_empty() {
+                        Poll::Pending
+                    } else {
+                        Poll::Ready(Some(Ok(output)))
+                    };
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::html_content::ContentType;
+    use crate::{element, text};
+    use futures::executor::block_on;
+    use futures::stream::{self, StreamExt};
+    use std::error::Error;
+
+    type BoxError = Box<dyn Error + Send + Sync>;
+
+    fn chunks(chunks: &[&str]) -> impl Stream<Item = Result<Vec<u8>, BoxError>> + Unpin {
+        stream::iter(
+            chunks
+                .iter()
+                .map(|c| Ok(c.as_bytes().to_vec()))
+                .collect::<Vec<_>>(),
+        )
+    }
+
+    #[test]
+    fn backpressure() {
+        const MAX_BUFFERED_OUTPUT: usize = 64;
+
+        let html = "<div>".repeat(100);
+
+        let settings = Settings {
+            element_content_handlers: vec![element!("div", |_| Ok(()))],
+            ..Settings::new()
+        };
+
+        let output = RewritingStream::new(settings, chunks(&[&html]), MAX_BUFFERED_OUTPUT);
+        let output = block_on(output.map(Result::unwrap).collect::<Vec<_>>());
+
+        // NOTE: the single input chunk is rewritten in several slices.
+        assert!(output.len() > 1);
+
+        for chunk in &output {
+            assert!(chunk.len() < 2 * MAX_BUFFERED_OUTPUT + "<div>".len());
+        }
+
+        assert_eq!(output.concat(), html.as_bytes());
+    }
+
+    #[test]
+    fn document_end() {
+        let settings = Settings {
+            element_content_handlers: vec![text!("p", |t| {
+                if t.last_in_text_node() {
+                    t.after("!", ContentType::Text);
+                }
+
+                Ok(())
+            })],
+            ..Settings::new()
+        };
+
+        let output = RewritingStream::new(settings, chunks(&["<p>foo", " bar"]), 1024);
+        let output = block_on(output.map(Result::unwrap).collect::<Vec<_>>());
+
+        assert_eq!(output.concat(), b"<p>foo bar!");
+    }
+
+    #[test]
+    fn input_error() {
+        let input = stream::iter([Ok(b"<div>".to_vec()), Err(BoxError::from("input error"))]);
+        let output = RewritingStream::new(Settings::new(), input, 1024);
+        let output = block_on(output.collect::<Vec<_>>());
+
+        // NOTE: the output of the input preceding the error is not lost.
+        assert_eq!(output.len(), 2);
+        assert_eq!(output[0].as_ref().unwrap(), b"<div>");
+        assert_eq!(output[1].as_ref().unwrap_err().to_string(), "input error");
+    }
+
+    #[test]
+    fn rewriting_error() {
+        let settings = Settings {
+            element_content_handlers: vec![element!("div", |_| Err("handler error".into()))],
+            ..Settings::new()
+        };
+
+        let output = RewritingStream::new(settings, chunks(&["<div>", "<div>"]), 1024);
+        let output = block_on(output.collect::<Vec<_>>());
+
+        assert_eq!(output.len(), 1);
+        assert_eq!(output[0].as_ref().unwrap_err().to_string(), "handler error");
+    }
+}
@@ -0,0 +1,480 @@
+//! Pull-based HTML tokenization for analysis tasks that don't need the rewriter's output.
+
+use crate::base::Range;
+use crate::errors::ParsingAmbiguityError;
+use crate::html::{LocalName, Namespace, TextType};
+use crate::parser::{
+    AttributeOutline, LexemeSink, NonTagContentLexeme, NonTagContentTokenOutline, Parser,
+    ParserDirective, ParserOutputSink, TagHintSink, TagLexeme, TagTokenOutline,
+};
+use crate::rewriter::RewritingError;
+use crate::stats::SharedStats;
+use std::slice;
+
+/// A token produced by the [`Tokenizer`]. All of the token parts are borrowed from the input
+/// and are in the document's encoding, character references are not decoded.
+#[derive(Debug, Clone)]
+pub enum Token<'i> {
+    /// A start tag, e.g. `<a href="/">`.
+    StartTag {
+        /// The tag name, as it appears in the input.
+        name: &'i [u8],
+        /// The tag attributes.
+        attributes: Attributes<'i>,
+        /// `true` if the tag is self-closing, e.g. `<br/>`.
+        self_closing: bool,
+    },
+    /// An end tag, e.g. `</a>`.
+    EndTag {
+        /// The tag name, as it appears in the input.
+        name: &'i [u8],
+    },
+    /// A piece of text. A text node of the document can be split into several pieces.
+    Text {
+        /// The text.
+        text: &'i [u8],
+        /// The type of the text, which determines how character references in it are treated.
+        text_type: TextType,
+    },
+    /// A comment, e.g. `<!-- foo -->`.
+    Comment {
+        /// The text of the comment, without the comment delimiters.
+        text: &'i [u8],
+    },
+    /// A document type declaration, e.g. `<!DOCTYPE html>`.
+    Doctype {
+        /// The doctype name.
+        name: Option<&'i [u8]>,
+        /// The doctype public identifier.
+        public_id: Option<&'i [u8]>,
+        /// The doctype system identifier.
+        system_id: Option<&'i [u8]>,
+        /// `true` if the doctype forces the quirks mode.
+        force_quirks: bool,
+    },
+}
+
+/// An iterator over the `(name, value)` pairs of the start tag attributes.
+///
+/// The values are borrowed from the input as is, without the quotes.
+#[derive(Debug, Clone)]
+pub struct Attributes<'i> {
+    input: &'i [u8],
+    outlines: slice::Iter<'i, AttributeOutline>,
+}
+
+impl<'i> Iterator for Attributes<'i> {
+    type Item = (&'i [u8], &'i [u8]);
+
+    #[inline]
+    fn next(&mut self) -> Option<Self::Item> {
+        self.outlines
+            .next()
+            .map(|a| (part(self.input, a.name), part(self.input, a.value)))
+    }
+
+    #[inline]
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        self.outlines.size_hint()
+    }
+}
+
+#[inline]
+fn part(input: &[u8], range: Range) -> &[u8] {
+    &input[range.start..range.end]
+}
+
+#[inline]
+fn opt_part(input: &[u8], range: Option<Range>) -> Option<&[u8]> {
+    range.map(|range| part(input, range))
+}
+
+enum TokenOutline {
+    StartTag {
+        name: Range,
+        // NOTE: range of the attribute outlines in the collector.
+        attributes: Range,
+        self_closing: bool,
+    },
+    EndTag {
+        name: Range,
+    },
+    Text {
+        text: Range,
+        text_type: TextType,
+    },
+    Comment {
+        text: Range,
+    },
+    Doctype {
+        name: Option<Range>,
+        public_id: Option<Range>,
+        system_id: Option<Range>,
+        force_quirks: bool,
+    },
+}
+
+/// Collects the outlines of the lexemes produced from the input chunk, so they can be
+/// iterated over once the chunk is parsed.
+#[derive(Default)]
+struct LexemeCollector {
+    tokens: Vec<TokenOutline>,
+    attributes: Vec<AttributeOutline>,
+}
+
+impl LexemeCollector {
+    #[inline]
+    fn clear(&mut self) {
+        self.tokens.clear();
+        self.attributes.clear();
+    }
+}
+
+impl LexemeSink for LexemeCollector {
+    fn handle_tag(&mut self, lexeme: &TagLexeme<'_>) -> Result<ParserDirective, RewritingError> {
+        self.tokens.push(match *lexeme.token_outline() {
+            TagTokenOutline::StartTag {
+                name,
+                ref attributes,
+                self_closing,
+                ..
+            } => {
+                let start = self.attributes.len();
+
+                self.attributes.extend_from_slice(attributes);
+
+                TokenOutline::StartTag {
+                    name,
+                    attributes: Range {
+                        start,
+                        end: self.attributes.len(),
+                    },
+                    self_closing,
+                }
+            }
+            TagTokenOutline::EndTag { name, .. } => TokenOutline::EndTag { name },
+        });
+
+        Ok(ParserDirective::Lex)
+    }
+
+    fn handle_non_tag_content(
+        &mut self,
+        lexeme: &NonTagContentLexeme<'_>,
+    ) -> Result<(), RewritingError> {
+        let token = match *lexeme.token_outline() {
+            Some(NonTagContentTokenOutline::Text(text_type)) => TokenOutline::Text {
+                text: lexeme.raw_range(),
+                text_type,
+            },
+            Some(NonTagContentTokenOutline::Comment(text)) => TokenOutline::Comment { text },
+            Some(NonTagContentTokenOutline::Doctype {
+                name,
+                public_id,
+                system_id,
+                force_quirks,
+            }) => TokenOutline::Doctype {
+                name,
+                public_id,
+                system_id,
+                force_quirks,
+            },
+            // NOTE: CDATA section delimiters and bogus end tags don't produce tokens.
+            Some(NonTagContentTokenOutline::Eof) | None => return Ok(()),
+        };
+
+        self.tokens.push(token);
+
+        Ok(())
+    }
+}
+
+// NOTE: the tokenizer always lexes, so the parser never switches to the tag scanner.
+impl TagHintSink for LexemeCollector {
+    fn handle_start_tag_hint(
+        &mut self,
+        _name: LocalName<'_>,
+        _ns: Namespace,
+    ) -> Result<ParserDirective, RewritingError> {
+        Ok(ParserDirective::Lex)
+    }
+
+    fn handle_end_tag_hint(
+        &mut self,
+        _name: LocalName<'_>,
+        _ns: Namespace,
+    ) -> Result<ParserDirective, RewritingError> {
+        Ok(ParserDirective::Lex)
+    }
+}
+
+impl ParserOutputSink for LexemeCollector {}
+
+/// A streaming HTML tokenizer.
+///
+/// Unlike [`HtmlRewriter`], which pushes the content to the handlers and serializes the
+/// output, the tokenizer lets the caller pull the tokens of each input chunk. Tokens are
+/// borrowed from the input chunk. Only a token that is split between chunks is copied,
+/// so it can be completed with the next chunk.
+///
+/// Text of `<script>`, `<style>` and other elements with text content is tokenized the same
+/// way the rewriter does it, by simulating the feedback of the tree builder. The input
+/// should be in an ASCII-compatible encoding.
+///
+/// # Example
+/// ```
+/// use lol_html::tokenizer::{Token, Tokenizer};
+///
+/// let mut tokenizer = Tokenizer::new(false);
+/// let mut links = vec![];
+///
+/// for chunk in [&b"<a hr"[..], b"ef=/foo><script>'<a href=/bar>'</script>"] {
+///     for token in tokenizer.feed(chunk).unwrap() {
+///         if let Token::StartTag { name: b"a", attributes, .. } = token {
+///             links.extend(attributes.filter(|(n, _)| n == b"href").map(|(_, v)| v.to_vec()));
+///         }
+///     }
+/// }
+///
+/// tokenizer.end().unwrap();
+///
+/// assert_eq!(links, [b"/foo"]);
+/// ```
+///
+/// [`HtmlRewriter`]: ../struct.HtmlRewriter.html
+pub struct Tokenizer {
+    parser: Parser<LexemeCollector>,
+    // NOTE: holds the input that hasn't been consumed by the parser yet, followed by the
+    // input consumed by the last call if the last input had to be buffered.
+    buffer: Vec<u8>,
+    consumed_buffer_len: usize,
+}
+
+impl Tokenizer {
+    /// Creates a tokenizer. If `strict` is `true`, the tokenizer bails out with an error
+    /// on the input whose tokenization can't be determined without the full tree builder.
+    /// See [`ParsingAmbiguityError`].
+    ///
+    /// [`ParsingAmbiguityError`]: ../errors/struct.ParsingAmbiguityError.html
+    #[must_use]
+    pub fn new(strict: bool) -> Self {
+        Self {
+            parser: Parser::new(
+                LexemeCollector::default(),
+                ParserDirective::Lex,
+                strict,
+                SharedStats::default(),
+            ),
+            buffer: Vec::new(),
+            consumed_buffer_len: 0,
+        }
+    }
+
+    /// Tokenizes the next chunk of the input and returns the tokens that have been completed.
+    pub fn feed<'t>(&'t mut self, chunk: &'t [u8]) -> Result<Tokens<'t>, ParsingAmbiguityError> {
+        self.buffer.drain(..self.consumed_buffer_len);
+        self.consumed_buffer_len = 0;
+
+        if self.buffer.is_empty() {
+            let consumed = Self::parse(&mut self.parser, chunk, false)?;
+
+            self.buffer.extend_from_slice(&chunk[consumed..]);
+
+            Ok(Tokens::new(chunk, self.parser.get_dispatcher()))
+        } else {
+            self.buffer.extend_from_slice(chunk);
+            self.consumed_buffer_len = Self::parse(&mut self.parser, &self.buffer, false)?;
+
+            Ok(Tokens::new(&self.buffer, self.parser.get_dispatcher()))
+        }
+    }
+
+    /// Tokenizes the rest of the input. The tokenizer should be [`reset`] before it's used
+    /// for another document.
+    ///
+    /// [`reset`]: #method.reset
+    pub fn end(&mut self) -> Result<Tokens<'_>, ParsingAmbiguityError> {
+        self.buffer.drain(..self.consumed_buffer_len);
+        self.consumed_buffer_len = self.buffer.len();
+
+        Self::parse(&mut self.parser, &self.buffer, true)?;
+
+        Ok(Tokens::new(&self.buffer, self.parser.get_dispatcher()))
+    }
+
+    /// Returns the tokenizer to its initial state, so it can be used for another document.
+    pub fn reset(&mut self) {
+        self.parser.reset(ParserDirective::Lex);
+        self.parser.get_dispatcher().clear();
+        self.buffer.clear();
+        self.consumed_buffer_len = 0;
+    }
+
+    fn parse(
+        parser: &mut Parser<LexemeCollector>,
+        input: &[u8],
+        last: bool,
+    ) -> Result<usize, ParsingAmbiguityError> {
+        parser.get_dispatcher().clear();
+
+        parser.parse(input, last).map_err(|e| match e {
+            RewritingError::ParsingAmbiguity(e) => e,
+            _ => unreachable!("Tokenizer can only fail on parsing ambiguity"),
+        })
+    }
+}
+
+/// An iterator over the tokens of an input chunk. See [`Tokenizer::feed`].
+pub struct Tokens<'t> {
+    input: &'t [u8],
+    outlines: slice::Iter<'t, TokenOutline>,
+    attributes: &'t [AttributeOutline],
+}
+
+impl<'t> Tokens<'t> {
+    #[inline]
+    fn new(input: &'t [u8], collector: &'t LexemeCollector) -> Self {
+        Self {
+            input,
+            outlines: collector.tokens.iter(),
+            attributes: &collector.attributes,
+        }
+    }
+}
+
+impl<'t> Iterator for Tokens<'t> {
+    type Item = Token<'t>;
+
+    fn next(&mut self) -> Option<Token<'t>> {
+        let input = self.input;
+
+        Some(match *self.outlines.next()? {
+            TokenOutline::StartTag {
+                name,
+                attributes,
+                self_closing,
+            } => Token::StartTag {
+                name: part(input, name),
+                attributes: Attributes {
+                    input,
+                    outlines: self.attributes[attributes.start..attributes.end].iter(),
+                },
+                self_closing,
+            },
+            TokenOutline::EndTag { name } => Token::EndTag {
+                name: part(input, name),
+            },
+            TokenOutline::Text { text, text_type } => Token::Text {
+                text: part(input, text),
+                text_type,
+            },
+            TokenOutline::Comment { text } => Token::Comment {
+                text: part(input, text),
+            },
+            TokenOutline::Doctype {
+                name,
+                public_id,
+                system_id,
+                force_quirks,
+            } => Token::Doctype {
+                name: opt_part(input, name),
+                public_id: opt_part(input, public_id),
+                system_id: opt_part(input, system_id),
+                force_quirks,
+            },
+        })
+    }
+
+    #[inline]
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        self.outlines.size_hint()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn tokenize(chunks: &[&[u8]]) -> Vec<String> {
+        let mut tokenizer = Tokenizer::new(false);
+        let mut tokens: Vec<String> = vec![];
+
+        let mut push = |t: Tokens<'_>| {
+            for token in t {
+                let token = match token {
+                    Token::StartTag {
+                        name, attributes, ..
+                    } => {
+                        let attrs: String = attributes
+                            .map(|(n, v)| format!(" {}={}", ascii(n), ascii(v)))
+                            .collect();
+
+                        format!("<{}{attrs}>", ascii(name))
+                    }
+                    Token::EndTag { name } => format!("</{}>", ascii(name)),
+                    Token::Comment { text } => format!("<!--{}-->", ascii(text)),
+                    Token::Doctype { name, .. } => format!("<!{}>", ascii(name.unwrap_or(b""))),
+                    Token::Text { text, .. } => {
+                        // NOTE: merge the pieces of the text nodes.
+                        match tokens.last_mut() {
+                            Some(last) if last.starts_with('#') => last.push_str(&ascii(text)),
+                            _ => tokens.push(format!("#{}", ascii(text))),
+                        }
+
+                        continue;
+                    }
+                };
+
+                tokens.push(token);
+            }
+        };
+
+        for chunk in chunks {
+            push(tokenizer.feed(chunk).unwrap());
+        }
+
+        push(tokenizer.end().unwrap());
+
+        tokens
+    }
+
+    fn ascii(bytes: &[u8]) -> String {
+        String::from_utf8(bytes.to_vec()).unwrap()
+    }
+
+    #[test]
+    fn tokens() {
+        let html = b"<!doctype html><a href='/foo' x>b</a><!-- c --><script><d></script>e";
+
+        let expected = [
+            "<!html>",
+            "<a href=/foo x=>",
+            "#b",
+            "</a>",
+            "<!-- c -->",
+            "<script>",
+            "#<d>",
+            "</script>",
+            "#e",
+        ];
+
+        assert_eq!(tokenize(&[html]), expected);
+
+        for split in 0..html.len() {
+            let (first, second) = html.split_at(split);
+
+            assert_eq!(tokenize(&[first, second]), expected, "split at {split}");
+        }
+    }
+
+    #[test]
+    fn strict_mode() {
+        let mut tokenizer = Tokenizer::new(true);
+
+        assert!(tokenizer.feed(b"<select><xmp>").is_err());
+
+        tokenizer.reset();
+
+        assert_eq!(tokenizer.feed(b"<xmp>").unwrap().count(), 1);
+    }
+}
@@ -0,0 +1,156 @@
+use super::OutputSink;
+
+/// An [`OutputSink`] adapter that coalesces output chunks of the rewriter into bigger ones.
+///
+/// The rewriter produces its output in lots of small chunks (e.g. a rewritten start tag can be
+/// emitted as several chunks). If handling of every chunk is costly (e.g. it involves a system
+/// call or a call across an FFI boundary), the output can be accumulated in a buffer instead and
+/// passed to the inner sink once the buffer is full.
+///
+/// Chunks that don't fit into the buffer even when it's empty are passed to the inner sink
+/// as is, right after the buffered output. The buffer is flushed when the last (empty) chunk of
+/// the output is received, so the inner sink gets the whole output before the last chunk.
+/// The output buffered for a document that is discarded by [`HtmlRewriter::reset`] is
+/// dropped without being passed to the inner sink.
+///
+/// # Example
+/// ```
+/// use lol_html::{element, BufferedOutputSink, HtmlRewriter, Settings};
+///
+/// let mut chunks = vec![];
+///
+/// {
+///     let mut rewriter = HtmlRewriter::new(
+///         Settings {
+///             element_content_handlers: vec![element!("a", |el| {
+///                 el.set_attribute("rel", "noopener")?;
+///                 Ok(())
+///             })],
+///             ..Settings::new()
+///         },
+///         BufferedOutputSink::new(4096, |c: &[u8]| chunks.push(c.to_vec())),
+///     );
+///
+///     rewriter.write(br#"<div><a href="/">foo</a></div>"#).unwrap();
+///     rewriter.end().unwrap();
+/// }
+///
+/// assert_eq!(
+///     chunks,
+///     [br#"<div><a href="/" rel="noopener">foo</a></div>"#.to_vec(), vec![]]
+/// );
+/// ```
+///
+/// [`OutputSink`]: trait.OutputSink.html
+/// [`HtmlRewriter::reset`]: struct.HtmlRewriter.html#method.reset
+pub struct BufferedOutputSink<O: OutputSink> {
+    inner: O,
+    buffer: Vec<u8>,
+    capacity: usize,
+}
+
+impl<O: OutputSink> BufferedOutputSink<O> {
+    /// Creates a sink that buffers up to `capacity` bytes of output before passing
+    /// it to the `inner` sink.
+    #[must_use]
+    pub fn new(capacity: usize, inner: O) -> Self {
+        Self {
+            inner,
+            buffer: Vec::with_capacity(capacity),
+            capacity,
+        }
+    }
+
+    /// Passes the buffered output to the inner sink.
+    pub fn flush(&mut self) {
+        if !self.buffer.is_empty() {
+            self.inner.handle_chunk(&self.buffer);
+            self.buffer.clear();
+        }
+    }
+
+    /// Returns a mutable reference to the inner sink.
+    pub fn get_mut(&mut self) -> &mut O {
+        &mut self.inner
+    }
+}
+
+impl<O: OutputSink> OutputSink for BufferedOutputSink<O> {
+    #[inline]
+    fn handle_chunk(&mut self, chunk: &[u8]) {
+        if !chunk.is_empty() && self.buffer.len() + chunk.len() <= self.capacity {
+            self.buffer.extend_from_slice(chunk);
+            return;
+        }
+
+        self.flush();
+
+        if !chunk.is_empty() && chunk.len() < self.capacity {
+            self.buffer.extend_from_slice(chunk);
+        } else {
+            self.inner.handle_chunk(chunk);
+        }
+    }
+
+    #[inline]
+    fn reset(&mut self) {
+        self.buffer.clear();
+        self.inner.reset();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn handle_chunks(capacity: usize, chunks: &[&str]) -> Vec<String> {
+        let mut output = vec![];
+        let mut sink = BufferedOutputSink::new(capacity, |c: &[u8]| {
+            output.push(String::from_utf8(c.to_vec()).unwrap());
+        });
+
+        for chunk in chunks {
+            sink.handle_chunk(chunk.as_bytes());
+        }
+
+        drop(sink);
+
+        output
+    }
+
+    #[test]
+    fn coalesce_chunks() {
+        assert_eq!(
+            handle_chunks(4, &["a", "bc", "d", "ef", "g", ""]),
+            ["abcd", "efg", ""]
+        );
+    }
+
+    #[test]
+    fn pass_through_large_chunks() {
+        assert_eq!(
+            handle_chunks(4, &["a", "bcdef", "g", "hijk", ""]),
+            ["a", "bcdef", "g", "hijk", ""]
+        );
+    }
+
+    #[test]
+    fn reset_discards_buffered_output() {
+        let mut output = vec![];
+        let mut sink = BufferedOutputSink::new(4, |c: &[u8]| output.push(c.to_vec()));
+
+        sink.handle_chunk(b"ab");
+        sink.reset();
+        sink.handle_chunk(b"cd");
+        sink.handle_chunk(b"");
+
+        drop(sink);
+
+        assert_eq!(output, [b"cd".to_vec(), vec![]]);
+    }
+
+    #[test]
+    fn zero_capacity() {
+        assert_eq!(handle_chunks(0, &["a", "bc", ""]), ["a", "bc", ""]);
+    }
+}
@@ -1,6 +1,8 @@
+use super::text_node_buffer::TextNodeBuffer;
 use crate::base::{Bytes, Range, SharedEncoding};
 use crate::html::{LocalName, Namespace};
 use crate::html_content::{TextChunk, TextType};
+use crate::memory::{BufferPool, SharedMemoryLimiter};
 use crate::parser::{
     AttributeBuffer, Lexeme, LexemeSink, NonTagContentLexeme, ParserDirective, ParserOutputSink,
     TagHintSink, TagLexeme, TagTokenOutline,
@@ -9,6 +11,7 @@ use crate::rewritable_units::TextDecoder;
 use crate::rewritable_units::ToTokenResult;
 use crate::rewritable_units::{DocumentEnd, Serialize, ToToken, Token, TokenCaptureFlags};
 use crate::rewriter::RewritingError;
+use crate::stats::SharedStats;
 use encoding_rs::Encoding;
 
 pub(crate) struct AuxStartTagInfo<'i> {
@@ -39,10 +42,25 @@ pub trait TransformController: Sized {
         name: LocalName<'_>,
         ns: Namespace,
     ) -> StartTagHandlingResult<Self>;
-    fn handle_end_tag(&mut self, name: LocalName<'_>) -> TokenCaptureFlags;
+    fn handle_end_tag(&mut self, name: LocalName<'_>, ns: Namespace) -> TokenCaptureFlags;
     fn handle_token(&mut self, token: &mut Token<'_>) -> Result<(), RewritingError>;
     fn handle_end(&mut self, document_end: &mut DocumentEnd<'_>) -> Result<(), RewritingError>;
     fn should_emit_content(&self) -> bool;
+
+    /// Returns the maximum size of a text node that should be passed to the text handlers as
+    /// a single chunk, or `None` if none of the active text handlers need whole text nodes.
+    fn whole_text_node_limit(&self) -> Option<usize> {
+        None
+    }
+
+    /// Returns `true` if the rest of the document can't be changed by the controller,
+    /// so it can be passed to the output without parsing.
+    fn is_exhausted(&self) -> bool {
+        false
+    }
+
+    /// Returns the controller to its initial state before the next document is processed.
+    fn reset(&mut self) {}
 }
 
 /// Defines an interface for the [`HtmlRewriter`]'s output.
@@ -58,6 +76,12 @@ pub trait OutputSink {
     /// # Note
     /// The last chunk of the output has zero length.
     fn handle_chunk(&mut self, chunk: &[u8]);
+
+    /// Discards the output of the current document buffered by the sink, if any.
+    ///
+    /// Called when the rewriter is reset. Does nothing by default.
+    #[inline]
+    fn reset(&mut self) {}
 }
 
 impl<F: FnMut(&[u8])> OutputSink for F {
@@ -83,6 +107,11 @@ struct DispatcherDelegate<C, O> {
     remaining_content_start: usize,
     capture_flags: TokenCaptureFlags,
     emission_enabled: bool,
+    // NOTE: unlike `emission_enabled`, which is toggled by the removal of the element
+    // content, disables the output for the whole document.
+    output_disabled: bool,
+    text_node_buffer: TextNodeBuffer,
+    stats: SharedStats,
 }
 
 impl<C, O> DispatcherDelegate<C, O>
@@ -90,10 +119,15 @@ where
     C: TransformController,
     O: OutputSink,
 {
+    #[inline]
+    const fn should_emit_output(&self) -> bool {
+        self.emission_enabled && !self.output_disabled
+    }
+
     fn flush_remaining_input(&mut self, input: &[u8], consumed_byte_count: usize) {
         let output = &input[self.remaining_content_start..consumed_byte_count];
 
-        if self.emission_enabled && !output.is_empty() {
+        if self.should_emit_output() && !output.is_empty() {
             self.output_sink.handle_chunk(output);
         }
 
@@ -103,9 +137,18 @@ where
     fn finish(&mut self, encoding: &'static Encoding, input: &[u8]) -> Result<(), RewritingError> {
         self.flush_remaining_input(input, input.len());
 
+        let transform_controller = &mut self.transform_controller;
+
+        if self.output_disabled {
+            let mut noop_sink = |_: &[u8]| {};
+            let mut document_end = DocumentEnd::new(&mut noop_sink, encoding);
+
+            return transform_controller.handle_end(&mut document_end);
+        }
+
         let mut document_end = DocumentEnd::new(&mut self.output_sink, encoding);
 
-        self.transform_controller.handle_end(&mut document_end)?;
+        transform_controller.handle_end(&mut document_end)?;
 
         // NOTE: output the finalizing chunk.
         self.output_sink.handle_chunk(&[]);
@@ -123,10 +166,12 @@ where
             end: lexeme_range.start,
         };
 
-        let chunk = lexeme.input().slice(chunk_range);
+        if self.should_emit_output() {
+            let chunk = lexeme.input().slice(chunk_range);
 
-        if self.emission_enabled && !chunk.is_empty() {
-            self.output_sink.handle_chunk(&chunk);
+            if !chunk.is_empty() {
+                self.output_sink.handle_chunk(&chunk);
+            }
         }
 
         lexeme_range.end
@@ -138,7 +183,7 @@ where
 
         self.transform_controller.handle_token(&mut token)?;
 
-        if self.emission_enabled {
+        if self.should_emit_output() {
             token.into_bytes(&mut |c| self.output_sink.handle_chunk(c))?;
         }
         Ok(())
@@ -150,6 +195,73 @@ where
         encoding: &'static Encoding,
         text_type: TextType,
         is_last_in_node: bool,
+    ) -> Result<(), RewritingError> {
+        let transform_controller = &self.transform_controller;
+        let max_size = self
+            .text_node_buffer
+            .max_size_for_chunk(is_last_in_node, || {
+                transform_controller.whole_text_node_limit()
+            });
+
+        match max_size {
+            Some(max_size) => {
+                self.buffer_text(text, encoding, text_type, is_last_in_node, max_size)
+            }
+            None => self.text_chunk_produced(text, encoding, text_type, is_last_in_node),
+        }
+    }
+
+    /// Buffers the text until the end of the text node, or until the buffered text
+    /// exceeds `max_size` bytes.
+    fn buffer_text(
+        &mut self,
+        text: &str,
+        encoding: &'static Encoding,
+        text_type: TextType,
+        is_last_in_node: bool,
+        max_size: usize,
+    ) -> Result<(), RewritingError> {
+        if !self.text_node_buffer.is_empty() && self.text_node_buffer.len() + text.len() > max_size
+        {
+            self.flush_text_node_buffer(encoding, text_type, false)?;
+        }
+
+        // NOTE: the text can't fit into the buffer anyway, so there is no point in copying it.
+        if text.len() > max_size {
+            return self.text_chunk_produced(text, encoding, text_type, is_last_in_node);
+        }
+
+        self.text_node_buffer
+            .push_str(text)
+            .map_err(RewritingError::MemoryLimitExceeded)?;
+
+        if is_last_in_node {
+            self.flush_text_node_buffer(encoding, text_type, true)?;
+        }
+
+        Ok(())
+    }
+
+    fn flush_text_node_buffer(
+        &mut self,
+        encoding: &'static Encoding,
+        text_type: TextType,
+        is_last_in_node: bool,
+    ) -> Result<(), RewritingError> {
+        let text = self.text_node_buffer.take();
+        let res = self.text_chunk_produced(&text, encoding, text_type, is_last_in_node);
+
+        self.text_node_buffer.restore(text);
+
+        res
+    }
+
+    fn text_chunk_produced(
+        &mut self,
+        text: &str,
+        encoding: &'static Encoding,
+        text_type: TextType,
+        is_last_in_node: bool,
     ) -> Result<(), RewritingError> {
         let mut token =
             Token::TextChunk(TextChunk::new(text, text_type, is_last_in_node, encoding));
@@ -158,7 +270,7 @@ where
 
         self.transform_controller.handle_token(&mut token)?;
 
-        if self.emission_enabled {
+        if self.should_emit_output() {
             token.into_bytes(&mut |c| self.output_sink.handle_chunk(c))?;
         }
         Ok(())
@@ -175,8 +287,23 @@ where
     C: TransformController,
     O: OutputSink,
 {
-    pub fn new(transform_controller: C, output_sink: O, encoding: SharedEncoding) -> Self {
+    pub fn new(
+        transform_controller: C,
+        output_sink: O,
+        encoding: SharedEncoding,
+        memory_limiter: SharedMemoryLimiter,
+        text_decoder_buffer_size: usize,
+        buffer_pool: Option<BufferPool>,
+        output_disabled: bool,
+        stats: SharedStats,
+    ) -> Self {
         let capture_flags = transform_controller.initial_capture_flags();
+        let text_decoder = TextDecoder::new(
+            SharedEncoding::clone(&encoding),
+            text_decoder_buffer_size,
+            buffer_pool,
+            stats.clone(),
+        );
 
         Self {
             delegate: DispatcherDelegate {
@@ -185,8 +312,11 @@ where
                 capture_flags,
                 remaining_content_start: 0,
                 emission_enabled: true,
+                output_disabled,
+                text_node_buffer: TextNodeBuffer::new(memory_limiter),
+                stats,
             },
-            text_decoder: TextDecoder::new(SharedEncoding::clone(&encoding)),
+            text_decoder,
             last_text_type: TextType::Data,
             encoding,
             got_flags_from_hint: false,
@@ -194,6 +324,29 @@ where
         }
     }
 
+    /// Returns the dispatcher to the state it had after construction. Must be
+    /// followed by the reset of the parser.
+    pub fn reset(&mut self) {
+        let delegate = &mut self.delegate;
+
+        delegate.transform_controller.reset();
+        delegate.capture_flags = delegate.transform_controller.initial_capture_flags();
+        delegate.remaining_content_start = 0;
+        delegate.emission_enabled = true;
+        delegate.text_node_buffer.reset();
+        delegate.output_sink.reset();
+
+        self.text_decoder.reset();
+        self.last_text_type = TextType::Data;
+        self.got_flags_from_hint = false;
+        self.pending_element_aux_info_req = None;
+    }
+
+    #[inline]
+    pub fn output_sink_mut(&mut self) -> &mut O {
+        &mut self.delegate.output_sink
+    }
+
     #[inline(never)]
     fn try_produce_token_from_lexeme<'i, T>(
         &mut self,
@@ -255,7 +408,7 @@ where
     }
 
     #[inline]
-    const fn get_next_parser_directive(&self) -> ParserDirective {
+    pub(super) const fn get_next_parser_directive(&self) -> ParserDirective {
         if !self.delegate.capture_flags.is_empty() {
             ParserDirective::Lex
         } else {
@@ -315,15 +468,21 @@ where
                     {
                         Ok(flags) => Ok(flags),
                         Err(DispatcherError::InfoRequest(aux_info_req)) => {
+                            self.delegate.stats.add_aux_info_request();
+
                             get_flags_from_aux_info_res!(aux_info_req, &attributes, self_closing)
                         }
                         Err(DispatcherError::RewritingError(e)) => Err(e),
                     }
                 }
 
-                TagTokenOutline::EndTag { name, name_hash } => {
+                TagTokenOutline::EndTag {
+                    name,
+                    name_hash,
+                    ns,
+                } => {
                     let name = LocalName::new(input, name, name_hash);
-                    Ok(self.delegate.transform_controller.handle_end_tag(name))
+                    Ok(self.delegate.transform_controller.handle_end_tag(name, ns))
                 }
             },
         };
@@ -364,6 +523,25 @@ where
     pub fn finish(&mut self, input: &[u8]) -> Result<(), RewritingError> {
         self.delegate.finish(self.encoding.get(), input)
     }
+
+    /// Returns `true` if the rest of the document can be passed through with
+    /// [`pass_through`](Self::pass_through). The pending captured text is emitted first.
+    pub fn try_finish_rewriting(&mut self) -> Result<bool, RewritingError> {
+        if !self.delegate.emission_enabled || !self.delegate.transform_controller.is_exhausted() {
+            return Ok(false);
+        }
+
+        self.flush_pending_captured_text()?;
+
+        Ok(true)
+    }
+
+    #[inline]
+    pub fn pass_through(&mut self, input: &[u8]) {
+        if !self.delegate.output_disabled && !input.is_empty() {
+            self.delegate.output_sink.handle_chunk(input);
+        }
+    }
 }
 
 impl<C, O> LexemeSink for Dispatcher<C, O>
@@ -426,6 +604,7 @@ where
                 Ok(self.apply_capture_flags_from_hint_and_get_next_parser_directive(flags))
             }
             Err(DispatcherError::InfoRequest(aux_info_req)) => {
+                self.delegate.stats.add_aux_info_request();
                 self.got_flags_from_hint = false;
                 self.pending_element_aux_info_req = Some(aux_info_req);
 
@@ -438,10 +617,11 @@ where
     fn handle_end_tag_hint(
         &mut self,
         name: LocalName<'_>,
+        ns: Namespace,
     ) -> Result<ParserDirective, RewritingError> {
         self.flush_pending_captured_text()?;
 
-        let mut flags = self.delegate.transform_controller.handle_end_tag(name);
+        let mut flags = self.delegate.transform_controller.handle_end_tag(name, ns);
 
         // NOTE: if emission was disabled (i.e. we've been removing element content)
         // we need to request the end tag lexeme, to ensure that we have it.
@@ -0,0 +1,118 @@
+use crate::memory::{MemoryLimitExceededError, SharedMemoryLimiter};
+use encoding_rs::{CoderResult, Decoder, Encoding};
+
+/// Decodes the input into UTF-8 before it gets to the parser.
+///
+/// Each input chunk is decoded as a whole, so the parser receives the same chunks it would
+/// receive without transcoding. The output buffer grows to fit the largest decoded chunk
+/// and is reused for the following chunks.
+pub(crate) struct InputTranscoder {
+    encoding: &'static Encoding,
+    decoder: Decoder,
+    buffer: Vec<u8>,
+    limiter: SharedMemoryLimiter,
+}
+
+impl InputTranscoder {
+    #[inline]
+    #[must_use]
+    pub fn new(encoding: &'static Encoding, limiter: SharedMemoryLimiter) -> Self {
+        Self {
+            encoding,
+            // NOTE: the decoder sniffs the BOM, same as the browsers do.
+            decoder: encoding.new_decoder(),
+            buffer: Vec::new(),
+            limiter,
+        }
+    }
+
+    /// Decodes the `input` chunk. Bytes of an incomplete character at the end of the
+    /// chunk are held back by the decoder until the next chunk, or until the `last` one.
+    pub fn transcode(
+        &mut self,
+        input: &[u8],
+        last: bool,
+    ) -> Result<&[u8], MemoryLimitExceededError> {
+        let max_len = self
+            .decoder
+            .max_utf8_buffer_length(input.len())
+            .ok_or(MemoryLimitExceededError)?;
+
+        if self.buffer.len() < max_len {
+            let additional = max_len - self.buffer.len();
+
+            self.limiter.increase_usage(additional)?;
+
+            self.buffer
+                .try_reserve_exact(additional)
+                .map_err(|_| MemoryLimitExceededError)?;
+
+            self.buffer.resize(max_len, 0);
+        }
+
+        let (status, read, written, _) = self.decoder.decode_to_utf8(input, &mut self.buffer, last);
+
+        debug_assert_eq!(status, CoderResult::InputEmpty);
+        debug_assert_eq!(read, input.len());
+
+        Ok(&self.buffer[..written])
+    }
+
+    /// Drops the decoder state, keeping the output buffer.
+    #[inline]
+    pub fn reset(&mut self) {
+        self.decoder = self.encoding.new_decoder();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use encoding_rs::{SHIFT_JIS, UTF_16LE};
+
+    #[test]
+    fn utf16_input() {
+        let mut transcoder = InputTranscoder::new(UTF_16LE, SharedMemoryLimiter::new(usize::MAX));
+
+        // NOTE: the chunk boundary splits the code unit of "é".
+        assert_eq!(
+            transcoder.transcode(b"<\0p\0>\0\xe9", false),
+            Ok(&b"<p>"[..])
+        );
+        assert_eq!(
+            transcoder.transcode(b"\0<\0/\0p\0>\0", false),
+            Ok("é</p>".as_bytes())
+        );
+        assert_eq!(transcoder.transcode(b"", true), Ok(&b""[..]));
+    }
+
+    #[test]
+    fn incomplete_character_at_the_end() {
+        let mut transcoder = InputTranscoder::new(SHIFT_JIS, SharedMemoryLimiter::new(usize::MAX));
+
+        assert_eq!(transcoder.transcode(b"a\x82", false), Ok(&b"a"[..]));
+        assert_eq!(transcoder.transcode(b"", true), Ok("\u{FFFD}".as_bytes()));
+
+        transcoder.reset();
+
+        assert_eq!(transcoder.transcode(b"\x82\xa0", true), Ok("あ".as_bytes()));
+    }
+
+    #[test]
+    fn bom_sniffing() {
+        let mut transcoder = InputTranscoder::new(SHIFT_JIS, SharedMemoryLimiter::new(usize::MAX));
+
+        assert_eq!(transcoder.transcode(b"\xff\xfea\0", true), Ok(&b"a"[..]));
+    }
+
+    #[test]
+    fn memory_limit() {
+        let mut transcoder = InputTranscoder::new(UTF_16LE, SharedMemoryLimiter::new(16));
+
+        assert!(transcoder.transcode(b"a\0b\0", false).is_ok());
+        assert_eq!(
+            transcoder.transcode(&[b'a'; 64], false),
+            Err(MemoryLimitExceededError)
+        );
+    }
+}
@@ -1,13 +1,20 @@
+mod buffered_output_sink;
 mod dispatcher;
+mod input_transcoder;
+mod text_node_buffer;
 
+pub use self::buffered_output_sink::BufferedOutputSink;
 use self::dispatcher::Dispatcher;
 pub use self::dispatcher::OutputSink;
 pub(crate) use self::dispatcher::{AuxStartTagInfo, DispatcherError};
 pub use self::dispatcher::{StartTagHandlingResult, TransformController};
+use self::input_transcoder::InputTranscoder;
 use crate::base::SharedEncoding;
-use crate::memory::{Arena, SharedMemoryLimiter};
+use crate::memory::{Arena, BufferPool, BufferSizeHistogram, SharedMemoryLimiter};
 use crate::parser::{Parser, ParserDirective};
 use crate::rewriter::RewritingError;
+use crate::stats::SharedStats;
+use encoding_rs::Encoding;
 
 // Pub only for integration tests
 pub struct TransformStreamSettings<C, O>
@@ -18,9 +25,15 @@ where
     pub transform_controller: C,
     pub output_sink: O,
     pub preallocated_parsing_buffer_size: usize,
+    pub text_decoder_buffer_size: usize,
     pub memory_limiter: SharedMemoryLimiter,
+    pub buffer_pool: Option<BufferPool>,
+    pub parsing_buffer_histogram: Option<BufferSizeHistogram>,
     pub encoding: SharedEncoding,
+    pub input_encoding: Option<&'static Encoding>,
+    pub disable_output: bool,
     pub strict: bool,
+    pub stats: SharedStats,
 }
 
 // Pub only for integration tests
@@ -31,7 +44,13 @@ where
 {
     parser: Parser<Dispatcher<C, O>>,
     buffer: Arena,
+    buffer_histogram: Option<BufferSizeHistogram>,
     has_buffered_data: bool,
+    // NOTE: set once the transform controller is exhausted, the rest of the document
+    // is emitted as is.
+    passthrough: bool,
+    input_transcoder: Option<InputTranscoder>,
+    stats: SharedStats,
 }
 
 impl<C, O> TransformStream<C, O>
@@ -54,19 +73,38 @@ where
             settings.transform_controller,
             settings.output_sink,
             settings.encoding,
+            settings.memory_limiter.clone(),
+            settings.text_decoder_buffer_size,
+            settings.buffer_pool.clone(),
+            settings.disable_output,
+            settings.stats.clone(),
         );
 
+        let input_transcoder = settings
+            .input_encoding
+            .map(|encoding| InputTranscoder::new(encoding, settings.memory_limiter.clone()));
+
         let buffer = Arena::new(
             settings.memory_limiter,
             settings.preallocated_parsing_buffer_size,
+            settings.buffer_pool,
         );
 
-        let parser = Parser::new(dispatcher, initial_parser_directive, settings.strict);
+        let parser = Parser::new(
+            dispatcher,
+            initial_parser_directive,
+            settings.strict,
+            settings.stats.clone(),
+        );
 
         Self {
             parser,
             buffer,
+            buffer_histogram: settings.parsing_buffer_histogram,
             has_buffered_data: false,
+            passthrough: false,
+            input_transcoder,
+            stats: settings.stats,
         }
     }
 
@@ -78,10 +116,16 @@ where
         if self.has_buffered_data {
             self.buffer.shift(consumed_byte_count);
         } else {
+            let blocked_bytes = &data[consumed_byte_count..];
+
             self.buffer
-                .init_with(&data[consumed_byte_count..])
+                .init_with(blocked_bytes)
                 .map_err(RewritingError::MemoryLimitExceeded)?;
 
+            self.stats.add_buffered_bytes(blocked_bytes.len());
+            self.stats
+                .update_parsing_buffer_high_water_mark(blocked_bytes.len());
+
             self.has_buffered_data = true;
         }
 
@@ -93,11 +137,46 @@ where
     pub fn write(&mut self, data: &[u8]) -> Result<(), RewritingError> {
         trace!(@write data);
 
+        match self.input_transcoder.take() {
+            Some(transcoder) => self.write_transcoded(transcoder, data, false),
+            None => self.write_chunk(data),
+        }
+    }
+
+    fn write_transcoded(
+        &mut self,
+        mut transcoder: InputTranscoder,
+        data: &[u8],
+        last: bool,
+    ) -> Result<(), RewritingError> {
+        let res = match transcoder.transcode(data, last) {
+            // NOTE: the decoder can hold back all of the data if it's an incomplete character.
+            Ok([]) => Ok(()),
+            Ok(chunk) => self.write_chunk(chunk),
+            Err(e) => Err(RewritingError::MemoryLimitExceeded(e)),
+        };
+
+        self.input_transcoder = Some(transcoder);
+
+        res
+    }
+
+    fn write_chunk(&mut self, data: &[u8]) -> Result<(), RewritingError> {
+        if self.passthrough {
+            self.parser.get_dispatcher().pass_through(data);
+
+            return Ok(());
+        }
+
         let chunk = if self.has_buffered_data {
             self.buffer
                 .append(data)
                 .map_err(RewritingError::MemoryLimitExceeded)?;
 
+            self.stats.add_buffered_bytes(data.len());
+            self.stats
+                .update_parsing_buffer_high_water_mark(self.buffer.bytes().len());
+
             self.buffer.bytes()
         } else {
             data
@@ -117,12 +196,39 @@ where
             self.has_buffered_data = false;
         }
 
+        self.try_enter_passthrough()
+    }
+
+    fn try_enter_passthrough(&mut self) -> Result<(), RewritingError> {
+        let dispatcher = self.parser.get_dispatcher();
+
+        if dispatcher.try_finish_rewriting()? {
+            if self.has_buffered_data {
+                dispatcher.pass_through(self.buffer.bytes());
+                self.has_buffered_data = false;
+            }
+
+            self.passthrough = true;
+        }
+
         Ok(())
     }
 
     pub fn end(&mut self) -> Result<(), RewritingError> {
         trace!(@end);
 
+        if let Some(transcoder) = self.input_transcoder.take() {
+            self.write_transcoded(transcoder, &[], true)?;
+        }
+
+        if let Some(ref histogram) = self.buffer_histogram {
+            histogram.record(self.buffer.take_high_water_mark());
+        }
+
+        if self.passthrough {
+            return self.parser.get_dispatcher().finish(&[]);
+        }
+
         let chunk = if self.has_buffered_data {
             self.buffer.bytes()
         } else {
@@ -135,6 +241,38 @@ where
         self.parser.get_dispatcher().finish(chunk)
     }
 
+    /// Returns the stream to its initial state, so it can be used for another document.
+    /// Memory allocated by the parsing buffer and the parser is kept for reuse.
+    pub fn reset(&mut self) {
+        let dispatcher = self.parser.get_dispatcher();
+
+        dispatcher.reset();
+
+        let initial_parser_directive = dispatcher.get_next_parser_directive();
+
+        self.parser.reset(initial_parser_directive);
+        // NOTE: the documents that haven't been ended are not recorded in the histogram.
+        self.buffer.take_high_water_mark();
+        self.has_buffered_data = false;
+        self.passthrough = false;
+
+        if let Some(transcoder) = &mut self.input_transcoder {
+            transcoder.reset();
+        }
+    }
+
+    #[inline]
+    pub fn output_sink_mut(&mut self) -> &mut O {
+        self.parser.get_dispatcher().output_sink_mut()
+    }
+
+    /// Stats aren't reset along with the stream, they accumulate over all of the documents.
+    #[cfg(feature = "stats")]
+    #[inline]
+    pub fn stats(&self) -> &SharedStats {
+        &self.stats
+    }
+
     #[cfg(feature = "integration_test")]
     #[allow(private_interfaces)]
     pub fn parser(&mut self) -> &mut Parser<Dispatcher<C, O>> {
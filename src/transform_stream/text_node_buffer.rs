@@ -0,0 +1,206 @@
+use crate::memory::{MemoryLimitExceededError, SharedMemoryLimiter};
+use std::mem;
+
+/// Accumulates decoded text of the current text node for the text handlers that
+/// receive whole text nodes.
+///
+/// The buffer never shrinks, so its memory is reused by the following text nodes.
+pub(crate) struct TextNodeBuffer {
+    limiter: SharedMemoryLimiter,
+    text: String,
+    // NOTE: the capacity accounted by the limiter, see `Arena`.
+    capacity: usize,
+    max_size: Option<usize>,
+    in_text_node: bool,
+}
+
+impl TextNodeBuffer {
+    #[inline]
+    #[must_use]
+    pub fn new(limiter: SharedMemoryLimiter) -> Self {
+        Self {
+            limiter,
+            text: String::new(),
+            capacity: 0,
+            max_size: None,
+            in_text_node: false,
+        }
+    }
+
+    /// Returns the maximum size of the buffered text for the current text node, or `None` if
+    /// the node shouldn't be buffered. The size is obtained with `get_max_size` once per text
+    /// node, when its first chunk is produced.
+    #[inline]
+    pub fn max_size_for_chunk(
+        &mut self,
+        last_in_text_node: bool,
+        get_max_size: impl FnOnce() -> Option<usize>,
+    ) -> Option<usize> {
+        if !self.in_text_node {
+            self.max_size = get_max_size();
+        }
+
+        self.in_text_node = !last_in_text_node;
+        self.max_size
+    }
+
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.text.len()
+    }
+
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.text.is_empty()
+    }
+
+    pub fn push_str(&mut self, text: &str) -> Result<(), MemoryLimitExceededError> {
+        if self.capacity - self.text.len() < text.len() {
+            self.grow(self.text.len() + text.len() - self.capacity)?;
+        }
+
+        self.text.push_str(text);
+
+        Ok(())
+    }
+
+    /// Grows the capacity by at least `required` bytes.
+    ///
+    /// Same as the parsing buffer, the capacity is doubled, so that a text node arriving in small
+    /// pieces isn't copied on every piece, but it doesn't grow beyond the maximum size of the
+    /// buffered text or by more than the limiter still allows.
+    #[cold]
+    fn grow(&mut self, required: usize) -> Result<(), MemoryLimitExceededError> {
+        let max_additional = self.max_size.map_or(usize::MAX, |max_size| {
+            max_size.saturating_sub(self.capacity)
+        });
+
+        let additional = self
+            .capacity
+            .min(max_additional)
+            .min(self.limiter.available())
+            .max(required);
+
+        self.limiter.increase_usage(additional)?;
+
+        let capacity = self.capacity + additional;
+
+        if self.text.capacity() < capacity
+            && self
+                .text
+                .try_reserve_exact(capacity - self.text.len())
+                .is_err()
+        {
+            self.limiter.decrease_usage(additional);
+
+            return Err(MemoryLimitExceededError);
+        }
+
+        // NOTE: the allocator can give the buffer a larger capacity, which is used if
+        // the limiter can afford it.
+        let extra = self.text.capacity() - capacity;
+
+        self.capacity = if self.limiter.increase_usage(extra).is_ok() {
+            capacity + extra
+        } else {
+            capacity
+        };
+
+        Ok(())
+    }
+
+    /// Takes the buffered text out of the buffer. The text should be returned with
+    /// [`TextNodeBuffer::restore`] once it has been handled, so the memory can be reused.
+    #[inline]
+    pub fn take(&mut self) -> String {
+        mem::take(&mut self.text)
+    }
+
+    #[inline]
+    pub fn restore(&mut self, mut text: String) {
+        text.clear();
+        self.text = text;
+    }
+
+    #[inline]
+    pub fn reset(&mut self) {
+        self.text.clear();
+        self.max_size = None;
+        self.in_text_node = false;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn max_size_is_obtained_once_per_text_node() {
+        let mut buffer = TextNodeBuffer::new(SharedMemoryLimiter::new(usize::MAX));
+
+        assert_eq!(buffer.max_size_for_chunk(false, || Some(1)), Some(1));
+        assert_eq!(buffer.max_size_for_chunk(false, || Some(2)), Some(1));
+        assert_eq!(buffer.max_size_for_chunk(true, || Some(3)), Some(1));
+        assert_eq!(buffer.max_size_for_chunk(true, || None), None);
+        assert_eq!(buffer.max_size_for_chunk(false, || Some(4)), Some(4));
+
+        buffer.reset();
+
+        assert_eq!(buffer.max_size_for_chunk(false, || Some(5)), Some(5));
+    }
+
+    #[test]
+    fn memory_limit() {
+        let limiter = SharedMemoryLimiter::new(8);
+        let mut buffer = TextNodeBuffer::new(limiter.clone());
+
+        buffer.push_str("abcd").unwrap();
+        buffer.push_str("efgh").unwrap();
+
+        assert_eq!(limiter.current_usage(), 8);
+        assert_eq!(buffer.push_str("i"), Err(MemoryLimitExceededError));
+
+        let text = buffer.take();
+
+        assert_eq!(text, "abcdefgh");
+
+        buffer.restore(text);
+
+        assert!(buffer.is_empty());
+
+        buffer.push_str("ijkl").unwrap();
+
+        assert_eq!(limiter.current_usage(), 8);
+    }
+
+    #[test]
+    fn geometric_growth() {
+        let limiter = SharedMemoryLimiter::new(100);
+        let mut buffer = TextNodeBuffer::new(limiter.clone());
+
+        buffer.push_str("ab").unwrap();
+        assert_eq!(limiter.current_usage(), 2);
+
+        buffer.push_str("c").unwrap();
+        assert_eq!(limiter.current_usage(), 4);
+
+        buffer.push_str("d").unwrap();
+        assert_eq!(limiter.current_usage(), 4);
+
+        buffer.push_str("e").unwrap();
+        assert_eq!(limiter.current_usage(), 8);
+    }
+
+    #[test]
+    fn growth_is_clamped_to_max_size() {
+        let limiter = SharedMemoryLimiter::new(100);
+        let mut buffer = TextNodeBuffer::new(limiter.clone());
+
+        assert_eq!(buffer.max_size_for_chunk(false, || Some(3)), Some(3));
+
+        buffer.push_str("ab").unwrap();
+        buffer.push_str("c").unwrap();
+
+        assert_eq!(limiter.current_usage(), 3);
+    }
+}
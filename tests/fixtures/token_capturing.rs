@@ -4,7 +4,7 @@ use lol_html::errors::RewritingError;
 use lol_html::html_content::{DocumentEnd, TextType};
 use lol_html::test_utils::Output;
 use lol_html::{
-    LocalName, LocalNameHash, Namespace, SharedEncoding, SharedMemoryLimiter,
+    LocalName, LocalNameHash, Namespace, SharedEncoding, SharedMemoryLimiter, SharedStats,
     StartTagHandlingResult, Token, TokenCaptureFlags, TransformController, TransformStream,
     TransformStreamSettings,
 };
@@ -65,7 +65,7 @@ impl TransformController for TestTransformController<'_> {
         Ok(self.capture_flags)
     }
 
-    fn handle_end_tag(&mut self, _: LocalName<'_>) -> TokenCaptureFlags {
+    fn handle_end_tag(&mut self, _: LocalName<'_>, _: Namespace) -> TokenCaptureFlags {
         self.capture_flags
     }
 
@@ -103,9 +103,15 @@ pub fn parse(
         transform_controller,
         output_sink: |chunk: &[u8]| output.push(chunk),
         preallocated_parsing_buffer_size: 0,
+        text_decoder_buffer_size: 1024,
         memory_limiter,
         encoding: SharedEncoding::new(encoding),
+        input_encoding: None,
+        buffer_pool: None,
+        parsing_buffer_histogram: None,
+        disable_output: false,
         strict: true,
+        stats: SharedStats::default(),
     });
 
     let parser = transform_stream.parser();
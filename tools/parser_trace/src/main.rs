@@ -72,7 +72,7 @@ impl TransformController for TraceTransformController {
         Ok(self.capture_flags)
     }
 
-    fn handle_end_tag(&mut self, _: LocalName<'_>) -> TokenCaptureFlags {
+    fn handle_end_tag(&mut self, _: LocalName<'_>, _: Namespace) -> TokenCaptureFlags {
         self.capture_flags
     }
 
@@ -102,9 +102,15 @@ fn main() {
         transform_controller: TraceTransformController::new(tag_hint_mode),
         output_sink: |_: &[u8]| {},
         preallocated_parsing_buffer_size: 0,
+        text_decoder_buffer_size: 1024,
         memory_limiter: SharedMemoryLimiter::new(2048),
         encoding: SharedEncoding::new(AsciiCompatibleEncoding::new(UTF_8).unwrap()),
+        input_encoding: None,
+        buffer_pool: None,
+        parsing_buffer_histogram: None,
+        disable_output: false,
         strict: true,
+        stats: SharedStats::default(),
     });
 
     let parser = transform_stream.parser();